@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <limits.h>
+#include <float.h>
 #include <stdlib.h>
+#include <emmintrin.h>
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -18,6 +20,29 @@
 #pragma warning(pop)
 
 static int DoneRunning;
+// Upload vertices as struct Compact_Vertex instead of struct Vertex.
+static int UseCompactVertices = 0;
+// Extra processing load_mesh_part does on every part. Part of the scene cache key.
+struct Mesh_Process_Options
+{
+    int optimize_vertex_cache;
+    int optimize_overdraw; // Only has an effect together with optimize_vertex_cache.
+    int optimize_vertex_fetch;
+    int build_meshlets;
+    int build_lods;
+    int fast_tangents; // generate_tangents instead of MikkTSpace's genTangSpaceDefault.
+};
+static struct Mesh_Process_Options MeshProcessOptions = {
+    .optimize_vertex_cache = 1,
+    .optimize_overdraw = 1,
+    .optimize_vertex_fetch = 1,
+    .build_meshlets = 1,
+    .build_lods = 1,
+    .fast_tangents = 1,
+};
+// How far, in pixels, a simplified LOD may stray from the full mesh before draw_node picks a finer one.
+// 0 always draws full detail.
+static float LodErrorPixels = 1.0f;
 
 enum Key_State
 {
@@ -61,11 +86,18 @@ LRESULT CALLBACK WindowCallback(HWND Window, UINT Message, WPARAM WParam, LPARAM
     return Result;
 }
 
+enum TEXTURE_USAGE
+{
+    TEXTURE_USAGE_COLOR,
+    TEXTURE_USAGE_NORMAL,
+};
 struct Texture
 {
     char* path;
     struct Buffer* buffer;
     struct Shader_Resource_View* srv;
+    enum TEXTURE_USAGE usage; // Set from the mesh parts before upload, picks the block compression format.
+    int has_alpha; // Set on load. Parts with such a color texture are taken as alpha tested and never occlude.
 };
 enum NODE_TYPE 
 {
@@ -116,10 +148,12 @@ struct Node
 
     struct Texture* texture_array;
     size_t texture_count;
+
+    size_t transform_index;
 };
-struct Node* node_create()
+struct Node* node_create(struct Arena* arena)
 {
-    struct Node* node = calloc(sizeof(struct Node), 1);
+    struct Node* node = arena_alloc(arena, sizeof(struct Node));
     return node;
 }
 Mat4 node_local_transform(struct Node* node)
@@ -151,6 +185,313 @@ Mat4 node_global_transform_geometry(struct Node* node)
     return MulM4(node_global_transform(node), node_geometry_transform(node));
 }
 
+// The node tree flattened into arrays in depth-first order, so a parent always comes before its children
+// and every subtree is the contiguous range [index, subtree_end[index]).
+// Local TRS is kept as structure of arrays, padded to a multiple of 4 so the local matrices can be
+// built 4 nodes at a time. node->transform_index is the node's slot in these arrays.
+struct Scene_Transforms
+{
+    size_t count;
+    size_t padded_count;
+    struct Node** nodes;
+    int* parent_index; // -1 for the root
+    size_t* subtree_end;
+
+    // Nodes whose local transform changed since the last update, and the nodes whose world transform
+    // the last update touched.
+    unsigned char* dirty;
+    size_t* dirty_list;
+    size_t dirty_count;
+    size_t* changed_list;
+    size_t changed_count;
+
+    float* position[3];
+    float* rotation[4];
+    float* scale[3];
+
+    Mat4* geometry;
+    Mat4* local;
+    Mat4* world;
+    Mat4* world_geometry;
+};
+
+// Object-space bounds of every mesh part as structure of arrays, in the depth-first order of the transforms
+// and padded to a multiple of 4 so the frustum culling can test 4 parts at once.
+// mesh_part->bounds_index is the part's slot in these arrays.
+struct Scene_Bounds
+{
+    size_t count;
+    size_t padded_count;
+    struct Mesh_Part** mesh_parts;
+    size_t* transform_index;
+
+    float* center[3];
+    float* extent[3]; // Half the size of the AABB around center.
+    float* radius;    // Bounding sphere around the same center.
+
+    unsigned char* visible; // Written by frustum_cull.
+};
+// Bounding volume hierarchy over the world boxes of the scene's parts, see scene_build_bvh.
+#define BVH_BINS 16
+#define BVH_LEAF_SIZE 4
+#define BVH_NO_LEAF 0xffffffffu
+struct Bvh_Node
+{
+    Vec3 min;
+    Vec3 max;
+    unsigned int left; // Children are left and left + 1, 0 for a leaf since the root is never a child.
+    unsigned int first_item;
+    unsigned int item_count; // Every node covers a contiguous range of items, a leaf holds at most BVH_LEAF_SIZE.
+};
+struct Scene_Bvh
+{
+    struct Bvh_Node* nodes;
+    size_t node_count;
+    unsigned int* parent;
+    unsigned int* items;        // Bounds indices.
+    unsigned int* leaf_of_part; // By bounds index, BVH_NO_LEAF for parts with nothing to draw.
+    Vec3* part_min;             // World box by bounds index.
+    Vec3* part_max;
+
+    unsigned char* dirty;
+    size_t* dirty_list;
+    size_t dirty_count;
+};
+
+// Everything a loaded scene owns on the CPU lives either in its arena or, when it came from the scene
+// cache, in the mapped cache file. scene_destroy releases both in one go.
+// It does not touch the GPU side: the buffers, views and descriptor slots upload_node_buffers and
+// load_textures create stay alive, since yara has no way to release a buffer or descriptor. A process
+// that reloads scenes still grows on the GPU with every upload.
+struct Scene
+{
+    struct Node* root;
+    struct Arena* arena;
+    struct Mapped_File cache_file;
+
+    struct Scene_Transforms transforms;
+    struct Scene_Bounds bounds;
+    struct Scene_Bvh bvh;
+};
+void scene_destroy(struct Scene* scene)
+{
+    if (!scene)
+        return;
+
+    arena_destroy(scene->arena);
+    unmap_file(&scene->cache_file);
+    free(scene);
+}
+
+size_t node_count_recursive(struct Node* node)
+{
+    size_t count = 1;
+    for (size_t i = 0; i < node->child_count; i++)
+        count += node_count_recursive(node->child_array[i]);
+    return count;
+}
+void scene_flatten_node(struct Scene_Transforms* transforms, struct Node* node, int parent_index, size_t* cursor)
+{
+    size_t index = (*cursor)++;
+    node->transform_index = index;
+    transforms->nodes[index] = node;
+    transforms->parent_index[index] = parent_index;
+    transforms->geometry[index] = node_geometry_transform(node);
+
+    for (size_t i = 0; i < node->child_count; i++)
+        scene_flatten_node(transforms, node->child_array[i], (int)index, cursor);
+    transforms->subtree_end[index] = *cursor;
+}
+void scene_set_local_transform(struct Scene* scene, struct Node* node, Vec3 position, Quat rotation, Vec3 scale)
+{
+    node->local_position = position;
+    node->local_rotation = rotation;
+    node->local_scale = scale;
+
+    struct Scene_Transforms* transforms = &scene->transforms;
+    size_t index = node->transform_index;
+    for (int i = 0; i < 3; i++)
+    {
+        transforms->position[i][index] = position.Elements[i];
+        transforms->scale[i][index] = scale.Elements[i];
+    }
+    for (int i = 0; i < 4; i++)
+        transforms->rotation[i][index] = rotation.Elements[i];
+
+    if (!transforms->dirty[index])
+    {
+        transforms->dirty[index] = 1;
+        transforms->dirty_list[transforms->dirty_count++] = index;
+    }
+}
+void scene_flatten(struct Scene* scene)
+{
+    struct Scene_Transforms* transforms = &scene->transforms;
+    transforms->count = node_count_recursive(scene->root);
+    transforms->padded_count = (transforms->count + 3) & ~(size_t)3;
+
+    size_t count = transforms->padded_count;
+    transforms->nodes = arena_alloc(scene->arena, count * sizeof(struct Node*));
+    transforms->parent_index = arena_alloc(scene->arena, count * sizeof(int));
+    transforms->subtree_end = arena_alloc(scene->arena, count * sizeof(size_t));
+    transforms->dirty = arena_alloc(scene->arena, count * sizeof(unsigned char));
+    transforms->dirty_list = arena_alloc(scene->arena, count * sizeof(size_t));
+    transforms->changed_list = arena_alloc(scene->arena, count * sizeof(size_t));
+    for (int i = 0; i < 3; i++)
+    {
+        transforms->position[i] = arena_alloc(scene->arena, count * sizeof(float));
+        transforms->scale[i] = arena_alloc(scene->arena, count * sizeof(float));
+    }
+    for (int i = 0; i < 4; i++)
+        transforms->rotation[i] = arena_alloc(scene->arena, count * sizeof(float));
+    transforms->geometry = arena_alloc(scene->arena, count * sizeof(Mat4));
+    transforms->local = arena_alloc(scene->arena, count * sizeof(Mat4));
+    transforms->world = arena_alloc(scene->arena, count * sizeof(Mat4));
+    transforms->world_geometry = arena_alloc(scene->arena, count * sizeof(Mat4));
+
+    size_t cursor = 0;
+    scene_flatten_node(transforms, scene->root, -1, &cursor);
+
+    for (size_t i = 0; i < transforms->count; i++)
+    {
+        struct Node* node = transforms->nodes[i];
+        scene_set_local_transform(scene, node, node->local_position, node->local_rotation, node->local_scale);
+    }
+    // Padding lanes get an identity transform so they stay harmless.
+    for (size_t i = transforms->count; i < count; i++)
+    {
+        transforms->rotation[3][i] = 1.0f;
+        transforms->scale[0][i] = transforms->scale[1][i] = transforms->scale[2][i] = 1.0f;
+    }
+}
+// Builds the local matrices of nodes [first, first + 4) at once, same math as node_local_transform.
+void scene_compute_local_transforms_x4(struct Scene_Transforms* transforms, size_t first)
+{
+    __m128 x = _mm_loadu_ps(transforms->rotation[0] + first);
+    __m128 y = _mm_loadu_ps(transforms->rotation[1] + first);
+    __m128 z = _mm_loadu_ps(transforms->rotation[2] + first);
+    __m128 w = _mm_loadu_ps(transforms->rotation[3] + first);
+
+    __m128 length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+    __m128 inverse_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_squared));
+    x = _mm_mul_ps(x, inverse_length);
+    y = _mm_mul_ps(y, inverse_length);
+    z = _mm_mul_ps(z, inverse_length);
+    w = _mm_mul_ps(w, inverse_length);
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+    __m128 scale_x = _mm_loadu_ps(transforms->scale[0] + first);
+    __m128 scale_y = _mm_loadu_ps(transforms->scale[1] + first);
+    __m128 scale_z = _mm_loadu_ps(transforms->scale[2] + first);
+
+    // columns[c][r] holds element r of column c for all 4 nodes.
+    __m128 columns[4][4];
+    columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scale_x);
+    columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scale_x);
+    columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scale_x);
+    columns[0][3] = _mm_setzero_ps();
+
+    columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scale_y);
+    columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scale_y);
+    columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scale_y);
+    columns[1][3] = _mm_setzero_ps();
+
+    columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scale_z);
+    columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scale_z);
+    columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scale_z);
+    columns[2][3] = _mm_setzero_ps();
+
+    columns[3][0] = _mm_loadu_ps(transforms->position[0] + first);
+    columns[3][1] = _mm_loadu_ps(transforms->position[1] + first);
+    columns[3][2] = _mm_loadu_ps(transforms->position[2] + first);
+    columns[3][3] = one;
+
+    Mat4* local = transforms->local + first;
+    for (int c = 0; c < 4; c++)
+    {
+        __m128 r0 = columns[c][0], r1 = columns[c][1], r2 = columns[c][2], r3 = columns[c][3];
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        local[0].Columns[c].SSE = r0;
+        local[1].Columns[c].SSE = r1;
+        local[2].Columns[c].SSE = r2;
+        local[3].Columns[c].SSE = r3;
+    }
+}
+// One pass over the flattened hierarchy: local matrices 4 at a time, then world matrices in order,
+// since every parent is already done by the time its children come up.
+void scene_update_world_transforms(struct Scene* scene)
+{
+    struct Scene_Transforms* transforms = &scene->transforms;
+    for (size_t i = 0; i < transforms->padded_count; i += 4)
+        scene_compute_local_transforms_x4(transforms, i);
+
+    for (size_t i = 0; i < transforms->count; i++)
+    {
+        int parent = transforms->parent_index[i];
+        transforms->world[i] = parent < 0 ? transforms->local[i] : MulM4(transforms->world[parent], transforms->local[i]);
+        transforms->world_geometry[i] = MulM4(transforms->world[i], transforms->geometry[i]);
+        transforms->changed_list[i] = i;
+    }
+    transforms->changed_count = transforms->count;
+
+    for (size_t i = 0; i < transforms->dirty_count; i++)
+        transforms->dirty[transforms->dirty_list[i]] = 0;
+    transforms->dirty_count = 0;
+}
+int compare_size_t(const void* a, const void* b)
+{
+    size_t x = *(const size_t*)a;
+    size_t y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
+// Only recomputes the subtrees under nodes changed with scene_set_local_transform since the last update.
+// A dirty node inside a subtree that is already being recomputed is picked up along the way.
+// The touched nodes end up in changed_list so their constants can be re-uploaded.
+void scene_update_dirty_transforms(struct Scene* scene)
+{
+    struct Scene_Transforms* transforms = &scene->transforms;
+    transforms->changed_count = 0;
+    if (transforms->dirty_count == 0)
+        return;
+
+    qsort(transforms->dirty_list, transforms->dirty_count, sizeof(size_t), compare_size_t);
+
+    size_t covered_end = 0;
+    size_t computed_block = (size_t)-1;
+    for (size_t d = 0; d < transforms->dirty_count; d++)
+    {
+        size_t root = transforms->dirty_list[d];
+        if (root < covered_end)
+            continue;
+
+        covered_end = transforms->subtree_end[root];
+        for (size_t i = root; i < covered_end; i++)
+        {
+            if (transforms->dirty[i])
+            {
+                size_t block = i & ~(size_t)3;
+                if (block != computed_block)
+                {
+                    scene_compute_local_transforms_x4(transforms, block);
+                    computed_block = block;
+                }
+                transforms->dirty[i] = 0;
+            }
+
+            int parent = transforms->parent_index[i];
+            transforms->world[i] = parent < 0 ? transforms->local[i] : MulM4(transforms->world[parent], transforms->local[i]);
+            transforms->world_geometry[i] = MulM4(transforms->world[i], transforms->geometry[i]);
+            transforms->changed_list[transforms->changed_count++] = i;
+        }
+    }
+    transforms->dirty_count = 0;
+}
+
 #define conv_float(in, out) for (size_t conv_i = 0; conv_i < ARRAYSIZE(in.v); conv_i++) { out.Elements[conv_i] = (float)in.v[conv_i]; }
 #define conv_double(in, out) for (size_t conv_i = 0; conv_i < ARRAYSIZE(in.v); conv_i++) { out.Elements[conv_i] = (double)in.v[conv_i]; }
 
@@ -163,14 +504,224 @@ struct Vertex
     Vec4 tangent;
     Vec2 uv;
 };
+// 24 byte version of struct Vertex for the GPU. Positions are unorm16 against the mesh part's bounds,
+// normal and tangent are octahedral snorm16, and the tangent sign rides along in pos[3].
+struct Compact_Vertex
+{
+    unsigned short pos[4];
+    unsigned char color[4];
+    short normal[2];
+    short tangent[2];
+    unsigned short uv[2]; // half floats
+};
 #pragma pack(pop)
+
+unsigned short float_to_half(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = (bits >> 16) & 0x8000;
+    unsigned int exponent = (bits >> 23) & 0xff;
+    unsigned int mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff)
+        return (unsigned short)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    int half_exponent = (int)exponent - 127 + 15;
+    if (half_exponent >= 31)
+        return (unsigned short)(sign | 0x7c00);
+    if (half_exponent <= 0)
+    {
+        if (half_exponent < -10)
+            return (unsigned short)sign;
+
+        // Subnormal half, shift the mantissa with its implicit bit into place and round to nearest even.
+        mantissa |= 0x800000;
+        unsigned int shift = (unsigned int)(14 - half_exponent);
+        unsigned int half_mantissa = mantissa >> shift;
+        unsigned int remainder = mantissa & ((1u << shift) - 1);
+        unsigned int halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+            half_mantissa++;
+        return (unsigned short)(sign | half_mantissa);
+    }
+
+    unsigned int half = sign | ((unsigned int)half_exponent << 10) | (mantissa >> 13);
+    unsigned int remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++; // A carry into the exponent is still the correctly rounded result.
+    return (unsigned short)half;
+}
+float half_to_float(unsigned short half)
+{
+    unsigned int sign = (half & 0x8000u) << 16;
+    unsigned int exponent = (half >> 10) & 0x1f;
+    unsigned int mantissa = half & 0x3ff;
+
+    unsigned int bits;
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else if (exponent == 0)
+    {
+        float value = (float)mantissa * (1.0f / 16777216.0f);
+        memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+    }
+    else
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+short float_to_snorm16(float value)
+{
+    value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+    return (short)(value >= 0.0f ? value * 32767.0f + 0.5f : value * 32767.0f - 0.5f);
+}
+float snorm16_to_float(short value)
+{
+    float result = (float)value / 32767.0f;
+    return result < -1.0f ? -1.0f : result;
+}
+unsigned short float_to_unorm16(float value)
+{
+    value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+    return (unsigned short)(value * 65535.0f + 0.5f);
+}
+unsigned char float_to_unorm8(float value)
+{
+    value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+    return (unsigned char)(value * 255.0f + 0.5f);
+}
+Vec3 octahedral_decode(const short in[2]);
+// Picks whichever of the four surrounding snorm16 codes decodes closest to the direction,
+// which roughly halves the error of plain rounding.
+void octahedral_encode(Vec3 direction, short out[2])
+{
+    float length = fabsf(direction.X) + fabsf(direction.Y) + fabsf(direction.Z);
+    float x = length > 0.0f ? direction.X / length : 0.0f;
+    float y = length > 0.0f ? direction.Y / length : 0.0f;
+    if (direction.Z < 0.0f)
+    {
+        float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    float best_dot = -FLT_MAX;
+    for (int i = 0; i < 4; i++)
+    {
+        float code_x = (i & 1) ? ceilf(x * 32767.0f) : floorf(x * 32767.0f);
+        float code_y = (i & 2) ? ceilf(y * 32767.0f) : floorf(y * 32767.0f);
+        short candidate[2] = { float_to_snorm16(code_x / 32767.0f), float_to_snorm16(code_y / 32767.0f) };
+        float dot = DotV3(octahedral_decode(candidate), direction);
+        if (dot > best_dot)
+        {
+            best_dot = dot;
+            out[0] = candidate[0];
+            out[1] = candidate[1];
+        }
+    }
+}
+// Same as oct_decode in shader.hlsl.
+Vec3 octahedral_decode(const short in[2])
+{
+    Vec3 direction = V3(snorm16_to_float(in[0]), snorm16_to_float(in[1]), 0.0f);
+    direction.Z = 1.0f - fabsf(direction.X) - fabsf(direction.Y);
+    float t = direction.Z < 0.0f ? -direction.Z : 0.0f;
+    direction.X += direction.X >= 0.0f ? -t : t;
+    direction.Y += direction.Y >= 0.0f ? -t : t;
+    return NormV3(direction);
+}
+struct Compact_Vertex compact_vertex_encode(const struct Vertex* vertex, Vec3 position_min, Vec3 position_extent)
+{
+    struct Compact_Vertex compact = {0};
+    for (int i = 0; i < 3; i++)
+    {
+        float extent = position_extent.Elements[i];
+        compact.pos[i] = float_to_unorm16(extent > 0.0f ? (vertex->pos.Elements[i] - position_min.Elements[i]) / extent : 0.0f);
+    }
+    compact.pos[3] = vertex->tangent.W < 0.0f ? 0 : 65535;
+    for (int i = 0; i < 4; i++)
+        compact.color[i] = float_to_unorm8(vertex->color.Elements[i]);
+    octahedral_encode(vertex->normal, compact.normal);
+    octahedral_encode(vertex->tangent.XYZ, compact.tangent);
+    compact.uv[0] = float_to_half(vertex->uv.X);
+    compact.uv[1] = float_to_half(vertex->uv.Y);
+    return compact;
+}
+struct Vertex compact_vertex_decode(const struct Compact_Vertex* compact, Vec3 position_min, Vec3 position_extent)
+{
+    struct Vertex vertex = {0};
+    for (int i = 0; i < 3; i++)
+        vertex.pos.Elements[i] = (float)compact->pos[i] / 65535.0f * position_extent.Elements[i] + position_min.Elements[i];
+    for (int i = 0; i < 4; i++)
+        vertex.color.Elements[i] = (float)compact->color[i] / 255.0f;
+    vertex.normal = octahedral_decode(compact->normal);
+    vertex.tangent.XYZ = octahedral_decode(compact->tangent);
+    vertex.tangent.W = compact->pos[3] > 32767 ? 1.0f : -1.0f;
+    vertex.uv = V2(half_to_float(compact->uv[0]), half_to_float(compact->uv[1]));
+    return vertex;
+}
+size_t vertex_stride(void)
+{
+    return UseCompactVertices ? sizeof(struct Compact_Vertex) : sizeof(struct Vertex);
+}
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESH_LOD_MAX 6
+// One level of detail of a mesh part: index_count indices starting at index_offset in the part's index
+// array, drawn with the part's full vertex buffer. error is how far, in the part's own units, the
+// simplified surface may be from the original.
+struct Mesh_Lod
+{
+    size_t index_offset;
+    size_t index_count;
+    float error;
+};
+
+// A small cluster of a mesh part's triangles. Its vertices are meshlet_vertex_array[vertex_offset...],
+// indices into the part's vertex array, and its triangles are 3 bytes each in meshlet_triangle_array
+// starting at triangle_offset * 3, indexing the meshlet's own vertices.
+// The cluster is backfacing for any viewer for which dot(normalize(cone_apex - viewer), cone_axis) >= cone_cutoff.
+struct Meshlet
+{
+    unsigned int vertex_offset;
+    unsigned int triangle_offset;
+    unsigned int vertex_count;
+    unsigned int triangle_count;
+
+    Vec3 center;
+    float radius;
+    Vec3 cone_apex;
+    Vec3 cone_axis;
+    float cone_cutoff; // 1.0 when the normals spread too far to ever cull.
+};
 struct Mesh_Part
 {
     struct Vertex* vertex_array;
     size_t vertex_count;
-
-    unsigned int* index_array;
+    Vec3 position_min;
+    Vec3 position_extent;
+    float bounding_radius; // Around the center of position_min/position_extent.
+    size_t bounds_index;
+
+    // Parts with at most 65536 vertices keep their indices as 16 bit, see index_16_bit.
+    // index_count covers the full detail mesh, the coarser LODs' indices follow it in the same array.
+    union
+    {
+        unsigned int* index_array;
+        unsigned short* index_array_16;
+    };
     size_t index_count;
+    unsigned int index_16_bit;
+
+    // lod_array[0] is always the full detail mesh.
+    struct Mesh_Lod lod_array[MESH_LOD_MAX];
+    unsigned int lod_count;
 
     struct Buffer* vertex_buffer;
     struct Buffer* index_buffer;
@@ -180,7 +731,356 @@ struct Mesh_Part
 
     struct Texture* color_texture;
     struct Texture* normal_texture;
+
+    struct Meshlet* meshlet_array;
+    size_t meshlet_count;
+    unsigned int* meshlet_vertex_array;
+    size_t meshlet_vertex_count;
+    unsigned char* meshlet_triangle_array;
+    size_t meshlet_triangle_count;
 };
+size_t mesh_part_index_size(struct Mesh_Part* mesh_part)
+{
+    return mesh_part->index_16_bit ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+enum FORMAT mesh_part_index_format(struct Mesh_Part* mesh_part)
+{
+    return mesh_part->index_16_bit ? FORMAT_R16_UINT : FORMAT_R32_UINT;
+}
+size_t mesh_part_total_index_count(struct Mesh_Part* mesh_part)
+{
+    if (mesh_part->lod_count == 0)
+        return mesh_part->index_count;
+    struct Mesh_Lod* last = &mesh_part->lod_array[mesh_part->lod_count - 1];
+    return last->index_offset + last->index_count;
+}
+unsigned int mesh_part_get_index(struct Mesh_Part* mesh_part, size_t i)
+{
+    return mesh_part->index_16_bit ? mesh_part->index_array_16[i] : mesh_part->index_array[i];
+}
+// Moves the loader's 32 bit indices, every LOD of them, into the arena, narrowed to 16 bit when every index fits.
+void mesh_part_store_indices(struct Mesh_Part* mesh_part, unsigned int* indices, struct Arena* arena)
+{
+    size_t total_index_count = mesh_part_total_index_count(mesh_part);
+    if (mesh_part->vertex_count <= 65536)
+    {
+        mesh_part->index_array_16 = arena_alloc(arena, total_index_count * sizeof(unsigned short));
+        for (size_t i = 0; i < total_index_count; i++)
+            mesh_part->index_array_16[i] = (unsigned short)indices[i];
+        mesh_part->index_16_bit = 1;
+    }
+    else
+    {
+        mesh_part->index_array = arena_alloc(arena, total_index_count * sizeof(unsigned int));
+        memcpy(mesh_part->index_array, indices, total_index_count * sizeof(unsigned int));
+        mesh_part->index_16_bit = 0;
+    }
+}
+void mesh_part_compute_bounds(struct Mesh_Part* mesh_part)
+{
+    Vec3 position_min = V3(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vec3 position_max = V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (size_t i = 0; i < mesh_part->vertex_count; i++)
+    {
+        Vec3 pos = mesh_part->vertex_array[i].pos;
+        for (int j = 0; j < 3; j++)
+        {
+            position_min.Elements[j] = min(position_min.Elements[j], pos.Elements[j]);
+            position_max.Elements[j] = max(position_max.Elements[j], pos.Elements[j]);
+        }
+    }
+    mesh_part->position_min = position_min;
+    mesh_part->position_extent = SubV3(position_max, position_min);
+
+    // The farthest vertex from the box center, never looser than half the box diagonal.
+    Vec3 center = AddV3(position_min, MulV3F(mesh_part->position_extent, 0.5f));
+    float radius_squared = 0.0f;
+    for (size_t i = 0; i < mesh_part->vertex_count; i++)
+        radius_squared = max(radius_squared, LenSqrV3(SubV3(mesh_part->vertex_array[i].pos, center)));
+    mesh_part->bounding_radius = sqrtf(radius_squared);
+}
+// Gathers the bounds of every mesh part into scene->bounds. Like scene_flatten, which it has to follow,
+// it allocates fresh arrays from the scene arena so it can run again after the tree changes.
+void scene_flatten_bounds(struct Scene* scene)
+{
+    struct Scene_Transforms* transforms = &scene->transforms;
+    struct Scene_Bounds* bounds = &scene->bounds;
+    bounds->count = 0;
+    for (size_t i = 0; i < transforms->count; i++)
+    {
+        if (transforms->nodes[i]->type == NODE_TYPE_MESH)
+            bounds->count += transforms->nodes[i]->mesh.mesh_parts_count;
+    }
+    bounds->padded_count = (bounds->count + 3) & ~(size_t)3;
+
+    size_t count = bounds->padded_count;
+    bounds->mesh_parts = arena_alloc(scene->arena, count * sizeof(struct Mesh_Part*));
+    bounds->transform_index = arena_alloc(scene->arena, count * sizeof(size_t));
+    for (int i = 0; i < 3; i++)
+    {
+        bounds->center[i] = arena_alloc(scene->arena, count * sizeof(float));
+        bounds->extent[i] = arena_alloc(scene->arena, count * sizeof(float));
+    }
+    bounds->radius = arena_alloc(scene->arena, count * sizeof(float));
+    bounds->visible = arena_alloc(scene->arena, count * sizeof(unsigned char));
+
+    size_t cursor = 0;
+    for (size_t i = 0; i < transforms->count; i++)
+    {
+        struct Node* node = transforms->nodes[i];
+        if (node->type != NODE_TYPE_MESH)
+            continue;
+
+        for (size_t j = 0; j < node->mesh.mesh_parts_count; j++)
+        {
+            struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[j];
+            size_t index = cursor++;
+            mesh_part->bounds_index = index;
+            bounds->mesh_parts[index] = mesh_part;
+            bounds->transform_index[index] = i;
+            for (int k = 0; k < 3; k++)
+            {
+                bounds->extent[k][index] = mesh_part->position_extent.Elements[k] * 0.5f;
+                bounds->center[k][index] = mesh_part->position_min.Elements[k] + bounds->extent[k][index];
+            }
+            bounds->radius[index] = mesh_part->bounding_radius;
+            bounds->visible[index] = 1;
+        }
+    }
+    // Padding lanes are empty boxes at the root's origin, their results are never read.
+    for (size_t i = bounds->count; i < count; i++)
+    {
+        bounds->mesh_parts[i] = 0;
+        bounds->transform_index[i] = 0;
+        for (int k = 0; k < 3; k++)
+            bounds->center[k][i] = bounds->extent[k][i] = 0.0f;
+        bounds->radius[i] = 0.0f;
+    }
+}
+// World-space AABB of a part's object-space box: the box around the transformed box.
+void mesh_part_world_box(struct Mesh_Part* mesh_part, const Mat4* world_geometry, Vec3* world_min, Vec3* world_max)
+{
+    Vec3 extent = MulV3F(mesh_part->position_extent, 0.5f);
+    Vec3 center = MulM4V4(*world_geometry, V4V(AddV3(mesh_part->position_min, extent), 1.0f)).XYZ;
+    Vec3 world_extent;
+    for (int r = 0; r < 3; r++)
+        world_extent.Elements[r] = fabsf(world_geometry->Elements[0][r]) * extent.X + fabsf(world_geometry->Elements[1][r]) * extent.Y + fabsf(world_geometry->Elements[2][r]) * extent.Z;
+    *world_min = SubV3(center, world_extent);
+    *world_max = AddV3(center, world_extent);
+}
+float bvh_box_area(Vec3 box_min, Vec3 box_max)
+{
+    Vec3 size = SubV3(box_max, box_min);
+    return size.X * size.Y + size.Y * size.Z + size.Z * size.X;
+}
+void bvh_box_grow(Vec3* box_min, Vec3* box_max, Vec3 other_min, Vec3 other_max)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        box_min->Elements[k] = min(box_min->Elements[k], other_min.Elements[k]);
+        box_max->Elements[k] = max(box_max->Elements[k], other_max.Elements[k]);
+    }
+}
+void bvh_node_fit(struct Scene_Bvh* bvh, struct Bvh_Node* node)
+{
+    node->min = V3(FLT_MAX, FLT_MAX, FLT_MAX);
+    node->max = V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    if (node->left)
+    {
+        for (unsigned int i = 0; i < 2; i++)
+            bvh_box_grow(&node->min, &node->max, bvh->nodes[node->left + i].min, bvh->nodes[node->left + i].max);
+        return;
+    }
+    for (unsigned int i = node->first_item; i < node->first_item + node->item_count; i++)
+        bvh_box_grow(&node->min, &node->max, bvh->part_min[bvh->items[i]], bvh->part_max[bvh->items[i]]);
+}
+// Splits the items of node_index along the cheapest of BVH_BINS planes per axis by the surface area
+// heuristic, or keeps them as a leaf when no split beats testing them all.
+void bvh_build_node(struct Scene_Bvh* bvh, unsigned int node_index)
+{
+    struct Bvh_Node* node = &bvh->nodes[node_index];
+    bvh_node_fit(bvh, node);
+    for (unsigned int i = node->first_item; i < node->first_item + node->item_count; i++)
+        bvh->leaf_of_part[bvh->items[i]] = node_index;
+    if (node->item_count <= BVH_LEAF_SIZE)
+        return;
+
+    Vec3 centroid_min = V3(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vec3 centroid_max = V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (unsigned int i = node->first_item; i < node->first_item + node->item_count; i++)
+    {
+        Vec3 centroid = MulV3F(AddV3(bvh->part_min[bvh->items[i]], bvh->part_max[bvh->items[i]]), 0.5f);
+        bvh_box_grow(&centroid_min, &centroid_max, centroid, centroid);
+    }
+
+    int best_axis = -1;
+    int best_split = 0;
+    float best_cost = bvh_box_area(node->min, node->max) * (float)node->item_count;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroid_max.Elements[axis] - centroid_min.Elements[axis];
+        if (extent <= 0.0f)
+            continue;
+
+        Vec3 bin_min[BVH_BINS], bin_max[BVH_BINS];
+        unsigned int bin_count[BVH_BINS] = {0};
+        for (int b = 0; b < BVH_BINS; b++)
+        {
+            bin_min[b] = V3(FLT_MAX, FLT_MAX, FLT_MAX);
+            bin_max[b] = V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        }
+        float bin_scale = (float)BVH_BINS / extent;
+        for (unsigned int i = node->first_item; i < node->first_item + node->item_count; i++)
+        {
+            unsigned int item = bvh->items[i];
+            float centroid = (bvh->part_min[item].Elements[axis] + bvh->part_max[item].Elements[axis]) * 0.5f;
+            int b = min((int)((centroid - centroid_min.Elements[axis]) * bin_scale), BVH_BINS - 1);
+            bin_count[b]++;
+            bvh_box_grow(&bin_min[b], &bin_max[b], bvh->part_min[item], bvh->part_max[item]);
+        }
+
+        // Sweep from the right first so every split's cost is one pass from the left.
+        float right_area[BVH_BINS];
+        unsigned int right_count[BVH_BINS];
+        Vec3 sweep_min = V3(FLT_MAX, FLT_MAX, FLT_MAX), sweep_max = V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        unsigned int sweep_count = 0;
+        for (int b = BVH_BINS - 1; b > 0; b--)
+        {
+            bvh_box_grow(&sweep_min, &sweep_max, bin_min[b], bin_max[b]);
+            sweep_count += bin_count[b];
+            right_area[b] = sweep_count ? bvh_box_area(sweep_min, sweep_max) : 0.0f;
+            right_count[b] = sweep_count;
+        }
+        sweep_min = V3(FLT_MAX, FLT_MAX, FLT_MAX), sweep_max = V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        sweep_count = 0;
+        for (int b = 0; b < BVH_BINS - 1; b++)
+        {
+            bvh_box_grow(&sweep_min, &sweep_max, bin_min[b], bin_max[b]);
+            sweep_count += bin_count[b];
+            if (sweep_count == 0 || right_count[b + 1] == 0)
+                continue;
+            float cost = bvh_box_area(sweep_min, sweep_max) * (float)sweep_count + right_area[b + 1] * (float)right_count[b + 1];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b + 1;
+            }
+        }
+    }
+
+    unsigned int split = node->first_item;
+    if (best_axis >= 0)
+    {
+        float bin_scale = (float)BVH_BINS / (centroid_max.Elements[best_axis] - centroid_min.Elements[best_axis]);
+        unsigned int end = node->first_item + node->item_count;
+        for (unsigned int i = node->first_item; i < end;)
+        {
+            unsigned int item = bvh->items[i];
+            float centroid = (bvh->part_min[item].Elements[best_axis] + bvh->part_max[item].Elements[best_axis]) * 0.5f;
+            if (min((int)((centroid - centroid_min.Elements[best_axis]) * bin_scale), BVH_BINS - 1) < best_split)
+                i++;
+            else
+            {
+                bvh->items[i] = bvh->items[--end];
+                bvh->items[end] = item;
+            }
+        }
+        split = end;
+    }
+    else if (node->item_count > BVH_LEAF_SIZE * 4)
+    {
+        // Too many parts sharing one centroid to stay a leaf, halve them as they are.
+        split = node->first_item + node->item_count / 2;
+    }
+    if (split == node->first_item || split == node->first_item + node->item_count)
+        return;
+
+    unsigned int left = (unsigned int)bvh->node_count;
+    bvh->node_count += 2;
+    bvh->nodes[left] = (struct Bvh_Node){ .first_item = node->first_item, .item_count = split - node->first_item };
+    bvh->nodes[left + 1] = (struct Bvh_Node){ .first_item = split, .item_count = node->first_item + node->item_count - split };
+    bvh->parent[left] = bvh->parent[left + 1] = node_index;
+    node->left = left;
+    bvh_build_node(bvh, left);
+    bvh_build_node(bvh, left + 1);
+}
+// Builds scene->bvh over the current world boxes of every drawable part, scene_flatten_bounds has to come first.
+// Children are always placed after their parent, so walking the nodes backwards visits children first.
+void scene_build_bvh(struct Scene* scene)
+{
+    struct Scene_Bounds* bounds = &scene->bounds;
+    struct Scene_Bvh* bvh = &scene->bvh;
+    size_t capacity = max(bounds->count * 2, 1);
+    bvh->nodes = arena_alloc(scene->arena, capacity * sizeof(struct Bvh_Node));
+    bvh->parent = arena_alloc(scene->arena, capacity * sizeof(unsigned int));
+    bvh->dirty = arena_alloc(scene->arena, capacity * sizeof(unsigned char));
+    bvh->dirty_list = arena_alloc(scene->arena, capacity * sizeof(size_t));
+    bvh->items = arena_alloc(scene->arena, max(bounds->count, 1) * sizeof(unsigned int));
+    bvh->leaf_of_part = arena_alloc(scene->arena, max(bounds->count, 1) * sizeof(unsigned int));
+    bvh->part_min = arena_alloc(scene->arena, max(bounds->count, 1) * sizeof(Vec3));
+    bvh->part_max = arena_alloc(scene->arena, max(bounds->count, 1) * sizeof(Vec3));
+    memset(bvh->dirty, 0, capacity * sizeof(unsigned char));
+    bvh->dirty_count = 0;
+
+    unsigned int item_count = 0;
+    for (size_t i = 0; i < bounds->count; i++)
+    {
+        struct Mesh_Part* mesh_part = bounds->mesh_parts[i];
+        bvh->leaf_of_part[i] = BVH_NO_LEAF;
+        if (mesh_part->vertex_count == 0 || mesh_part->index_count == 0)
+            continue;
+        mesh_part_world_box(mesh_part, &scene->transforms.world_geometry[bounds->transform_index[i]], &bvh->part_min[i], &bvh->part_max[i]);
+        bvh->items[item_count++] = (unsigned int)i;
+    }
+
+    bvh->node_count = 1;
+    bvh->nodes[0] = (struct Bvh_Node){ .first_item = 0, .item_count = item_count };
+    bvh->parent[0] = 0;
+    bvh_build_node(bvh, 0);
+}
+// Brings the BVH up to date with the nodes the last transform update touched (transforms->changed_list).
+// Only the boxes above the moved parts are refitted, the tree keeps its shape, so after large moves a
+// rebuild culls better.
+void scene_refit_bvh(struct Scene* scene)
+{
+    struct Scene_Bvh* bvh = &scene->bvh;
+    struct Scene_Transforms* transforms = &scene->transforms;
+    if (!bvh->nodes)
+        return;
+
+    for (size_t c = 0; c < transforms->changed_count; c++)
+    {
+        struct Node* node = transforms->nodes[transforms->changed_list[c]];
+        if (node->type != NODE_TYPE_MESH)
+            continue;
+
+        for (size_t j = 0; j < node->mesh.mesh_parts_count; j++)
+        {
+            struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[j];
+            unsigned int leaf = bvh->leaf_of_part[mesh_part->bounds_index];
+            if (leaf == BVH_NO_LEAF)
+                continue;
+
+            mesh_part_world_box(mesh_part, &transforms->world_geometry[node->transform_index], &bvh->part_min[mesh_part->bounds_index], &bvh->part_max[mesh_part->bounds_index]);
+            for (unsigned int n = leaf; !bvh->dirty[n]; n = bvh->parent[n])
+            {
+                bvh->dirty[n] = 1;
+                bvh->dirty_list[bvh->dirty_count++] = n;
+                if (n == 0)
+                    break;
+            }
+        }
+    }
+
+    qsort(bvh->dirty_list, bvh->dirty_count, sizeof(size_t), compare_size_t);
+    for (size_t i = bvh->dirty_count; i-- > 0;)
+    {
+        bvh_node_fit(bvh, &bvh->nodes[bvh->dirty_list[i]]);
+        bvh->dirty[bvh->dirty_list[i]] = 0;
+    }
+    bvh->dirty_count = 0;
+}
 int mikkt_get_num_faces(const SMikkTSpaceContext *ctx) {
     struct Mesh_Part *mesh = (struct Mesh_Part*)ctx->m_pUserData;
     return (int)mesh->index_count / 3;
@@ -215,482 +1115,4153 @@ void mikkt_set_t_space_basic(const SMikkTSpaceContext *ctx, const float tangent[
     mesh->vertex_array[idx].tangent.Elements[2] = tangent[2];
     mesh->vertex_array[idx].tangent.Elements[3] = sign; // bitangent = cross(normal, tangent) * sign
 }
-struct Mesh_Part load_mesh_part(ufbx_mesh *mesh, ufbx_mesh_part *part, size_t material_index, struct Node* node)
+// Open addressing hash table from texture path to its slot in the root's texture array, built once per
+// scene so material textures resolve without comparing against every texture.
+struct Texture_Index_Entry
 {
-    size_t num_triangles = part->num_triangles;
-    struct Vertex *vertices = calloc(num_triangles * 3, sizeof(struct Vertex));
-    size_t num_vertices = 0;
-
-    size_t num_tri_indices = mesh->max_face_triangles * 3;
-    uint32_t *tri_indices = calloc(num_tri_indices, sizeof(uint32_t));
+    unsigned long long hash;
+    const char* path;
+    struct Texture* texture;
+};
+struct Texture_Index
+{
+    struct Texture_Index_Entry* entries;
+    size_t mask;
+};
+void texture_index_build(struct Texture_Index* index, struct Texture* texture_array, size_t texture_count)
+{
+    size_t capacity = 16;
+    while (capacity < texture_count * 2)
+        capacity *= 2;
+    index->entries = calloc(capacity, sizeof(struct Texture_Index_Entry));
+    index->mask = capacity - 1;
 
-    for (size_t face_ix = 0; face_ix < part->num_faces; face_ix++) 
+    for (size_t i = 0; i < texture_count; i++)
     {
-        ufbx_face face = mesh->faces.data[part->face_indices.data[face_ix]];
-
-        uint32_t num_tris = ufbx_triangulate_face(tri_indices, num_tri_indices, mesh, face);
-
-        for (size_t i = 0; i < num_tris * 3; i++) 
-        {
-            uint32_t index = tri_indices[i];
+        const char* path = texture_array[i].path;
+        unsigned long long hash = hash64(path, strlen(path), 0);
+        size_t slot = (size_t)hash & index->mask;
+        while (index->entries[slot].path && (index->entries[slot].hash != hash || strcmp(index->entries[slot].path, path) != 0))
+            slot = (slot + 1) & index->mask;
+
+        // A later texture with the same path wins, same as the linear search did.
+        index->entries[slot] = (struct Texture_Index_Entry){ hash, path, &texture_array[i] };
+    }
+}
+void texture_index_destroy(struct Texture_Index* index)
+{
+    free(index->entries);
+    index->entries = 0;
+}
+struct Texture* texture_index_find(struct Texture_Index* index, const char* path)
+{
+    if (!index->entries)
+        return 0;
 
-            struct Vertex *v = &vertices[num_vertices++];
-            if (mesh->vertex_position.exists)
-            {
-                ufbx_vec3 pos = ufbx_get_vertex_vec3(&mesh->vertex_position, index);
-                conv_float(pos, v->pos);
-            }
-            if (mesh->vertex_color.exists)
-            {
-                ufbx_vec4 color = ufbx_get_vertex_vec4(&mesh->vertex_color, index);
-                conv_float(color, v->color);
-            }
-            else
+    unsigned long long hash = hash64(path, strlen(path), 0);
+    for (size_t slot = (size_t)hash & index->mask; index->entries[slot].path; slot = (slot + 1) & index->mask)
+    {
+        if (index->entries[slot].hash == hash && strcmp(index->entries[slot].path, path) == 0)
+            return index->entries[slot].texture;
+    }
+    return 0;
+}
+struct Texture* texture_index_find_fbx(struct Texture_Index* index, ufbx_texture* fbx_texture)
+{
+    return fbx_texture ? texture_index_find(index, fbx_texture->filename.data) : 0;
+}
+// The triangles using vertex v are triangles[offset[v]...offset[v + 1]].
+struct Triangle_Adjacency
+{
+    size_t* offset;
+    unsigned int* triangles;
+};
+struct Triangle_Adjacency triangle_adjacency_build(const unsigned int* indices, size_t index_count, size_t vertex_count)
+{
+    struct Triangle_Adjacency adjacency = {
+        .offset = calloc(vertex_count + 1, sizeof(size_t)),
+        .triangles = malloc(index_count * sizeof(unsigned int)),
+    };
+    for (size_t i = 0; i < index_count; i++)
+        adjacency.offset[indices[i] + 1]++;
+    for (size_t v = 0; v < vertex_count; v++)
+        adjacency.offset[v + 1] += adjacency.offset[v];
+
+    size_t* cursor = malloc(vertex_count * sizeof(size_t));
+    memcpy(cursor, adjacency.offset, vertex_count * sizeof(size_t));
+    for (size_t i = 0; i < index_count; i++)
+        adjacency.triangles[cursor[indices[i]]++] = (unsigned int)(i / 3);
+    free(cursor);
+    return adjacency;
+}
+void triangle_adjacency_free(struct Triangle_Adjacency* adjacency)
+{
+    free(adjacency->offset);
+    free(adjacency->triangles);
+}
+
+// Per-vertex tangents built the way MikkTSpace with its default 180 degree threshold builds them, without
+// its welding and grouping passes. load_mesh_part has already welded on every attribute, so each vertex
+// averages, weighted by corner angle, the normal-projected tangent of every triangle around it that has the
+// same uv orientation and is connected to it around the vertex. Triangles are independent and so are
+// vertices, which lets both passes run spread over the thread pool.
+#define TANGENT_CHUNK_SIZE 4096
+struct Tangent_Triangle
+{
+    Vec3 tangent; // Normalized and pointing along increasing u, zero if the triangle has no usable uv mapping.
+    int orientation_preserving;
+    int degenerate; // Two corners share a position, MikkTSpace leaves these out entirely.
+};
+// Compared as floats, so -0 and 0 are the same position.
+int vec3_equal(Vec3 a, Vec3 b)
+{
+    return a.X == b.X && a.Y == b.Y && a.Z == b.Z;
+}
+struct Tangent_Context
+{
+    struct Mesh_Part* mesh_part;
+    const unsigned int* indices;
+    struct Tangent_Triangle* triangles;
+    struct Triangle_Adjacency adjacency;
+    size_t fan_capacity; // The most triangles around one vertex.
+};
+void tangent_triangle_task(void* user, size_t chunk)
+{
+    struct Tangent_Context* context = user;
+    size_t triangle_count = context->mesh_part->index_count / 3;
+    size_t end = min((chunk + 1) * TANGENT_CHUNK_SIZE, triangle_count);
+    for (size_t t = chunk * TANGENT_CHUNK_SIZE; t < end; t++)
+    {
+        const struct Vertex* v1 = &context->mesh_part->vertex_array[context->indices[t * 3 + 0]];
+        const struct Vertex* v2 = &context->mesh_part->vertex_array[context->indices[t * 3 + 1]];
+        const struct Vertex* v3 = &context->mesh_part->vertex_array[context->indices[t * 3 + 2]];
+        float t21x = v2->uv.X - v1->uv.X;
+        float t21y = v2->uv.Y - v1->uv.Y;
+        float t31x = v3->uv.X - v1->uv.X;
+        float t31y = v3->uv.Y - v1->uv.Y;
+        Vec3 d1 = SubV3(v2->pos, v1->pos);
+        Vec3 d2 = SubV3(v3->pos, v1->pos);
+
+        float signed_area = t21x * t31y - t21y * t31x;
+        Vec3 os = SubV3(MulV3F(d1, t31y), MulV3F(d2, t21y));
+        Vec3 ot = AddV3(MulV3F(d1, -t31x), MulV3F(d2, t21x));
+
+        struct Tangent_Triangle triangle = {
+            .orientation_preserving = signed_area > 0.0f,
+            .degenerate = vec3_equal(v1->pos, v2->pos) || vec3_equal(v1->pos, v3->pos) || vec3_equal(v2->pos, v3->pos),
+        };
+        float length_s = LenV3(os);
+        float length_t = LenV3(ot);
+        // Same cutoffs as MikkTSpace's NotZero, triangles that fail them contribute nothing.
+        if (fabsf(signed_area) > FLT_MIN && length_s > FLT_MIN && length_t > FLT_MIN)
+            triangle.tangent = MulV3F(os, (triangle.orientation_preserving ? 1.0f : -1.0f) / length_s);
+        context->triangles[t] = triangle;
+    }
+}
+Vec3 tangent_project(Vec3 v, Vec3 normal)
+{
+    v = SubV3(v, MulV3F(normal, DotV3(normal, v)));
+    float length = LenV3(v);
+    return length > FLT_MIN ? MulV3F(v, 1.0f / length) : v;
+}
+// MikkTSpace groups the triangles around a vertex by walking across the edges they share there, only
+// ever joining triangles of the same uv orientation. Triangles without a usable mapping join any group
+// but add nothing to it. Each task sizes its fan for the busiest vertex of the part.
+struct Tangent_Fan
+{
+    unsigned int* triangles;
+    unsigned int* next; // The corners after and before the vertex, for finding shared edges.
+    unsigned int* previous;
+    unsigned char* in_group;
+    size_t* stack;
+    size_t count;
+};
+struct Tangent_Fan tangent_fan_create(size_t capacity)
+{
+    // One allocation, the widest arrays first so each stays aligned.
+    char* memory = malloc(capacity * (sizeof(size_t) + 3 * sizeof(unsigned int) + sizeof(unsigned char)));
+    struct Tangent_Fan fan = {0};
+    fan.stack = (size_t*)memory;
+    fan.triangles = (unsigned int*)(fan.stack + capacity);
+    fan.next = fan.triangles + capacity;
+    fan.previous = fan.next + capacity;
+    fan.in_group = (unsigned char*)(fan.previous + capacity);
+    return fan;
+}
+void tangent_fan_destroy(struct Tangent_Fan* fan)
+{
+    free(fan->stack);
+}
+int tangent_triangle_usable(const struct Tangent_Triangle* triangle)
+{
+    return DotV3(triangle->tangent, triangle->tangent) > 0.0f;
+}
+void tangent_fan_flood(struct Tangent_Fan* fan, const struct Tangent_Triangle* triangles, size_t seed, int orientation_preserving, int usable_only_through_unusable)
+{
+    // Triangles are marked before they are pushed, so the stack never holds more than the fan.
+    size_t* stack = fan->stack;
+    size_t stack_count = 0;
+    memset(fan->in_group, 0, fan->count);
+    fan->in_group[seed] = 1;
+    stack[stack_count++] = seed;
+    while (stack_count)
+    {
+        size_t a = stack[--stack_count];
+        if (usable_only_through_unusable && tangent_triangle_usable(&triangles[fan->triangles[a]]))
+            continue;
+        for (size_t b = 0; b < fan->count; b++)
+        {
+            const struct Tangent_Triangle* triangle = &triangles[fan->triangles[b]];
+            if (fan->in_group[b] || (fan->next[a] != fan->previous[b] && fan->previous[a] != fan->next[b]))
+                continue;
+            if (!usable_only_through_unusable && tangent_triangle_usable(triangle) && triangle->orientation_preserving != orientation_preserving)
+                continue;
+            fan->in_group[b] = 1;
+            stack[stack_count++] = b;
+        }
+    }
+}
+void tangent_vertex_task(void* user, size_t chunk)
+{
+    struct Tangent_Context* context = user;
+    struct Mesh_Part* mesh_part = context->mesh_part;
+    size_t end = min((chunk + 1) * TANGENT_CHUNK_SIZE, mesh_part->vertex_count);
+    struct Tangent_Fan fan = tangent_fan_create(context->fan_capacity);
+    for (size_t v = chunk * TANGENT_CHUNK_SIZE; v < end; v++)
+    {
+        size_t first = context->adjacency.offset[v];
+        size_t last = context->adjacency.offset[v + 1];
+        if (first == last)
+            continue;
+
+        // Corners are written in triangle order, and a degenerate triangle's corner copies the first
+        // proper triangle's, so that is the triangle whose group the vertex ends up with.
+        fan.count = 0;
+        size_t reference = (size_t)-1;
+        for (size_t j = first; j < last; j++)
+        {
+            unsigned int t = context->adjacency.triangles[j];
+            if (context->triangles[t].degenerate || (j > first && context->adjacency.triangles[j - 1] == t))
+                continue;
+            int corner = context->indices[t * 3 + 0] == v ? 0 : context->indices[t * 3 + 1] == v ? 1 : 2;
+            fan.triangles[fan.count] = t;
+            fan.next[fan.count] = context->indices[t * 3 + (corner + 1) % 3];
+            fan.previous[fan.count] = context->indices[t * 3 + (corner + 2) % 3];
+            if (reference == (size_t)-1 || j == last - 1)
+                reference = fan.count;
+            fan.count++;
+        }
+
+        // A triangle without a usable mapping takes the orientation of the first group that reaches it.
+        if (reference != (size_t)-1 && !tangent_triangle_usable(&context->triangles[fan.triangles[reference]]))
+        {
+            tangent_fan_flood(&fan, context->triangles, reference, 0, 1);
+            size_t seed = (size_t)-1;
+            for (size_t i = 0; i < fan.count; i++)
             {
-                v->color = V4(1.0f, 1.0f, 1.0f, 1.0f);
+                if (fan.in_group[i] && tangent_triangle_usable(&context->triangles[fan.triangles[i]]) && (seed == (size_t)-1 || fan.triangles[i] < fan.triangles[seed]))
+                    seed = i;
             }
-            if (mesh->vertex_normal.exists)
+            reference = seed;
+        }
+        if (reference == (size_t)-1)
+        {
+            mesh_part->vertex_array[v].tangent = V4(1.0f, 0.0f, 0.0f, -1.0f);
+            continue;
+        }
+        int orientation_preserving = context->triangles[fan.triangles[reference]].orientation_preserving;
+        tangent_fan_flood(&fan, context->triangles, reference, orientation_preserving, 0);
+
+        Vec3 normal = mesh_part->vertex_array[v].normal;
+        Vec3 sum = V3(0.0f, 0.0f, 0.0f);
+        for (size_t i = 0; i < fan.count; i++)
+        {
+            struct Tangent_Triangle* triangle = &context->triangles[fan.triangles[i]];
+            if (!fan.in_group[i] || !tangent_triangle_usable(triangle))
+                continue;
+
+            Vec3 p1 = mesh_part->vertex_array[v].pos;
+            Vec3 e1 = tangent_project(SubV3(mesh_part->vertex_array[fan.previous[i]].pos, p1), normal);
+            Vec3 e2 = tangent_project(SubV3(mesh_part->vertex_array[fan.next[i]].pos, p1), normal);
+            float angle = acosf(max(-1.0f, min(1.0f, DotV3(e1, e2))));
+            sum = AddV3(sum, MulV3F(tangent_project(triangle->tangent, normal), angle));
+        }
+
+        float length = LenV3(sum);
+        Vec3 tangent = length > FLT_MIN ? MulV3F(sum, 1.0f / length) : sum;
+        mesh_part->vertex_array[v].tangent = V4V(tangent, orientation_preserving ? 1.0f : -1.0f);
+    }
+    tangent_fan_destroy(&fan);
+}
+void generate_tangents(struct Mesh_Part* mesh_part, const unsigned int* indices, struct Thread_Pool* thread_pool)
+{
+    size_t triangle_count = mesh_part->index_count / 3;
+    struct Tangent_Context context = {
+        .mesh_part = mesh_part,
+        .indices = indices,
+        .triangles = malloc(triangle_count * sizeof(struct Tangent_Triangle)),
+        .adjacency = triangle_adjacency_build(indices, mesh_part->index_count, mesh_part->vertex_count),
+    };
+    for (size_t v = 0; v < mesh_part->vertex_count; v++)
+        context.fan_capacity = max(context.fan_capacity, context.adjacency.offset[v + 1] - context.adjacency.offset[v]);
+    thread_pool_for(thread_pool, tangent_triangle_task, &context, (triangle_count + TANGENT_CHUNK_SIZE - 1) / TANGENT_CHUNK_SIZE);
+    thread_pool_for(thread_pool, tangent_vertex_task, &context, (mesh_part->vertex_count + TANGENT_CHUNK_SIZE - 1) / TANGENT_CHUNK_SIZE);
+    triangle_adjacency_free(&context.adjacency);
+    free(context.triangles);
+}
+
+#define VERTEX_CACHE_SIZE 16
+// Tipsify (Sander, Nehab, Barczak 2007). Fans around one vertex at a time, emitting all its remaining
+// triangles, and moves on to whichever recently used vertex is still in the cache and has the most
+// left to emit, falling back to recent dead ends and then to the next vertex in order.
+void optimize_vertex_cache(unsigned int* indices, size_t index_count, size_t vertex_count)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return;
+
+    struct Triangle_Adjacency adjacency = triangle_adjacency_build(indices, index_count, vertex_count);
+    unsigned int* live_count = calloc(vertex_count, sizeof(unsigned int));
+    for (size_t v = 0; v < vertex_count; v++)
+        live_count[v] = (unsigned int)(adjacency.offset[v + 1] - adjacency.offset[v]);
+
+    size_t* cache_time = calloc(vertex_count, sizeof(size_t));
+    unsigned char* emitted = calloc(triangle_count, sizeof(unsigned char));
+    unsigned int* dead_end = malloc(index_count * sizeof(unsigned int));
+    size_t dead_end_count = 0;
+    unsigned int* candidates = malloc(index_count * sizeof(unsigned int));
+    unsigned int* output = malloc(index_count * sizeof(unsigned int));
+    size_t output_count = 0;
+
+    size_t time = VERTEX_CACHE_SIZE + 1;
+    size_t cursor = 0;
+    long long fan = 0;
+    while (fan >= 0)
+    {
+        size_t candidate_count = 0;
+        for (size_t a = adjacency.offset[fan]; a < adjacency.offset[fan + 1]; a++)
+        {
+            unsigned int triangle = adjacency.triangles[a];
+            if (emitted[triangle])
+                continue;
+
+            for (int k = 0; k < 3; k++)
             {
-                ufbx_vec3 normal = ufbx_get_vertex_vec3(&mesh->vertex_normal, index);
-                conv_float(normal, v->normal);
+                unsigned int v = indices[triangle * 3 + k];
+                output[output_count++] = v;
+                dead_end[dead_end_count++] = v;
+                candidates[candidate_count++] = v;
+                live_count[v]--;
+                if (time - cache_time[v] > VERTEX_CACHE_SIZE)
+                    cache_time[v] = time++;
             }
-            if (mesh->vertex_tangent.exists)
+            emitted[triangle] = 1;
+        }
+
+        // Next fanning vertex: the candidate that will still be in the cache after its own triangles
+        // are emitted, preferring the oldest entry.
+        fan = -1;
+        long long best_priority = -1;
+        for (size_t c = 0; c < candidate_count; c++)
+        {
+            unsigned int v = candidates[c];
+            if (live_count[v] == 0)
+                continue;
+
+            long long priority = 0;
+            if (time - cache_time[v] + 2 * live_count[v] <= VERTEX_CACHE_SIZE)
+                priority = (long long)(time - cache_time[v]);
+            if (priority > best_priority)
             {
-                ufbx_vec3 tangent = ufbx_get_vertex_vec3(&mesh->vertex_tangent, index);
-                conv_float(tangent, v->tangent);
-                v->tangent.W = (float)ufbx_get_vertex_w_vec3(&mesh->vertex_tangent, index);
+                best_priority = priority;
+                fan = v;
             }
-            if (mesh->vertex_uv.exists)
+        }
+
+        if (fan < 0)
+        {
+            while (dead_end_count > 0)
             {
-                ufbx_vec2 uv = ufbx_get_vertex_vec2(&mesh->vertex_uv, index);
-                conv_float(uv, v->uv);
+                unsigned int v = dead_end[--dead_end_count];
+                if (live_count[v] > 0)
+                {
+                    fan = v;
+                    break;
+                }
             }
         }
+        while (fan < 0 && cursor < vertex_count)
+        {
+            if (live_count[cursor] > 0)
+                fan = (long long)cursor;
+            cursor++;
+        }
     }
 
-    free(tri_indices);
-    assert(num_vertices == num_triangles * 3);
+    memcpy(indices, output, output_count * sizeof(unsigned int));
 
-    ufbx_vertex_stream streams[1] = {
-        { vertices, num_vertices, sizeof(struct Vertex) },
-    };
-    size_t num_indices = num_triangles * 3;
-    uint32_t *indices = calloc(num_indices, sizeof(uint32_t));
+    free(live_count);
+    triangle_adjacency_free(&adjacency);
+    free(cache_time);
+    free(emitted);
+    free(dead_end);
+    free(candidates);
+    free(output);
+}
+// Post-transform cache misses for a FIFO cache of VERTEX_CACHE_SIZE entries.
+// ACMR is misses per triangle, ATVR misses per vertex, 1.0 being the best possible.
+struct Vertex_Cache_Stats
+{
+    size_t misses;
+    size_t triangle_count;
+    size_t vertex_count;
+};
+void vertex_cache_stats_add(struct Vertex_Cache_Stats* stats, struct Mesh_Part* mesh_part)
+{
+    size_t* insert_time = malloc(mesh_part->vertex_count * sizeof(size_t));
+    for (size_t i = 0; i < mesh_part->vertex_count; i++)
+        insert_time[i] = (size_t)-1;
 
-    num_vertices = ufbx_generate_indices(streams, 1, indices, num_indices, NULL, NULL);
+    size_t misses = 0;
+    for (size_t i = 0; i < mesh_part->index_count; i++)
+    {
+        unsigned int v = mesh_part_get_index(mesh_part, i);
+        if (insert_time[v] == (size_t)-1 || misses - insert_time[v] >= VERTEX_CACHE_SIZE)
+            insert_time[v] = misses++;
+    }
+    free(insert_time);
 
-    struct Mesh_Part mesh_part = {0};
-    mesh_part.index_array = indices;
-    mesh_part.index_count = num_indices;
-    mesh_part.vertex_array = vertices;
-    mesh_part.vertex_count = num_vertices;
+    stats->misses += misses;
+    stats->triangle_count += mesh_part->index_count / 3;
+    stats->vertex_count += mesh_part->vertex_count;
+}
+double vertex_cache_acmr(struct Vertex_Cache_Stats* stats)
+{
+    return stats->triangle_count ? (double)stats->misses / stats->triangle_count : 0.0;
+}
+double vertex_cache_atvr(struct Vertex_Cache_Stats* stats)
+{
+    return stats->vertex_count ? (double)stats->misses / stats->vertex_count : 0.0;
+}
+// FIFO vertex cache simulation that can be emptied, for splitting the index buffer into clusters.
+struct Vertex_Cache_Simulation
+{
+    size_t* insert_time;
+    size_t misses;
+    size_t reset_time;
+};
+int vertex_cache_simulation_miss(struct Vertex_Cache_Simulation* simulation, unsigned int v)
+{
+    size_t time = simulation->insert_time[v];
+    if (time != (size_t)-1 && time >= simulation->reset_time && simulation->misses - time < VERTEX_CACHE_SIZE)
+        return 0;
+    simulation->insert_time[v] = simulation->misses++;
+    return 1;
+}
+int vertex_cache_simulation_triangle(struct Vertex_Cache_Simulation* simulation, const unsigned int* triangle)
+{
+    return vertex_cache_simulation_miss(simulation, triangle[0]) + vertex_cache_simulation_miss(simulation, triangle[1]) + vertex_cache_simulation_miss(simulation, triangle[2]);
+}
+void vertex_cache_simulation_reset(struct Vertex_Cache_Simulation* simulation)
+{
+    simulation->reset_time = simulation->misses;
+}
 
-    // Generate tangents
-    if (!mesh->vertex_tangent.exists && mesh_part.index_count > 0 && mesh_part.vertex_count > 0)
+#define OVERDRAW_CACHE_THRESHOLD 1.05f
+struct Overdraw_Cluster
+{
+    size_t start;
+    size_t end;
+    float sort_key;
+};
+int overdraw_cluster_compare(const void* a, const void* b)
+{
+    const struct Overdraw_Cluster* cluster_a = a;
+    const struct Overdraw_Cluster* cluster_b = b;
+    if (cluster_a->sort_key != cluster_b->sort_key)
+        return cluster_a->sort_key > cluster_b->sort_key ? -1 : 1;
+    return (cluster_a->start > cluster_b->start) - (cluster_a->start < cluster_b->start);
+}
+// Reorders the clusters of an already cache optimized index buffer so outward facing ones on the outside
+// of the mesh come first and occlude the rest (Sander, Nehab, Barczak 2007). Clusters start where the
+// cache runs cold anyway, and are split further as long as that costs at most OVERDRAW_CACHE_THRESHOLD
+// times the cluster's cache misses.
+void optimize_overdraw(unsigned int* indices, size_t index_count, const struct Vertex* vertices, size_t vertex_count)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return;
+
+    struct Vertex_Cache_Simulation simulation = { .insert_time = malloc(vertex_count * sizeof(size_t)) };
+    for (size_t i = 0; i < vertex_count; i++)
+        simulation.insert_time[i] = (size_t)-1;
+
+    size_t* hard_boundaries = malloc((triangle_count + 1) * sizeof(size_t));
+    hard_boundaries[0] = 0; // The first triangle can miss less than 3 times, e.g. when it is degenerate.
+    size_t hard_boundary_count = 1;
+    for (size_t t = 0; t < triangle_count; t++)
     {
-        SMikkTSpaceInterface mikkt_interface = {0};
-        mikkt_interface.m_getNumFaces          = mikkt_get_num_faces;
-        mikkt_interface.m_getNumVerticesOfFace = mikkt_get_num_vertices_of_face;
-        mikkt_interface.m_getPosition          = mikkt_get_position;
-        mikkt_interface.m_getNormal            = mikkt_get_normal;
-        mikkt_interface.m_getTexCoord          = mikkt_get_tex_coord;
-        mikkt_interface.m_setTSpaceBasic       = mikkt_set_t_space_basic;
-        // mikkt_interface.m_setTSpace         = NULL;  // use setTSpaceBasic instead
-        
-        SMikkTSpaceContext ctx = {0};
-        ctx.m_pInterface = &mikkt_interface;
-        ctx.m_pUserData  = &mesh_part;
-        if (!genTangSpaceDefault(&ctx)) {
-            fprintf(stderr, "MikkTSpace failed!\n");
-            __debugbreak();
-        }
+        if (vertex_cache_simulation_triangle(&simulation, &indices[t * 3]) == 3 && t > 0)
+            hard_boundaries[hard_boundary_count++] = t;
     }
+    hard_boundaries[hard_boundary_count] = triangle_count;
 
-    mesh->materials.data[0]->pbr.base_color.texture;
-    mesh->materials.data[0]->pbr.normal_map.texture;
-    for (size_t i = 0; i < node->texture_count; i++)
+    struct Overdraw_Cluster* clusters = malloc(triangle_count * sizeof(struct Overdraw_Cluster));
+    size_t cluster_count = 0;
+    for (size_t h = 0; h < hard_boundary_count; h++)
     {
-        if (mesh->materials.data[material_index]->pbr.base_color.texture && strcmp(mesh->materials.data[material_index]->pbr.base_color.texture->filename.data, node->texture_array[i].path) == 0)
+        size_t start = hard_boundaries[h];
+        size_t end = hard_boundaries[h + 1];
+
+        vertex_cache_simulation_reset(&simulation);
+        size_t cluster_misses = 0;
+        for (size_t t = start; t < end; t++)
+            cluster_misses += vertex_cache_simulation_triangle(&simulation, &indices[t * 3]);
+        float threshold = OVERDRAW_CACHE_THRESHOLD * (float)cluster_misses / (float)(end - start);
+
+        vertex_cache_simulation_reset(&simulation);
+        size_t misses = 0;
+        size_t soft_start = start;
+        for (size_t t = start; t < end; t++)
         {
-            mesh_part.color_texture = &node->texture_array[i];
+            misses += vertex_cache_simulation_triangle(&simulation, &indices[t * 3]);
+            if (t + 1 < end && (float)misses / (float)(t + 1 - soft_start) <= threshold)
+            {
+                clusters[cluster_count++] = (struct Overdraw_Cluster){ soft_start, t + 1, 0.0f };
+                soft_start = t + 1;
+                misses = 0;
+                vertex_cache_simulation_reset(&simulation);
+            }
         }
-        if (mesh->materials.data[material_index]->pbr.normal_map.texture && strcmp(mesh->materials.data[material_index]->pbr.normal_map.texture->filename.data, node->texture_array[i].path) == 0)
+        clusters[cluster_count++] = (struct Overdraw_Cluster){ soft_start, end, 0.0f };
+    }
+    free(hard_boundaries);
+    free(simulation.insert_time);
+
+    Vec3 mesh_centroid = V3(0.0f, 0.0f, 0.0f);
+    for (size_t i = 0; i < index_count; i++)
+        mesh_centroid = AddV3(mesh_centroid, vertices[indices[i]].pos);
+    mesh_centroid = MulV3F(mesh_centroid, 1.0f / (float)index_count);
+
+    for (size_t c = 0; c < cluster_count; c++)
+    {
+        Vec3 centroid = V3(0.0f, 0.0f, 0.0f);
+        Vec3 normal = V3(0.0f, 0.0f, 0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c].start; t < clusters[c].end; t++)
         {
-            mesh_part.normal_texture = &node->texture_array[i];
+            Vec3 a = vertices[indices[t * 3 + 0]].pos;
+            Vec3 b = vertices[indices[t * 3 + 1]].pos;
+            Vec3 d = vertices[indices[t * 3 + 2]].pos;
+            Vec3 triangle_normal = Cross(SubV3(b, a), SubV3(d, a)); // Outward for our clockwise front faces.
+            float triangle_area = LenV3(triangle_normal);
+            centroid = AddV3(centroid, MulV3F(AddV3(AddV3(a, b), d), triangle_area / 3.0f));
+            normal = AddV3(normal, triangle_normal);
+            area += triangle_area;
         }
+        float normal_length = LenV3(normal);
+        if (area > 0.0f && normal_length > 0.0f)
+            clusters[c].sort_key = DotV3(SubV3(MulV3F(centroid, 1.0f / area), mesh_centroid), MulV3F(normal, 1.0f / normal_length));
     }
+    qsort(clusters, cluster_count, sizeof(struct Overdraw_Cluster), overdraw_cluster_compare);
 
-    return mesh_part;
+    unsigned int* output = malloc(index_count * sizeof(unsigned int));
+    size_t output_count = 0;
+    for (size_t c = 0; c < cluster_count; c++)
+    {
+        size_t count = (clusters[c].end - clusters[c].start) * 3;
+        memcpy(output + output_count, indices + clusters[c].start * 3, count * sizeof(unsigned int));
+        output_count += count;
+    }
+    assert(output_count == triangle_count * 3);
+    memcpy(indices, output, triangle_count * 3 * sizeof(unsigned int));
+    free(output);
+    free(clusters);
 }
-struct Node* load_node(ufbx_node* fbx_node, struct Node* root, ufbx_scene* fbx_scene)
+// Renumbers the vertices in the order the index buffer first uses them, so fetches walk forward through memory.
+void optimize_vertex_fetch(unsigned int* indices, size_t index_count, struct Vertex* vertices, size_t vertex_count)
 {
-    printf("Object: %s\n", fbx_node->name.data);
+    unsigned int* remap = malloc(vertex_count * sizeof(unsigned int));
+    for (size_t i = 0; i < vertex_count; i++)
+        remap[i] = UINT_MAX;
 
-    struct Node* node = node_create();
-    node->name = calloc(sizeof(char), fbx_node->name.length+1);
-    strcpy(node->name, fbx_node->name.data);
-    
-    conv_float(fbx_node->local_transform.translation, node->local_position);
-    conv_float(fbx_node->local_transform.rotation, node->local_rotation);
-    conv_float(fbx_node->local_transform.scale, node->local_scale);
+    struct Vertex* reordered = malloc(vertex_count * sizeof(struct Vertex));
+    unsigned int next = 0;
+    for (size_t i = 0; i < index_count; i++)
+    {
+        unsigned int v = indices[i];
+        if (remap[v] == UINT_MAX)
+        {
+            reordered[next] = vertices[v];
+            remap[v] = next++;
+        }
+        indices[i] = remap[v];
+    }
+    // Anything unreferenced goes at the end.
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        if (remap[v] == UINT_MAX)
+            reordered[next++] = vertices[v];
+    }
 
-    conv_float(fbx_node->geometry_transform.translation, node->geometry_position);
-    conv_float(fbx_node->geometry_transform.rotation, node->geometry_rotation);
-    conv_float(fbx_node->geometry_transform.scale, node->geometry_scale);
+    memcpy(vertices, reordered, vertex_count * sizeof(struct Vertex));
+    free(reordered);
+    free(remap);
+}
 
-    if (fbx_node->mesh)
+// Bytes pulled from the vertex buffer, assuming a vertex cache miss fetches whole 64 byte lines through
+// a FIFO cache of VERTEX_FETCH_CACHE_LINES lines. Overfetch is that over the size of the vertex buffer.
+#define VERTEX_FETCH_CACHE_LINES 256
+struct Vertex_Fetch_Stats
+{
+    size_t bytes_fetched;
+    size_t bytes_total;
+};
+void vertex_fetch_stats_add(struct Vertex_Fetch_Stats* stats, struct Mesh_Part* mesh_part, size_t stride)
+{
+    size_t line_count = (mesh_part->vertex_count * stride + 63) / 64;
+    size_t* line_time = malloc(line_count * sizeof(size_t));
+    for (size_t i = 0; i < line_count; i++)
+        line_time[i] = (size_t)-1;
+    struct Vertex_Cache_Simulation simulation = { .insert_time = malloc(mesh_part->vertex_count * sizeof(size_t)) };
+    for (size_t i = 0; i < mesh_part->vertex_count; i++)
+        simulation.insert_time[i] = (size_t)-1;
+
+    size_t line_misses = 0;
+    for (size_t i = 0; i < mesh_part->index_count; i++)
     {
-        ufbx_mesh* mesh = fbx_node->mesh;
-        printf("-> mesh with %zu faces\n", mesh->faces.count);
-        node->type = NODE_TYPE_MESH;
-        node->mesh.mesh_parts_count = mesh->material_parts.count;
-        node->mesh.mesh_parts = calloc(mesh->material_parts.count, sizeof(struct Mesh_Part));
+        unsigned int v = mesh_part_get_index(mesh_part, i);
+        if (!vertex_cache_simulation_miss(&simulation, v))
+            continue;
 
-        for (size_t i = 0; i < mesh->material_parts.count; i++)
+        for (size_t line = v * stride / 64; line <= (v * stride + stride - 1) / 64; line++)
         {
-            node->mesh.mesh_parts[i] = load_mesh_part(mesh, &mesh->material_parts.data[i], i, root);
+            if (line_time[line] == (size_t)-1 || line_misses - line_time[line] >= VERTEX_FETCH_CACHE_LINES)
+                line_time[line] = line_misses++;
         }
     }
-    else if (fbx_node->light && fbx_node->light->type == UFBX_LIGHT_POINT) {}
-    else if (fbx_node->light && fbx_node->light->type == UFBX_LIGHT_SPOT) {}
-    else if (fbx_node->light && fbx_node->light->type == UFBX_LIGHT_DIRECTIONAL) {}
-    else if (fbx_node->camera) 
+    free(simulation.insert_time);
+    free(line_time);
+
+    stats->bytes_fetched += line_misses * 64;
+    stats->bytes_total += mesh_part->vertex_count * stride;
+}
+double vertex_fetch_overfetch(struct Vertex_Fetch_Stats* stats)
+{
+    return stats->bytes_total ? (double)stats->bytes_fetched / stats->bytes_total : 0.0;
+}
+
+// Estimated overdraw: each mesh part is rasterized in order with a depth test into a small grid from the
+// three axes, with front and back faces in separate buffers so that covers the opposite views as well.
+// Overdraw is pixels shaded over pixels covered, 1.0 meaning every pixel was shaded once.
+#define OVERDRAW_GRID_SIZE 256
+struct Overdraw_Stats
+{
+    size_t pixels_covered;
+    size_t pixels_shaded;
+};
+void overdraw_rasterize(float* depth_buffers, size_t* pixels_shaded, Vec3 a, Vec3 b, Vec3 c)
+{
+    float area = (b.X - a.X) * (c.Y - a.Y) - (b.Y - a.Y) * (c.X - a.X);
+    if (area == 0.0f)
+        return;
+
+    // Triangles facing down the axis are seen from below, the rest from above where depth runs the other way.
+    int facing_up = area > 0.0f;
+    float* depth_buffer = depth_buffers + (facing_up ? OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE : 0);
+    if (facing_up)
     {
-        node->type = NODE_TYPE_CAMERA;
+        a.Z = 1.0f - a.Z;
+        b.Z = 1.0f - b.Z;
+        c.Z = 1.0f - c.Z;
     }
-    else 
+    else
     {
-        node->type = NODE_TYPE_EMPTY;
+        Vec3 swap = b;
+        b = c;
+        c = swap;
+        area = -area;
+    }
 
-        if (fbx_node->is_root)
+    int min_x = max((int)floorf(min(a.X, min(b.X, c.X))), 0);
+    int min_y = max((int)floorf(min(a.Y, min(b.Y, c.Y))), 0);
+    int max_x = min((int)ceilf(max(a.X, max(b.X, c.X))), OVERDRAW_GRID_SIZE - 1);
+    int max_y = min((int)ceilf(max(a.Y, max(b.Y, c.Y))), OVERDRAW_GRID_SIZE - 1);
+    for (int y = min_y; y <= max_y; y++)
+    {
+        for (int x = min_x; x <= max_x; x++)
         {
-            root = node;
-
-            node->texture_count = fbx_scene->textures.count;
-            node->texture_array = calloc(node->texture_count, sizeof(struct Texture));
+            float px = (float)x + 0.5f;
+            float py = (float)y + 0.5f;
+            float w0 = (b.X - px) * (c.Y - py) - (b.Y - py) * (c.X - px);
+            float w1 = (c.X - px) * (a.Y - py) - (c.Y - py) * (a.X - px);
+            float w2 = (a.X - px) * (b.Y - py) - (a.Y - py) * (b.X - px);
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                continue;
 
-            for (size_t i = 0; i < node->texture_count; i++)
+            float z = (w0 * a.Z + w1 * b.Z + w2 * c.Z) / area;
+            float* depth = &depth_buffer[y * OVERDRAW_GRID_SIZE + x];
+            if (z < *depth)
             {
-                ufbx_texture* fbx_texture = fbx_scene->textures.data[i];
-                struct Texture* texture = &node->texture_array[i];
-
-                texture->path = get_asset_path(fbx_texture->relative_filename.data);
+                *depth = z;
+                (*pixels_shaded)++;
             }
-            
         }
     }
+}
+void overdraw_stats_add(struct Overdraw_Stats* stats, struct Mesh_Part* mesh_part)
+{
+    if (mesh_part->vertex_count == 0)
+        return;
 
-    node->child_array = calloc(fbx_node->children.count, sizeof(struct Node*));
-    node->child_count = fbx_node->children.count;
-    for (size_t i = 0; i < fbx_node->children.count; i++) 
+    Vec3 position_min = mesh_part->vertex_array[0].pos;
+    Vec3 position_max = position_min;
+    for (size_t i = 1; i < mesh_part->vertex_count; i++)
     {
-        node->child_array[i] = load_node(fbx_node->children.data[i], root, fbx_scene);
-        node->child_array[i]->parent = node;
-        node->child_array[i]->texture_array = node->texture_array;
-        node->child_array[i]->texture_count = node->texture_count;
+        for (int k = 0; k < 3; k++)
+        {
+            position_min.Elements[k] = min(position_min.Elements[k], mesh_part->vertex_array[i].pos.Elements[k]);
+            position_max.Elements[k] = max(position_max.Elements[k], mesh_part->vertex_array[i].pos.Elements[k]);
+        }
     }
+    Vec3 extent = SubV3(position_max, position_min);
+    float max_extent = max(extent.X, max(extent.Y, extent.Z));
+    if (max_extent <= 0.0f)
+        return;
+    float scale = 1.0f / max_extent;
 
-    return node;
-}
-struct Node* load_fbx(char* path)
-{
-    ufbx_load_opts opts = {
-        .target_axes = {
-			.right = UFBX_COORDINATE_AXIS_POSITIVE_X,
-			.up = UFBX_COORDINATE_AXIS_POSITIVE_Y,
-			.front = UFBX_COORDINATE_AXIS_NEGATIVE_Z, // Could be UFBX_COORDINATE_AXIS_POSITIVE_Z
-		},
-		.target_unit_meters = 1.0f,
-        .generate_missing_normals = TRUE,
-        .handedness_conversion_axis = UFBX_MIRROR_AXIS_X, // Might need to be omited.
-        .handedness_conversion_retain_winding = TRUE,
-        .reverse_winding = TRUE,
-        .space_conversion = UFBX_SPACE_CONVERSION_MODIFY_GEOMETRY,
-        .retain_vertex_attrib_w = TRUE
-    };
-    ufbx_error error;
-    ufbx_scene *fbx_scene = ufbx_load_file(path, &opts, &error);
-    if (!fbx_scene)
+    size_t buffer_size = OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE * 2;
+    float* depth_buffers = malloc(buffer_size * sizeof(float));
+    for (int axis = 0; axis < 3; axis++)
     {
-        fprintf(stderr, "Failed to load: %s\n", error.description.data);
-        exit(1);
-    }
-
-    printf("Scene: %s\n", path);
+        for (size_t i = 0; i < buffer_size; i++)
+            depth_buffers[i] = FLT_MAX;
 
-    struct Node* scene = load_node(fbx_scene->root_node, 0, fbx_scene);
+        for (size_t t = 0; t + 2 < mesh_part->index_count; t += 3)
+        {
+            Vec3 projected[3];
+            for (int k = 0; k < 3; k++)
+            {
+                Vec3 pos = MulV3F(SubV3(mesh_part->vertex_array[mesh_part_get_index(mesh_part, t + k)].pos, position_min), scale);
+                projected[k] = V3(pos.Elements[(axis + 1) % 3] * (OVERDRAW_GRID_SIZE - 1), pos.Elements[(axis + 2) % 3] * (OVERDRAW_GRID_SIZE - 1), pos.Elements[axis]);
+            }
+            overdraw_rasterize(depth_buffers, &stats->pixels_shaded, projected[0], projected[1], projected[2]);
+        }
 
-    ufbx_free_scene(fbx_scene);
-    return scene;
+        for (size_t i = 0; i < buffer_size; i++)
+            stats->pixels_covered += depth_buffers[i] != FLT_MAX;
+    }
+    free(depth_buffers);
+}
+double overdraw_ratio(struct Overdraw_Stats* stats)
+{
+    return stats->pixels_covered ? (double)stats->pixels_shaded / stats->pixels_covered : 0.0;
 }
 
-void load_texture_png(struct Texture *texture, struct Device *device, struct Descriptor_Set *cbv_srv_uav_descriptor_set, struct Command_List *upload_command_list)
+// Bounding sphere (Ritter) and normal cone of one meshlet.
+// Slivers far thinner than the meshlet cover no pixels and their normals are mostly rounding noise, so
+// they are left out of the normal cone.
+Vec3 meshlet_triangle_normal(Vec3 p0, Vec3 p1, Vec3 p2, float radius)
+{
+    Vec3 normal = Cross(SubV3(p1, p0), SubV3(p2, p0)); // Outward for our clockwise front faces.
+    float length = LenV3(normal);
+    if (length <= radius * radius * 1e-6f)
+        return V3(0.0f, 0.0f, 0.0f);
+    return MulV3F(normal, 1.0f / length);
+}
+void meshlet_compute_bounds(struct Meshlet* meshlet, const struct Vertex* vertices, const unsigned int* meshlet_vertices, const unsigned char* meshlet_triangles)
 {
-    int expected_component_count;
-    stbi_info(texture->path, &(int){0}, &(int){0}, &expected_component_count);
+    const unsigned int* local_vertices = meshlet_vertices + meshlet->vertex_offset;
+    const unsigned char* local_triangles = meshlet_triangles + meshlet->triangle_offset * 3;
 
-    stbi_set_flip_vertically_on_load(1);
-    int x;
-    int y;
-    int component_count;
-    unsigned char *image_data = stbi_load(texture->path, &x, &y, &component_count, (expected_component_count == 3) ? 4 : 0);
-    if (expected_component_count == 3)
-        component_count = 4;
+    Vec3 first = vertices[local_vertices[0]].pos;
+    Vec3 a = first;
+    for (unsigned int i = 0; i < meshlet->vertex_count; i++)
+    {
+        Vec3 pos = vertices[local_vertices[i]].pos;
+        if (LenSqrV3(SubV3(pos, first)) > LenSqrV3(SubV3(a, first)))
+            a = pos;
+    }
+    Vec3 b = a;
+    for (unsigned int i = 0; i < meshlet->vertex_count; i++)
+    {
+        Vec3 pos = vertices[local_vertices[i]].pos;
+        if (LenSqrV3(SubV3(pos, a)) > LenSqrV3(SubV3(b, a)))
+            b = pos;
+    }
+    Vec3 center = MulV3F(AddV3(a, b), 0.5f);
+    float radius = LenV3(SubV3(b, a)) * 0.5f;
+    for (unsigned int i = 0; i < meshlet->vertex_count; i++)
+    {
+        Vec3 pos = vertices[local_vertices[i]].pos;
+        float distance = LenV3(SubV3(pos, center));
+        if (distance > radius)
+        {
+            float new_radius = (radius + distance) * 0.5f;
+            center = AddV3(center, MulV3F(SubV3(pos, center), (new_radius - radius) / distance));
+            radius = new_radius;
+        }
+    }
+    meshlet->center = center;
+    meshlet->radius = radius;
 
-    enum FORMAT formats[] = {FORMAT_UNKNOWN, FORMAT_R8_UNORM, FORMAT_R8G8_UNORM, FORMAT_R8G8B8A8_UNORM, FORMAT_R8G8B8A8_UNORM};
+    Vec3 normals[MESHLET_MAX_TRIANGLES];
+    Vec3 axis = V3(0.0f, 0.0f, 0.0f);
+    for (unsigned int t = 0; t < meshlet->triangle_count; t++)
+    {
+        Vec3 p0 = vertices[local_vertices[local_triangles[t * 3 + 0]]].pos;
+        Vec3 p1 = vertices[local_vertices[local_triangles[t * 3 + 1]]].pos;
+        Vec3 p2 = vertices[local_vertices[local_triangles[t * 3 + 2]]].pos;
+        normals[t] = meshlet_triangle_normal(p0, p1, p2, radius);
+        axis = AddV3(axis, normals[t]);
+    }
 
-    struct Buffer_Descriptor buffer_description = {
-        .width = (unsigned long long)x,
-        .height = (unsigned long long)y,
-        .buffer_type = BUFFER_TYPE_TEXTRUE2D,
-        .bind_types = {
-            BIND_TYPE_SRV
-        },
-        .bind_types_count = 1,
-        .format = formats[component_count]};
-    device_create_buffer(device, buffer_description, &texture->buffer);
+    meshlet->cone_apex = center;
+    meshlet->cone_axis = V3(0.0f, 0.0f, 1.0f);
+    meshlet->cone_cutoff = 1.0f;
+    float axis_length = LenV3(axis);
+    if (axis_length <= 0.0f)
+        return;
+    axis = MulV3F(axis, 1.0f / axis_length);
+
+    float min_dot = 1.0f;
+    for (unsigned int t = 0; t < meshlet->triangle_count; t++)
+    {
+        if (DotV3(normals[t], normals[t]) > 0.0f)
+            min_dot = min(min_dot, DotV3(normals[t], axis));
+    }
+    // Past roughly 84 degrees the cone hardly ever culls and the apex runs off towards infinity.
+    if (min_dot <= 0.1f)
+        return;
+
+    // Move the apex back along the axis until every triangle's plane is in front of it.
+    float max_t = 0.0f;
+    for (unsigned int t = 0; t < meshlet->triangle_count; t++)
+    {
+        if (DotV3(normals[t], normals[t]) <= 0.0f)
+            continue;
+        Vec3 p0 = vertices[local_vertices[local_triangles[t * 3 + 0]]].pos;
+        float plane_distance = DotV3(SubV3(center, p0), normals[t]);
+        max_t = max(max_t, plane_distance / DotV3(axis, normals[t]));
+    }
+    meshlet->cone_apex = SubV3(center, MulV3F(axis, max_t));
+    meshlet->cone_axis = axis;
+    meshlet->cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+}
+// Greedily grows meshlets: the next triangle is the one around the last added triangle, or failing that
+// around any vertex already in the meshlet, that adds the fewest new vertices. Only when nothing connects
+// does it move on to the next unused triangle in index order.
+void build_meshlets(struct Mesh_Part* mesh_part, struct Arena* arena)
+{
+    size_t triangle_count = mesh_part->index_count / 3;
+    if (triangle_count == 0)
+        return;
+
+    unsigned int* indices = malloc(mesh_part->index_count * sizeof(unsigned int));
+    for (size_t i = 0; i < mesh_part->index_count; i++)
+        indices[i] = mesh_part_get_index(mesh_part, i);
+    struct Triangle_Adjacency adjacency = triangle_adjacency_build(indices, mesh_part->index_count, mesh_part->vertex_count);
+
+    struct Meshlet* meshlets = malloc(triangle_count * sizeof(struct Meshlet));
+    unsigned int* meshlet_vertices = malloc(mesh_part->index_count * sizeof(unsigned int));
+    unsigned char* meshlet_triangles = malloc(mesh_part->index_count);
+    unsigned char* local_index = malloc(mesh_part->vertex_count);
+    memset(local_index, 0xff, mesh_part->vertex_count);
+    unsigned char* emitted = calloc(triangle_count, 1);
+
+    size_t meshlet_count = 0;
+    struct Meshlet meshlet = {0};
+    size_t last_triangle = 0;
+    size_t cursor = 0;
+    for (size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++)
+    {
+        size_t best_triangle = (size_t)-1;
+        int best_score = 4;
+        for (int pass = 0; pass < 2 && meshlet.triangle_count > 0 && best_triangle == (size_t)-1; pass++)
+        {
+            size_t source_count = pass == 0 ? 3 : meshlet.vertex_count;
+            for (size_t k = 0; k < source_count; k++)
+            {
+                unsigned int v = pass == 0 ? indices[last_triangle * 3 + k] : meshlet_vertices[meshlet.vertex_offset + k];
+                for (size_t a = adjacency.offset[v]; a < adjacency.offset[v + 1]; a++)
+                {
+                    unsigned int triangle = adjacency.triangles[a];
+                    if (emitted[triangle])
+                        continue;
+
+                    int score = 0;
+                    for (int j = 0; j < 3; j++)
+                        score += local_index[indices[triangle * 3 + j]] == 0xff;
+                    if (score < best_score || (score == best_score && triangle < best_triangle))
+                    {
+                        best_score = score;
+                        best_triangle = triangle;
+                    }
+                }
+            }
+        }
+        if (best_triangle == (size_t)-1)
+        {
+            while (emitted[cursor])
+                cursor++;
+            best_triangle = cursor;
+            best_score = 0;
+            for (int j = 0; j < 3; j++)
+                best_score += local_index[indices[best_triangle * 3 + j]] == 0xff;
+        }
+
+        if (meshlet.vertex_count + best_score > MESHLET_MAX_VERTICES || meshlet.triangle_count + 1 > MESHLET_MAX_TRIANGLES)
+        {
+            meshlet_compute_bounds(&meshlet, mesh_part->vertex_array, meshlet_vertices, meshlet_triangles);
+            meshlets[meshlet_count++] = meshlet;
+            for (unsigned int k = 0; k < meshlet.vertex_count; k++)
+                local_index[meshlet_vertices[meshlet.vertex_offset + k]] = 0xff;
+            meshlet = (struct Meshlet){ .vertex_offset = meshlet.vertex_offset + meshlet.vertex_count, .triangle_offset = meshlet.triangle_offset + meshlet.triangle_count };
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned int v = indices[best_triangle * 3 + j];
+            if (local_index[v] == 0xff)
+            {
+                local_index[v] = (unsigned char)meshlet.vertex_count;
+                meshlet_vertices[meshlet.vertex_offset + meshlet.vertex_count++] = v;
+            }
+            meshlet_triangles[(meshlet.triangle_offset + meshlet.triangle_count) * 3 + j] = local_index[v];
+        }
+        meshlet.triangle_count++;
+        emitted[best_triangle] = 1;
+        last_triangle = best_triangle;
+    }
+    meshlet_compute_bounds(&meshlet, mesh_part->vertex_array, meshlet_vertices, meshlet_triangles);
+    meshlets[meshlet_count++] = meshlet;
+
+    mesh_part->meshlet_count = meshlet_count;
+    mesh_part->meshlet_vertex_count = meshlet.vertex_offset + meshlet.vertex_count;
+    mesh_part->meshlet_triangle_count = meshlet.triangle_offset + meshlet.triangle_count;
+    mesh_part->meshlet_array = arena_alloc(arena, meshlet_count * sizeof(struct Meshlet));
+    memcpy(mesh_part->meshlet_array, meshlets, meshlet_count * sizeof(struct Meshlet));
+    mesh_part->meshlet_vertex_array = arena_alloc(arena, mesh_part->meshlet_vertex_count * sizeof(unsigned int));
+    memcpy(mesh_part->meshlet_vertex_array, meshlet_vertices, mesh_part->meshlet_vertex_count * sizeof(unsigned int));
+    mesh_part->meshlet_triangle_array = arena_alloc(arena, mesh_part->meshlet_triangle_count * 3);
+    memcpy(mesh_part->meshlet_triangle_array, meshlet_triangles, mesh_part->meshlet_triangle_count * 3);
+
+    free(indices);
+    triangle_adjacency_free(&adjacency);
+    free(meshlets);
+    free(meshlet_vertices);
+    free(meshlet_triangles);
+    free(local_index);
+    free(emitted);
+}
+
+// Garland-Heckbert error quadric: the sum of area weighted squared distances to a set of planes.
+struct Quadric
+{
+    double a00, a11, a22, a01, a02, a12;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+struct Quadric quadric_from_triangle(Vec3 p0, Vec3 p1, Vec3 p2)
+{
+    Vec3 normal = Cross(SubV3(p1, p0), SubV3(p2, p0));
+    float length = LenV3(normal);
+    if (length <= 0.0f)
+        return (struct Quadric){0};
+    normal = MulV3F(normal, 1.0f / length);
+    double weight = length * 0.5;
+    double x = normal.X, y = normal.Y, z = normal.Z;
+    double d = -DotV3(normal, p0);
+    return (struct Quadric){
+        .a00 = weight * x * x, .a11 = weight * y * y, .a22 = weight * z * z,
+        .a01 = weight * x * y, .a02 = weight * x * z, .a12 = weight * y * z,
+        .b0 = weight * x * d, .b1 = weight * y * d, .b2 = weight * z * d,
+        .c = weight * d * d,
+        .weight = weight,
+    };
+}
+void quadric_add(struct Quadric* a, const struct Quadric* b)
+{
+    a->a00 += b->a00; a->a11 += b->a11; a->a22 += b->a22;
+    a->a01 += b->a01; a->a02 += b->a02; a->a12 += b->a12;
+    a->b0 += b->b0; a->b1 += b->b1; a->b2 += b->b2;
+    a->c += b->c;
+    a->weight += b->weight;
+}
+// Mean squared distance from p to the quadric's planes.
+double quadric_error(const struct Quadric* q, Vec3 p)
+{
+    if (q->weight <= 0.0)
+        return 0.0;
+    double x = p.X, y = p.Y, z = p.Z;
+    double error = q->a00 * x * x + q->a11 * y * y + q->a22 * z * z
+        + 2.0 * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z)
+        + 2.0 * (q->b0 * x + q->b1 * y + q->b2 * z)
+        + q->c;
+    return error > 0.0 ? error / q->weight : 0.0;
+}
+
+struct Edge_Collapse
+{
+    float cost;
+    unsigned int from;
+    unsigned int to;
+};
+int edge_collapse_compare(const void* a, const void* b)
+{
+    float cost_a = ((const struct Edge_Collapse*)a)->cost;
+    float cost_b = ((const struct Edge_Collapse*)b)->cost;
+    return (cost_a > cost_b) - (cost_a < cost_b);
+}
+
+// Open addressing set of directed edges between position classes, counting how often each occurs.
+struct Edge_Count_Table
+{
+    unsigned long long* keys;
+    unsigned int* counts;
+    size_t mask;
+};
+struct Edge_Count_Table edge_count_table_create(size_t edge_count)
+{
+    size_t capacity = 16;
+    while (capacity < edge_count * 2)
+        capacity *= 2;
+    struct Edge_Count_Table table = {
+        .keys = malloc(capacity * sizeof(unsigned long long)),
+        .counts = calloc(capacity, sizeof(unsigned int)),
+        .mask = capacity - 1,
+    };
+    memset(table.keys, 0xff, capacity * sizeof(unsigned long long));
+    return table;
+}
+unsigned int* edge_count_table_slot(struct Edge_Count_Table* table, unsigned int a, unsigned int b, int insert)
+{
+    unsigned long long key = ((unsigned long long)a << 32) | b;
+    for (size_t slot = hash64(&key, sizeof(key), 0) & table->mask;; slot = (slot + 1) & table->mask)
+    {
+        if (table->keys[slot] == key)
+            return &table->counts[slot];
+        if (table->keys[slot] == ~0ull)
+        {
+            if (!insert)
+                return 0;
+            table->keys[slot] = key;
+            return &table->counts[slot];
+        }
+    }
+}
+void edge_count_table_destroy(struct Edge_Count_Table* table)
+{
+    free(table->keys);
+    free(table->counts);
+}
+
+// Maps every vertex to the first vertex sharing its exact position. Vertices split by a normal or uv seam
+// end up in the same class.
+unsigned int* build_position_classes(const struct Vertex* vertices, size_t vertex_count, unsigned int* class_sizes)
+{
+    size_t capacity = 16;
+    while (capacity < vertex_count * 2)
+        capacity *= 2;
+    unsigned int* table = malloc(capacity * sizeof(unsigned int));
+    memset(table, 0xff, capacity * sizeof(unsigned int));
+    unsigned int* position_class = malloc(vertex_count * sizeof(unsigned int));
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        size_t slot = hash64(&vertices[v].pos, sizeof(Vec3), 0) & (capacity - 1);
+        while (table[slot] != ~0u && memcmp(&vertices[table[slot]].pos, &vertices[v].pos, sizeof(Vec3)) != 0)
+            slot = (slot + 1) & (capacity - 1);
+        if (table[slot] == ~0u)
+            table[slot] = (unsigned int)v;
+        position_class[v] = table[slot];
+        class_sizes[table[slot]]++;
+    }
+    free(table);
+    return position_class;
+}
+
+// Removes collapsed edges one pass at a time until at most target_index_count indices are left or no
+// collapse is allowed any more. Every collapse moves a vertex onto one of its neighbours, so the result
+// keeps indexing the original vertex array. Vertices on seams, open borders and non-manifold edges never
+// move, which keeps the outline of the part and its neighbours crack free. Returns the new index count
+// and raises *error to the largest error a collapse introduced.
+size_t simplify_to(unsigned int* indices, size_t index_count, size_t target_index_count, const struct Vertex* vertices, size_t vertex_count,
+    const unsigned int* position_class, const unsigned char* locked, struct Quadric* quadrics, float* error)
+{
+    unsigned int* collapse_to = malloc(vertex_count * sizeof(unsigned int));
+    unsigned char* touched = malloc(vertex_count);
+    struct Edge_Collapse* collapses = malloc(index_count * 2 * sizeof(struct Edge_Collapse));
+
+    while (index_count > target_index_count)
+    {
+        size_t collapse_count = 0;
+        for (size_t i = 0; i < index_count; i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[i + k];
+                unsigned int b = indices[i + (k + 1) % 3];
+                unsigned int class_a = position_class[a];
+                unsigned int class_b = position_class[b];
+                if (class_a == class_b)
+                    continue;
+                struct Quadric q = quadrics[class_a];
+                quadric_add(&q, &quadrics[class_b]);
+                if (!locked[class_a])
+                    collapses[collapse_count++] = (struct Edge_Collapse){ (float)quadric_error(&q, vertices[b].pos), a, b };
+                if (!locked[class_b])
+                    collapses[collapse_count++] = (struct Edge_Collapse){ (float)quadric_error(&q, vertices[a].pos), b, a };
+            }
+        }
+        if (collapse_count == 0)
+            break;
+        qsort(collapses, collapse_count, sizeof(struct Edge_Collapse), edge_collapse_compare);
+
+        struct Triangle_Adjacency adjacency = triangle_adjacency_build(indices, index_count, vertex_count);
+        for (size_t v = 0; v < vertex_count; v++)
+            collapse_to[v] = (unsigned int)v;
+        memset(touched, 0, vertex_count);
+
+        // Each collapse removes about two triangles. Only touch vertices whose neighbourhood no other
+        // collapse in this pass changed, so the flip test below sees the final geometry.
+        size_t triangles_to_remove = (index_count - target_index_count) / 3;
+        size_t triangles_removed = 0;
+        size_t applied = 0;
+        for (size_t c = 0; c < collapse_count && triangles_removed < triangles_to_remove; c++)
+        {
+            unsigned int from = collapses[c].from;
+            unsigned int to = collapses[c].to;
+            unsigned int class_from = position_class[from];
+            unsigned int class_to = position_class[to];
+            if (touched[class_from] || touched[class_to])
+                continue;
+
+            Vec3 target = vertices[to].pos;
+            int flips = 0;
+            size_t removed = 0;
+            for (size_t j = adjacency.offset[from]; j < adjacency.offset[from + 1] && !flips; j++)
+            {
+                const unsigned int* triangle = &indices[adjacency.triangles[j] * 3];
+                if (position_class[triangle[0]] == class_to || position_class[triangle[1]] == class_to || position_class[triangle[2]] == class_to)
+                {
+                    removed++;
+                    continue;
+                }
+                Vec3 p[3], q[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    p[k] = vertices[triangle[k]].pos;
+                    q[k] = triangle[k] == from ? target : p[k];
+                }
+                Vec3 before = Cross(SubV3(p[1], p[0]), SubV3(p[2], p[0]));
+                Vec3 after = Cross(SubV3(q[1], q[0]), SubV3(q[2], q[0]));
+                // Also refuses collapses that would fold a triangle over more than about 75 degrees.
+                if (DotV3(before, after) <= 0.25f * LenV3(before) * LenV3(after))
+                    flips = 1;
+            }
+            if (flips)
+                continue;
+
+            collapse_to[from] = to;
+            quadric_add(&quadrics[class_to], &quadrics[class_from]);
+            *error = max(*error, sqrtf(collapses[c].cost));
+            touched[class_from] = 1;
+            touched[class_to] = 1;
+            for (size_t j = adjacency.offset[from]; j < adjacency.offset[from + 1]; j++)
+            {
+                const unsigned int* triangle = &indices[adjacency.triangles[j] * 3];
+                for (int k = 0; k < 3; k++)
+                    touched[position_class[triangle[k]]] = 1;
+            }
+            triangles_removed += removed;
+            applied++;
+        }
+        triangle_adjacency_free(&adjacency);
+        if (applied == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t i = 0; i < index_count; i += 3)
+        {
+            unsigned int a = collapse_to[indices[i + 0]];
+            unsigned int b = collapse_to[indices[i + 1]];
+            unsigned int c = collapse_to[indices[i + 2]];
+            if (position_class[a] == position_class[b] || position_class[b] == position_class[c] || position_class[a] == position_class[c])
+                continue;
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        index_count = write;
+    }
+
+    free(collapse_to);
+    free(touched);
+    free(collapses);
+    return index_count;
+}
+
+// Builds the LOD chain of a mesh by repeatedly halving its triangle count. Returns every level's indices
+// one after the other, the full mesh first, and fills lods and lod_count to match. The chain ends early
+// once a level would no longer save a meaningful number of triangles.
+unsigned int* build_lod_chain(const unsigned int* indices, size_t index_count, const struct Vertex* vertices, size_t vertex_count,
+    struct Mesh_Lod* lods, unsigned int* lod_count)
+{
+    unsigned int* chain = malloc(index_count * sizeof(unsigned int));
+    memcpy(chain, indices, index_count * sizeof(unsigned int));
+    lods[0] = (struct Mesh_Lod){ .index_offset = 0, .index_count = index_count, .error = 0.0f };
+    *lod_count = 1;
+    if (index_count < 3 || vertex_count == 0)
+        return chain;
+
+    unsigned int* class_sizes = calloc(vertex_count, sizeof(unsigned int));
+    unsigned int* position_class = build_position_classes(vertices, vertex_count, class_sizes);
+
+    // Every class edge has to be matched by exactly one opposite edge, otherwise it is on a border or non-manifold.
+    unsigned char* locked = calloc(vertex_count, 1);
+    struct Edge_Count_Table edges = edge_count_table_create(index_count);
+    for (size_t i = 0; i < index_count; i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = position_class[indices[i + k]];
+            unsigned int b = position_class[indices[i + (k + 1) % 3]];
+            (*edge_count_table_slot(&edges, a, b, 1))++;
+        }
+    }
+    for (size_t i = 0; i < index_count; i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = position_class[indices[i + k]];
+            unsigned int b = position_class[indices[i + (k + 1) % 3]];
+            unsigned int* opposite = edge_count_table_slot(&edges, b, a, 0);
+            if (a == b || !opposite || *opposite != 1 || *edge_count_table_slot(&edges, a, b, 0) != 1)
+                locked[a] = locked[b] = 1;
+        }
+    }
+    edge_count_table_destroy(&edges);
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        if (class_sizes[position_class[v]] > 1)
+            locked[position_class[v]] = 1;
+    }
+
+    struct Quadric* quadrics = calloc(vertex_count, sizeof(struct Quadric));
+    for (size_t i = 0; i < index_count; i += 3)
+    {
+        struct Quadric q = quadric_from_triangle(vertices[indices[i]].pos, vertices[indices[i + 1]].pos, vertices[indices[i + 2]].pos);
+        for (int k = 0; k < 3; k++)
+            quadric_add(&quadrics[position_class[indices[i + k]]], &q);
+    }
+
+    unsigned int* current = malloc(index_count * sizeof(unsigned int));
+    memcpy(current, indices, index_count * sizeof(unsigned int));
+    size_t current_count = index_count;
+    size_t chain_count = index_count;
+    float error = 0.0f;
+    while (*lod_count < MESH_LOD_MAX && current_count >= 3 * 64)
+    {
+        size_t target = current_count / 6 * 3;
+        size_t simplified_count = simplify_to(current, current_count, target, vertices, vertex_count, position_class, locked, quadrics, &error);
+        if (simplified_count == 0 || simplified_count > current_count * 4 / 5)
+            break;
+        current_count = simplified_count;
+
+        chain = realloc(chain, (chain_count + current_count) * sizeof(unsigned int));
+        memcpy(chain + chain_count, current, current_count * sizeof(unsigned int));
+        lods[(*lod_count)++] = (struct Mesh_Lod){ .index_offset = chain_count, .index_count = current_count, .error = error };
+        chain_count += current_count;
+    }
+
+    free(current);
+    free(quadrics);
+    free(locked);
+    free(position_class);
+    free(class_sizes);
+    return chain;
+}
+
+void load_mesh_vertex(ufbx_mesh* mesh, uint32_t index, struct Vertex* v)
+{
+    memset(v, 0, sizeof(struct Vertex));
+    if (mesh->vertex_position.exists)
+    {
+        ufbx_vec3 pos = ufbx_get_vertex_vec3(&mesh->vertex_position, index);
+        conv_float(pos, v->pos);
+    }
+    if (mesh->vertex_color.exists)
+    {
+        ufbx_vec4 color = ufbx_get_vertex_vec4(&mesh->vertex_color, index);
+        conv_float(color, v->color);
+    }
+    else
+    {
+        v->color = V4(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+    if (mesh->vertex_normal.exists)
+    {
+        ufbx_vec3 normal = ufbx_get_vertex_vec3(&mesh->vertex_normal, index);
+        conv_float(normal, v->normal);
+    }
+    if (mesh->vertex_tangent.exists)
+    {
+        ufbx_vec3 tangent = ufbx_get_vertex_vec3(&mesh->vertex_tangent, index);
+        conv_float(tangent, v->tangent);
+        v->tangent.W = (float)ufbx_get_vertex_w_vec3(&mesh->vertex_tangent, index);
+    }
+    if (mesh->vertex_uv.exists)
+    {
+        ufbx_vec2 uv = ufbx_get_vertex_vec2(&mesh->vertex_uv, index);
+        conv_float(uv, v->uv);
+    }
+}
+
+// Welds vertices as they are extracted instead of expanding every triangle corner first. Vertices are
+// compared byte for byte and numbered in order of first use, which is exactly what ufbx_generate_indices
+// does, so the result is the same down to the bit.
+struct Vertex_Welder
+{
+    struct Vertex* vertices;
+    size_t count;
+    size_t capacity;
+    unsigned int* table; // Indices into vertices, ~0u for empty slots.
+    size_t table_capacity;
+    size_t bytes;
+    size_t peak_bytes;
+};
+void vertex_welder_track(struct Vertex_Welder* welder, size_t freed, size_t allocated)
+{
+    welder->peak_bytes = max(welder->peak_bytes, welder->bytes + allocated);
+    welder->bytes = welder->bytes + allocated - freed;
+}
+void vertex_welder_rehash(struct Vertex_Welder* welder, size_t table_capacity)
+{
+    vertex_welder_track(welder, welder->table_capacity * sizeof(unsigned int), table_capacity * sizeof(unsigned int));
+    free(welder->table);
+    welder->table = malloc(table_capacity * sizeof(unsigned int));
+    memset(welder->table, 0xff, table_capacity * sizeof(unsigned int));
+    welder->table_capacity = table_capacity;
+    for (size_t i = 0; i < welder->count; i++)
+    {
+        size_t slot = hash64(&welder->vertices[i], sizeof(struct Vertex), 0) & (table_capacity - 1);
+        while (welder->table[slot] != ~0u)
+            slot = (slot + 1) & (table_capacity - 1);
+        welder->table[slot] = (unsigned int)i;
+    }
+}
+// A closed mesh has about half as many vertices as triangles, so start there and grow as needed.
+struct Vertex_Welder vertex_welder_create(size_t corner_count)
+{
+    struct Vertex_Welder welder = { .capacity = max(corner_count / 6, (size_t)64) };
+    welder.vertices = malloc(welder.capacity * sizeof(struct Vertex));
+    vertex_welder_track(&welder, 0, welder.capacity * sizeof(struct Vertex));
+    size_t table_capacity = 128;
+    while (table_capacity < welder.capacity * 2)
+        table_capacity *= 2;
+    vertex_welder_rehash(&welder, table_capacity);
+    return welder;
+}
+unsigned int vertex_welder_add(struct Vertex_Welder* welder, const struct Vertex* vertex)
+{
+    size_t mask = welder->table_capacity - 1;
+    size_t slot = hash64(vertex, sizeof(struct Vertex), 0) & mask;
+    for (; welder->table[slot] != ~0u; slot = (slot + 1) & mask)
+    {
+        if (memcmp(&welder->vertices[welder->table[slot]], vertex, sizeof(struct Vertex)) == 0)
+            return welder->table[slot];
+    }
+
+    if (welder->count == welder->capacity)
+    {
+        size_t capacity = welder->capacity * 2;
+        vertex_welder_track(welder, welder->capacity * sizeof(struct Vertex), capacity * sizeof(struct Vertex));
+        welder->vertices = realloc(welder->vertices, capacity * sizeof(struct Vertex));
+        welder->capacity = capacity;
+    }
+    unsigned int index = (unsigned int)welder->count++;
+    welder->vertices[index] = *vertex;
+    if (welder->count * 2 > welder->table_capacity)
+        vertex_welder_rehash(welder, welder->table_capacity * 2);
+    else
+        welder->table[slot] = index;
+    return index;
+}
+void vertex_welder_destroy(struct Vertex_Welder* welder)
+{
+    free(welder->vertices);
+    free(welder->table);
+}
+// Triangulates the part's faces and feeds every corner through the welder, writing one index per corner.
+void load_mesh_part_vertices(ufbx_mesh* mesh, ufbx_mesh_part* part, struct Vertex_Welder* welder, uint32_t* indices)
+{
+    size_t num_tri_indices = mesh->max_face_triangles * 3;
+    uint32_t *tri_indices = calloc(num_tri_indices, sizeof(uint32_t));
+    size_t num_corners = 0;
+
+    for (size_t face_ix = 0; face_ix < part->num_faces; face_ix++)
+    {
+        ufbx_face face = mesh->faces.data[part->face_indices.data[face_ix]];
+
+        uint32_t num_tris = ufbx_triangulate_face(tri_indices, num_tri_indices, mesh, face);
+
+        for (size_t i = 0; i < num_tris * 3; i++)
+        {
+            struct Vertex v;
+            load_mesh_vertex(mesh, tri_indices[i], &v);
+            indices[num_corners++] = vertex_welder_add(welder, &v);
+        }
+    }
+
+    free(tri_indices);
+    assert(num_corners == part->num_triangles * 3);
+}
+
+// thread_pool, if any, is only used to split the work on this one part.
+struct Mesh_Part load_mesh_part(ufbx_mesh *mesh, ufbx_mesh_part *part, size_t material_index, struct Texture_Index* texture_index, struct Arena* arena, struct Thread_Pool* thread_pool)
+{
+    size_t num_triangles = part->num_triangles;
+    size_t num_indices = num_triangles * 3;
+    uint32_t *indices = calloc(num_indices, sizeof(uint32_t));
+
+    struct Vertex_Welder welder = vertex_welder_create(num_indices);
+    load_mesh_part_vertices(mesh, part, &welder, indices);
+    size_t num_vertices = welder.count;
+
+    // Only the welded vertices move into the scene, the welder's slack goes away.
+    struct Vertex *welded_vertices = arena_alloc(arena, num_vertices * sizeof(struct Vertex));
+    memcpy(welded_vertices, welder.vertices, num_vertices * sizeof(struct Vertex));
+    vertex_welder_destroy(&welder);
+
+    struct Mesh_Part mesh_part = {0};
+    mesh_part.index_array = indices;
+    mesh_part.index_count = num_indices;
+    mesh_part.vertex_array = welded_vertices;
+    mesh_part.vertex_count = num_vertices;
+
+    // Generate tangents
+    if (!mesh->vertex_tangent.exists && mesh_part.index_count > 0 && mesh_part.vertex_count > 0 && MeshProcessOptions.fast_tangents)
+    {
+        generate_tangents(&mesh_part, indices, thread_pool);
+    }
+    else if (!mesh->vertex_tangent.exists && mesh_part.index_count > 0 && mesh_part.vertex_count > 0)
+    {
+        SMikkTSpaceInterface mikkt_interface = {0};
+        mikkt_interface.m_getNumFaces          = mikkt_get_num_faces;
+        mikkt_interface.m_getNumVerticesOfFace = mikkt_get_num_vertices_of_face;
+        mikkt_interface.m_getPosition          = mikkt_get_position;
+        mikkt_interface.m_getNormal            = mikkt_get_normal;
+        mikkt_interface.m_getTexCoord          = mikkt_get_tex_coord;
+        mikkt_interface.m_setTSpaceBasic       = mikkt_set_t_space_basic;
+        // mikkt_interface.m_setTSpace         = NULL;  // use setTSpaceBasic instead
+        
+        SMikkTSpaceContext ctx = {0};
+        ctx.m_pInterface = &mikkt_interface;
+        ctx.m_pUserData  = &mesh_part;
+        if (!genTangSpaceDefault(&ctx)) {
+            fprintf(stderr, "MikkTSpace failed!\n");
+            __debugbreak();
+        }
+    }
+
+    mesh_part.color_texture = texture_index_find_fbx(texture_index, mesh->materials.data[material_index]->pbr.base_color.texture);
+    mesh_part.normal_texture = texture_index_find_fbx(texture_index, mesh->materials.data[material_index]->pbr.normal_map.texture);
+
+    // After the tangents, since the order triangles are visited in decides which tangent a shared vertex keeps.
+    if (MeshProcessOptions.optimize_vertex_cache)
+    {
+        optimize_vertex_cache(indices, num_indices, num_vertices);
+        if (MeshProcessOptions.optimize_overdraw)
+            optimize_overdraw(indices, num_indices, welded_vertices, num_vertices);
+    }
+    if (MeshProcessOptions.optimize_vertex_fetch)
+        optimize_vertex_fetch(indices, num_indices, welded_vertices, num_vertices);
+
+    // After the vertex fetch order is settled, the LODs index the same vertex array as the full mesh.
+    mesh_part.lod_array[0] = (struct Mesh_Lod){ .index_offset = 0, .index_count = num_indices, .error = 0.0f };
+    mesh_part.lod_count = 1;
+    if (MeshProcessOptions.build_lods)
+    {
+        unsigned int* chain = build_lod_chain(indices, num_indices, welded_vertices, num_vertices, mesh_part.lod_array, &mesh_part.lod_count);
+        free(indices);
+        indices = chain;
+        for (unsigned int i = 1; i < mesh_part.lod_count && MeshProcessOptions.optimize_vertex_cache; i++)
+            optimize_vertex_cache(indices + mesh_part.lod_array[i].index_offset, mesh_part.lod_array[i].index_count, num_vertices);
+    }
+
+    mesh_part_store_indices(&mesh_part, indices, arena);
+    free(indices);
+
+    if (MeshProcessOptions.build_meshlets)
+        build_meshlets(&mesh_part, arena);
+
+    mesh_part_compute_bounds(&mesh_part);
+    return mesh_part;
+}
+// A mesh part whose processing was deferred so it can run on the thread pool.
+// The result is written to `out`, which already sits at its final place in the node.
+struct Mesh_Part_Load
+{
+    ufbx_mesh* mesh;
+    size_t material_index;
+    struct Mesh_Part* out;
+};
+struct Mesh_Part_Load_List
+{
+    struct Mesh_Part_Load* loads;
+    size_t count;
+    size_t capacity;
+};
+void mesh_part_load_list_push(struct Mesh_Part_Load_List* list, struct Mesh_Part_Load load)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->loads = realloc(list->loads, list->capacity * sizeof(struct Mesh_Part_Load));
+    }
+    list->loads[list->count++] = load;
+}
+struct Node* load_node(ufbx_node* fbx_node, struct Texture_Index* texture_index, ufbx_scene* fbx_scene, struct Arena* arena, struct Mesh_Part_Load_List* deferred_loads)
+{
+    printf("Object: %s\n", fbx_node->name.data);
+
+    struct Node* node = node_create(arena);
+    node->name = arena_strdup(arena, fbx_node->name.data);
+    
+    conv_float(fbx_node->local_transform.translation, node->local_position);
+    conv_float(fbx_node->local_transform.rotation, node->local_rotation);
+    conv_float(fbx_node->local_transform.scale, node->local_scale);
+
+    conv_float(fbx_node->geometry_transform.translation, node->geometry_position);
+    conv_float(fbx_node->geometry_transform.rotation, node->geometry_rotation);
+    conv_float(fbx_node->geometry_transform.scale, node->geometry_scale);
+
+    if (fbx_node->mesh)
+    {
+        ufbx_mesh* mesh = fbx_node->mesh;
+        printf("-> mesh with %zu faces\n", mesh->faces.count);
+        node->type = NODE_TYPE_MESH;
+        node->mesh.mesh_parts_count = mesh->material_parts.count;
+        node->mesh.mesh_parts = arena_alloc(arena, mesh->material_parts.count * sizeof(struct Mesh_Part));
+
+        for (size_t i = 0; i < mesh->material_parts.count; i++)
+        {
+            if (deferred_loads)
+                mesh_part_load_list_push(deferred_loads, (struct Mesh_Part_Load){ mesh, i, &node->mesh.mesh_parts[i] });
+            else
+                node->mesh.mesh_parts[i] = load_mesh_part(mesh, &mesh->material_parts.data[i], i, texture_index, arena, 0);
+        }
+    }
+    else if (fbx_node->light && fbx_node->light->type == UFBX_LIGHT_POINT) {}
+    else if (fbx_node->light && fbx_node->light->type == UFBX_LIGHT_SPOT) {}
+    else if (fbx_node->light && fbx_node->light->type == UFBX_LIGHT_DIRECTIONAL) {}
+    else if (fbx_node->camera) 
+    {
+        node->type = NODE_TYPE_CAMERA;
+    }
+    else 
+    {
+        node->type = NODE_TYPE_EMPTY;
+
+        if (fbx_node->is_root)
+        {
+            node->texture_count = fbx_scene->textures.count;
+            node->texture_array = arena_alloc(arena, node->texture_count * sizeof(struct Texture));
+
+            for (size_t i = 0; i < node->texture_count; i++)
+            {
+                ufbx_texture* fbx_texture = fbx_scene->textures.data[i];
+                struct Texture* texture = &node->texture_array[i];
+
+                texture->path = arena_get_asset_path(arena, fbx_texture->relative_filename.data);
+            }
+            texture_index_build(texture_index, node->texture_array, node->texture_count);
+        }
+    }
+
+    node->child_array = arena_alloc(arena, fbx_node->children.count * sizeof(struct Node*));
+    node->child_count = fbx_node->children.count;
+    for (size_t i = 0; i < fbx_node->children.count; i++) 
+    {
+        node->child_array[i] = load_node(fbx_node->children.data[i], texture_index, fbx_scene, arena, deferred_loads);
+        node->child_array[i]->parent = node;
+        node->child_array[i]->texture_array = node->texture_array;
+        node->child_array[i]->texture_count = node->texture_count;
+    }
+
+    return node;
+}
+
+struct Mesh_Part_Load_Context
+{
+    struct Mesh_Part_Load_List* list;
+    size_t* order;
+    struct Texture_Index* texture_index;
+    struct Arena* arena;
+    struct Thread_Pool* thread_pool;
+};
+void mesh_part_load_task(void* user, size_t index)
+{
+    struct Mesh_Part_Load_Context* context = (struct Mesh_Part_Load_Context*)user;
+    struct Mesh_Part_Load* load = &context->list->loads[context->order[index]];
+    *load->out = load_mesh_part(load->mesh, &load->mesh->material_parts.data[load->material_index], load->material_index, context->texture_index, context->arena, context->thread_pool);
+}
+static struct Mesh_Part_Load* mesh_part_load_sort_base;
+size_t mesh_part_load_triangle_count(size_t index)
+{
+    struct Mesh_Part_Load* load = &mesh_part_load_sort_base[index];
+    return load->mesh->material_parts.data[load->material_index].num_triangles;
+}
+int mesh_part_load_compare_size(const void* a, const void* b)
+{
+    size_t triangles_a = mesh_part_load_triangle_count(*(const size_t*)a);
+    size_t triangles_b = mesh_part_load_triangle_count(*(const size_t*)b);
+    return (triangles_a < triangles_b) - (triangles_a > triangles_b);
+}
+// Every part writes into its own preassigned slot, so the result does not depend on scheduling.
+// Parts are handed out largest first only so the big ones don't end up last on a single thread.
+void load_mesh_parts_parallel(struct Mesh_Part_Load_List* list, struct Texture_Index* texture_index, struct Arena* arena, struct Thread_Pool* thread_pool)
+{
+    size_t* order = calloc(list->count, sizeof(size_t));
+    for (size_t i = 0; i < list->count; i++)
+        order[i] = i;
+    mesh_part_load_sort_base = list->loads;
+    qsort(order, list->count, sizeof(size_t), mesh_part_load_compare_size);
+
+    struct Mesh_Part_Load_Context context = { list, order, texture_index, arena, thread_pool };
+    thread_pool_for(thread_pool, mesh_part_load_task, &context, list->count);
+    free(order);
+}
+// Builds the node tree for an already parsed scene. With a thread pool the mesh parts are
+// processed in parallel after the tree is built, otherwise one at a time while walking it.
+struct Node* load_scene(ufbx_scene* fbx_scene, struct Arena* arena, struct Thread_Pool* thread_pool)
+{
+    struct Texture_Index texture_index = {0};
+    if (!thread_pool)
+    {
+        struct Node* scene = load_node(fbx_scene->root_node, &texture_index, fbx_scene, arena, 0);
+        texture_index_destroy(&texture_index);
+        return scene;
+    }
+
+    struct Mesh_Part_Load_List deferred_loads = {0};
+    struct Node* scene = load_node(fbx_scene->root_node, &texture_index, fbx_scene, arena, &deferred_loads);
+    load_mesh_parts_parallel(&deferred_loads, &texture_index, arena, thread_pool);
+    free(deferred_loads.loads);
+    texture_index_destroy(&texture_index);
+    return scene;
+}
+// ufbx hands us its own task indices, each group maps to one job on our pool.
+struct Ufbx_Thread_Pool
+{
+    struct Thread_Pool* pool;
+    struct Thread_Pool_Job groups[UFBX_THREAD_GROUP_COUNT];
+};
+void ufbx_thread_pool_task(void* user, size_t index)
+{
+    ufbx_thread_pool_run_task((ufbx_thread_pool_context)user, (uint32_t)index);
+}
+void ufbx_thread_pool_run(void* user, ufbx_thread_pool_context ctx, uint32_t group, uint32_t start_index, uint32_t count)
+{
+    struct Ufbx_Thread_Pool* ufbx_pool = (struct Ufbx_Thread_Pool*)user;
+    struct Thread_Pool_Job* job = &ufbx_pool->groups[group];
+    job->fn = ufbx_thread_pool_task;
+    job->user = (void*)ctx;
+    job->start = start_index;
+    job->count = count;
+    thread_pool_submit(ufbx_pool->pool, job);
+}
+void ufbx_thread_pool_wait(void* user, ufbx_thread_pool_context ctx, uint32_t group, uint32_t max_index)
+{
+    (void)ctx; (void)max_index;
+    struct Ufbx_Thread_Pool* ufbx_pool = (struct Ufbx_Thread_Pool*)user;
+    thread_pool_wait(ufbx_pool->pool, &ufbx_pool->groups[group]);
+}
+ufbx_load_opts fbx_load_opts(struct Ufbx_Thread_Pool* ufbx_pool)
+{
+    // Zeroed padding included, scene_cache_key hashes the raw bytes.
+    ufbx_load_opts opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.target_axes.right = UFBX_COORDINATE_AXIS_POSITIVE_X;
+    opts.target_axes.up = UFBX_COORDINATE_AXIS_POSITIVE_Y;
+    opts.target_axes.front = UFBX_COORDINATE_AXIS_NEGATIVE_Z; // Could be UFBX_COORDINATE_AXIS_POSITIVE_Z
+    opts.target_unit_meters = 1.0f;
+    opts.generate_missing_normals = TRUE;
+    opts.handedness_conversion_axis = UFBX_MIRROR_AXIS_X; // Might need to be omited.
+    opts.handedness_conversion_retain_winding = TRUE;
+    opts.reverse_winding = TRUE;
+    opts.space_conversion = UFBX_SPACE_CONVERSION_MODIFY_GEOMETRY;
+    opts.retain_vertex_attrib_w = TRUE;
+    if (ufbx_pool && thread_pool_get_thread_count(ufbx_pool->pool) > 1)
+    {
+        opts.thread_opts.pool.run_fn = ufbx_thread_pool_run;
+        opts.thread_opts.pool.wait_fn = ufbx_thread_pool_wait;
+        opts.thread_opts.pool.user = ufbx_pool;
+    }
+    return opts;
+}
+// Files ufbx asks for besides the main one (.mtl libraries, geometry caches) are mapped too
+// and handed over as uncopied memory streams, the mapping is released when ufbx closes them.
+void ufbx_close_mapped_file(void* user, void* data, size_t data_size)
+{
+    (void)data; (void)data_size;
+    struct Mapped_File* file = (struct Mapped_File*)user;
+    unmap_file(file);
+    free(file);
+}
+bool ufbx_open_mapped_file(void* user, ufbx_stream* stream, const char* path, size_t path_len, const ufbx_open_file_info* info)
+{
+    (void)user;
+    char* terminated_path = calloc(path_len + 1, sizeof(char));
+    memcpy(terminated_path, path, path_len);
+
+    struct Mapped_File* file = calloc(1, sizeof(struct Mapped_File));
+    int mapped = map_file(terminated_path, 0, file);
+    free(terminated_path);
+    if (!mapped)
+    {
+        free(file);
+        return false;
+    }
+
+    ufbx_open_memory_opts memory_opts = {
+        .no_copy = true,
+        .close_cb = { .fn = ufbx_close_mapped_file, .user = file },
+    };
+    if (!ufbx_open_memory_ctx(stream, info->context, file->data, file->size, &memory_opts, 0))
+    {
+        ufbx_close_mapped_file(file, 0, 0);
+        return false;
+    }
+    return true;
+}
+// Parses straight out of the mapped source instead of going through stdio and ufbx's read buffer.
+ufbx_scene* load_fbx_mapped(char* path, struct Mapped_File* source_file, ufbx_load_opts opts, ufbx_error* error)
+{
+    opts.filename.data = path;
+    opts.filename.length = SIZE_MAX;
+    opts.open_file_cb.fn = ufbx_open_mapped_file;
+    return ufbx_load_memory(source_file->data, source_file->size, &opts, error);
+}
+
+// Baked scene cache.
+// The finished node tree is written out as one blob where every pointer is stored as an offset
+// from the start of the file (0 stays NULL). Loading maps the file copy-on-write and turns the
+// offsets back into pointers in place. Everything that holds pointers is kept at the front of the
+// file so the fixups only dirty those pages, the vertex and index data behind them stay shared.
+#define SCENE_CACHE_MAGIC 0x454E4353 // "SCNE"
+#define SCENE_CACHE_VERSION 8 // Bump whenever load_mesh_part bakes anything differently.
+static int UseSceneCache = 1;
+struct Scene_Cache_Header
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int node_size;
+    unsigned int mesh_part_size;
+    unsigned int vertex_size;
+    unsigned int texture_size;
+    unsigned long long source_hash;
+    unsigned long long opts_hash;
+    unsigned long long file_size;
+    unsigned long long root_offset;
+    unsigned long long texture_array_offset;
+    unsigned long long texture_count;
+};
+struct Scene_Cache_Key
+{
+    unsigned long long source_hash;
+    unsigned long long opts_hash;
+};
+struct Scene_Cache_Key scene_cache_key(const void* source_data, size_t source_size, const ufbx_load_opts* opts)
+{
+    // The thread pool only changes how fast the scene loads, not what comes out.
+    ufbx_load_opts key_opts;
+    memcpy(&key_opts, opts, sizeof(ufbx_load_opts));
+    memset(&key_opts.thread_opts, 0, sizeof(key_opts.thread_opts));
+
+    struct Scene_Cache_Key key = {
+        .source_hash = hash64(source_data, source_size, 0),
+        .opts_hash = hash64(&MeshProcessOptions, sizeof(MeshProcessOptions), hash64(&key_opts, sizeof(key_opts), SCENE_CACHE_VERSION)),
+    };
+    return key;
+}
+
+// Runs twice: once without a buffer to measure the pointer and data sections, then for real.
+struct Scene_Cache_Writer
+{
+    char* buffer;
+    size_t meta_cursor;
+    size_t data_start;
+    size_t data_cursor;
+
+    struct Texture* texture_array;
+    size_t texture_array_offset;
+};
+size_t scene_cache_alloc_meta(struct Scene_Cache_Writer* writer, size_t size)
+{
+    size_t offset = (writer->meta_cursor + 15) & ~(size_t)15;
+    writer->meta_cursor = offset + size;
+    return offset;
+}
+size_t scene_cache_push_data(struct Scene_Cache_Writer* writer, const void* data, size_t size)
+{
+    if (!data || size == 0)
+        return 0;
+
+    size_t offset = writer->data_start + ((writer->data_cursor + 15) & ~(size_t)15);
+    writer->data_cursor = offset - writer->data_start + size;
+    if (writer->buffer)
+        memcpy(writer->buffer + offset, data, size);
+    return offset;
+}
+size_t scene_cache_push_string(struct Scene_Cache_Writer* writer, const char* string)
+{
+    return string ? scene_cache_push_data(writer, string, strlen(string) + 1) : 0;
+}
+#define SCENE_CACHE_OFFSET(type, offset) ((type)(uintptr_t)(offset))
+size_t scene_cache_write_node(struct Scene_Cache_Writer* writer, struct Node* node, size_t parent_offset)
+{
+    size_t node_offset = scene_cache_alloc_meta(writer, sizeof(struct Node));
+    struct Node baked = *node;
+
+    baked.name = SCENE_CACHE_OFFSET(char*, scene_cache_push_string(writer, node->name));
+    baked.parent = SCENE_CACHE_OFFSET(struct Node*, parent_offset);
+
+    if (node->texture_array && node->texture_array != writer->texture_array)
+    {
+        // Every node shares the root's texture array, it only has to be written once.
+        writer->texture_array = node->texture_array;
+        writer->texture_array_offset = scene_cache_alloc_meta(writer, sizeof(struct Texture) * node->texture_count);
+        for (size_t i = 0; i < node->texture_count; i++)
+        {
+            struct Texture texture = { .path = SCENE_CACHE_OFFSET(char*, scene_cache_push_string(writer, node->texture_array[i].path)) };
+            if (writer->buffer)
+                memcpy(writer->buffer + writer->texture_array_offset + sizeof(struct Texture) * i, &texture, sizeof(struct Texture));
+        }
+    }
+    baked.texture_array = node->texture_array ? SCENE_CACHE_OFFSET(struct Texture*, writer->texture_array_offset) : 0;
+
+    if (node->type == NODE_TYPE_MESH)
+    {
+        size_t mesh_parts_offset = scene_cache_alloc_meta(writer, sizeof(struct Mesh_Part) * node->mesh.mesh_parts_count);
+        for (size_t i = 0; i < node->mesh.mesh_parts_count; i++)
+        {
+            struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[i];
+            struct Mesh_Part baked_part = {
+                .vertex_array = SCENE_CACHE_OFFSET(struct Vertex*, scene_cache_push_data(writer, mesh_part->vertex_array, sizeof(struct Vertex) * mesh_part->vertex_count)),
+                .vertex_count = mesh_part->vertex_count,
+                .position_min = mesh_part->position_min,
+                .position_extent = mesh_part->position_extent,
+                .bounding_radius = mesh_part->bounding_radius,
+                .index_array = SCENE_CACHE_OFFSET(unsigned int*, scene_cache_push_data(writer, mesh_part->index_array, mesh_part_index_size(mesh_part) * mesh_part_total_index_count(mesh_part))),
+                .index_count = mesh_part->index_count,
+                .index_16_bit = mesh_part->index_16_bit,
+                .lod_count = mesh_part->lod_count,
+                .meshlet_array = SCENE_CACHE_OFFSET(struct Meshlet*, scene_cache_push_data(writer, mesh_part->meshlet_array, sizeof(struct Meshlet) * mesh_part->meshlet_count)),
+                .meshlet_count = mesh_part->meshlet_count,
+                .meshlet_vertex_array = SCENE_CACHE_OFFSET(unsigned int*, scene_cache_push_data(writer, mesh_part->meshlet_vertex_array, sizeof(unsigned int) * mesh_part->meshlet_vertex_count)),
+                .meshlet_vertex_count = mesh_part->meshlet_vertex_count,
+                .meshlet_triangle_array = SCENE_CACHE_OFFSET(unsigned char*, scene_cache_push_data(writer, mesh_part->meshlet_triangle_array, 3 * mesh_part->meshlet_triangle_count)),
+                .meshlet_triangle_count = mesh_part->meshlet_triangle_count,
+            };
+            memcpy(baked_part.lod_array, mesh_part->lod_array, sizeof(mesh_part->lod_array));
+            if (mesh_part->color_texture)
+                baked_part.color_texture = SCENE_CACHE_OFFSET(struct Texture*, writer->texture_array_offset + sizeof(struct Texture) * (mesh_part->color_texture - writer->texture_array));
+            if (mesh_part->normal_texture)
+                baked_part.normal_texture = SCENE_CACHE_OFFSET(struct Texture*, writer->texture_array_offset + sizeof(struct Texture) * (mesh_part->normal_texture - writer->texture_array));
+            if (writer->buffer)
+                memcpy(writer->buffer + mesh_parts_offset + sizeof(struct Mesh_Part) * i, &baked_part, sizeof(struct Mesh_Part));
+        }
+        baked.mesh.mesh_parts = SCENE_CACHE_OFFSET(struct Mesh_Part*, mesh_parts_offset);
+    }
+
+    size_t child_array_offset = scene_cache_alloc_meta(writer, sizeof(struct Node*) * node->child_count);
+    baked.child_array = node->child_count ? SCENE_CACHE_OFFSET(struct Node**, child_array_offset) : 0;
+    for (size_t i = 0; i < node->child_count; i++)
+    {
+        struct Node* child_offset = SCENE_CACHE_OFFSET(struct Node*, scene_cache_write_node(writer, node->child_array[i], node_offset));
+        if (writer->buffer)
+            memcpy(writer->buffer + child_array_offset + sizeof(struct Node*) * i, &child_offset, sizeof(struct Node*));
+    }
+
+    if (writer->buffer)
+        memcpy(writer->buffer + node_offset, &baked, sizeof(struct Node));
+    return node_offset;
+}
+void scene_cache_save(const char* cache_path, struct Scene_Cache_Key key, struct Node* scene)
+{
+    struct Scene_Cache_Writer writer = { .meta_cursor = sizeof(struct Scene_Cache_Header) };
+    scene_cache_write_node(&writer, scene, 0);
+
+    size_t data_start = (writer.meta_cursor + 4095) & ~(size_t)4095;
+    size_t file_size = data_start + writer.data_cursor;
+    writer = (struct Scene_Cache_Writer){
+        .buffer = calloc(file_size, 1),
+        .meta_cursor = sizeof(struct Scene_Cache_Header),
+        .data_start = data_start,
+    };
+    size_t root_offset = scene_cache_write_node(&writer, scene, 0);
+
+    struct Scene_Cache_Header header = {
+        .magic = SCENE_CACHE_MAGIC,
+        .version = SCENE_CACHE_VERSION,
+        .node_size = sizeof(struct Node),
+        .mesh_part_size = sizeof(struct Mesh_Part),
+        .vertex_size = sizeof(struct Vertex),
+        .texture_size = sizeof(struct Texture),
+        .source_hash = key.source_hash,
+        .opts_hash = key.opts_hash,
+        .file_size = file_size,
+        .root_offset = root_offset,
+        .texture_array_offset = writer.texture_array_offset,
+        .texture_count = scene->texture_count,
+    };
+    memcpy(writer.buffer, &header, sizeof(header));
+
+    if (!write_file(cache_path, writer.buffer, file_size))
+        fprintf(stderr, "Failed to write scene cache: %s\n", cache_path);
+    free(writer.buffer);
+}
+
+// The file may be truncated or corrupted, so every offset is checked against the mapping before it
+// becomes a pointer. Any failure makes the whole load a cache miss, the fixups already done only
+// touched the private copy-on-write pages and go away with the unmap.
+struct Scene_Cache_Reader
+{
+    char* base;
+    size_t size;
+    struct Scene_Cache_Header* header;
+    size_t last_node_offset;
+};
+// An offset of 0 is NULL and only allowed for empty arrays, anything else has to keep count elements inside the file.
+// The writer puts every array on a 16 byte boundary, see scene_cache_alloc_meta and scene_cache_push_data.
+int scene_cache_range_valid(struct Scene_Cache_Reader* reader, const void* pointer, size_t count, size_t element_size)
+{
+    uintptr_t offset = (uintptr_t)pointer;
+    if (!offset)
+        return count == 0;
+    return offset % 16 == 0 && offset >= sizeof(struct Scene_Cache_Header) && offset <= reader->size &&
+           count <= (reader->size - offset) / element_size;
+}
+int scene_cache_string_valid(struct Scene_Cache_Reader* reader, const char* pointer)
+{
+    uintptr_t offset = (uintptr_t)pointer;
+    if (!offset)
+        return 1;
+    return offset >= sizeof(struct Scene_Cache_Header) && offset < reader->size &&
+           memchr(reader->base + offset, 0, reader->size - offset) != 0;
+}
+// Mesh part textures point into the one shared texture array.
+int scene_cache_texture_valid(struct Scene_Cache_Reader* reader, const struct Texture* pointer)
+{
+    uintptr_t offset = (uintptr_t)pointer;
+    if (!offset)
+        return 1;
+    uintptr_t array_offset = (uintptr_t)reader->header->texture_array_offset;
+    return array_offset && offset >= array_offset &&
+           (offset - array_offset) % sizeof(struct Texture) == 0 &&
+           (offset - array_offset) / sizeof(struct Texture) < reader->header->texture_count;
+}
+int scene_cache_mesh_part_valid(struct Scene_Cache_Reader* reader, struct Mesh_Part* mesh_part)
+{
+    if (mesh_part->lod_count > MESH_LOD_MAX)
+        return 0;
+    size_t total_index_count = mesh_part_total_index_count(mesh_part);
+    if (mesh_part->index_count > total_index_count)
+        return 0;
+    for (unsigned int i = 0; i < mesh_part->lod_count; i++)
+    {
+        struct Mesh_Lod* lod = &mesh_part->lod_array[i];
+        if (lod->index_offset > total_index_count || lod->index_count > total_index_count - lod->index_offset)
+            return 0;
+    }
+    return scene_cache_range_valid(reader, mesh_part->vertex_array, mesh_part->vertex_count, sizeof(struct Vertex)) &&
+           scene_cache_range_valid(reader, mesh_part->index_array, total_index_count, mesh_part_index_size(mesh_part)) &&
+           scene_cache_range_valid(reader, mesh_part->meshlet_array, mesh_part->meshlet_count, sizeof(struct Meshlet)) &&
+           scene_cache_range_valid(reader, mesh_part->meshlet_vertex_array, mesh_part->meshlet_vertex_count, sizeof(unsigned int)) &&
+           scene_cache_range_valid(reader, mesh_part->meshlet_triangle_array, mesh_part->meshlet_triangle_count, 3) &&
+           scene_cache_texture_valid(reader, mesh_part->color_texture) &&
+           scene_cache_texture_valid(reader, mesh_part->normal_texture);
+}
+
+#define SCENE_CACHE_FIXUP(base, pointer) if (pointer) { (pointer) = (void*)((char*)(base) + (uintptr_t)(pointer)); }
+// Nodes were written depth first, each after its parent and every earlier sibling's subtree, so
+// requiring offsets to keep increasing rules out cycles and nodes shared between two parents.
+int scene_cache_fixup_node(struct Scene_Cache_Reader* reader, size_t node_offset, size_t parent_offset)
+{
+    if (node_offset <= reader->last_node_offset || !scene_cache_range_valid(reader, (void*)(uintptr_t)node_offset, 1, sizeof(struct Node)))
+        return 0;
+    reader->last_node_offset = node_offset;
+
+    char* base = reader->base;
+    struct Node* node = (struct Node*)(base + node_offset);
+    if ((uintptr_t)node->parent != parent_offset || !scene_cache_string_valid(reader, node->name))
+        return 0;
+    if (node->texture_array ? ((uintptr_t)node->texture_array != reader->header->texture_array_offset || node->texture_count != reader->header->texture_count) : node->texture_count != 0)
+        return 0;
+    SCENE_CACHE_FIXUP(base, node->name);
+    SCENE_CACHE_FIXUP(base, node->parent);
+    SCENE_CACHE_FIXUP(base, node->texture_array);
+
+    if (node->type == NODE_TYPE_MESH)
+    {
+        if (!node->mesh.mesh_parts || !scene_cache_range_valid(reader, node->mesh.mesh_parts, node->mesh.mesh_parts_count, sizeof(struct Mesh_Part)))
+            return 0;
+        SCENE_CACHE_FIXUP(base, node->mesh.mesh_parts);
+        for (size_t i = 0; i < node->mesh.mesh_parts_count; i++)
+        {
+            struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[i];
+            if (!scene_cache_mesh_part_valid(reader, mesh_part))
+                return 0;
+            SCENE_CACHE_FIXUP(base, mesh_part->vertex_array);
+            SCENE_CACHE_FIXUP(base, mesh_part->index_array);
+            SCENE_CACHE_FIXUP(base, mesh_part->meshlet_array);
+            SCENE_CACHE_FIXUP(base, mesh_part->meshlet_vertex_array);
+            SCENE_CACHE_FIXUP(base, mesh_part->meshlet_triangle_array);
+            SCENE_CACHE_FIXUP(base, mesh_part->color_texture);
+            SCENE_CACHE_FIXUP(base, mesh_part->normal_texture);
+        }
+    }
+
+    if (!scene_cache_range_valid(reader, node->child_array, node->child_count, sizeof(struct Node*)))
+        return 0;
+    SCENE_CACHE_FIXUP(base, node->child_array);
+    for (size_t i = 0; i < node->child_count; i++)
+    {
+        size_t child_offset = (size_t)(uintptr_t)node->child_array[i];
+        if (!scene_cache_fixup_node(reader, child_offset, node_offset))
+            return 0;
+        node->child_array[i] = (struct Node*)(base + child_offset);
+    }
+    return 1;
+}
+// Returns NULL if there is no cache or it was made from a different file, options or layout.
+struct Scene* scene_cache_load(const char* cache_path, struct Scene_Cache_Key key)
+{
+    struct Mapped_File cache_file;
+    if (!map_file(cache_path, 1, &cache_file))
+        return 0;
+
+    struct Scene_Cache_Header* header = (struct Scene_Cache_Header*)cache_file.data;
+    if (cache_file.size < sizeof(struct Scene_Cache_Header) ||
+        header->magic != SCENE_CACHE_MAGIC ||
+        header->version != SCENE_CACHE_VERSION ||
+        header->node_size != sizeof(struct Node) ||
+        header->mesh_part_size != sizeof(struct Mesh_Part) ||
+        header->vertex_size != sizeof(struct Vertex) ||
+        header->texture_size != sizeof(struct Texture) ||
+        header->file_size != cache_file.size ||
+        header->source_hash != key.source_hash ||
+        header->opts_hash != key.opts_hash)
+    {
+        unmap_file(&cache_file);
+        return 0;
+    }
+
+    struct Scene_Cache_Reader reader = { .base = (char*)cache_file.data, .size = cache_file.size, .header = header };
+    int valid = header->root_offset != 0 &&
+                scene_cache_range_valid(&reader, (void*)(uintptr_t)header->texture_array_offset, (size_t)header->texture_count, sizeof(struct Texture));
+    struct Texture* texture_array = (struct Texture*)(reader.base + header->texture_array_offset);
+    for (size_t i = 0; valid && header->texture_array_offset && i < header->texture_count; i++)
+    {
+        valid = scene_cache_string_valid(&reader, texture_array[i].path);
+        if (valid)
+            SCENE_CACHE_FIXUP(reader.base, texture_array[i].path);
+    }
+    if (!valid || !scene_cache_fixup_node(&reader, (size_t)header->root_offset, 0))
+    {
+        fprintf(stderr, "Corrupted scene cache: %s\n", cache_path);
+        unmap_file(&cache_file);
+        return 0;
+    }
+
+    struct Scene* scene = calloc(1, sizeof(struct Scene));
+    scene->root = (struct Node*)(reader.base + header->root_offset);
+    scene->cache_file = cache_file;
+    scene->arena = arena_create(1 << 20); // Only for data built at runtime, like the flattened transforms.
+    return scene;
+}
+
+struct Scene* load_fbx(char* path, struct Thread_Pool* thread_pool)
+{
+    struct Ufbx_Thread_Pool ufbx_pool = { .pool = thread_pool };
+    ufbx_load_opts opts = fbx_load_opts(thread_pool ? &ufbx_pool : 0);
+
+    struct Mapped_File source_file;
+    if (!map_file(path, 0, &source_file))
+    {
+        fprintf(stderr, "Failed to open: %s\n", path);
+        exit(1);
+    }
+    struct Scene_Cache_Key cache_key = scene_cache_key(source_file.data, source_file.size, &opts);
+
+    size_t cache_path_length = strlen(path) + strlen(".scenecache");
+    char* cache_path = calloc(cache_path_length + 1, sizeof(char));
+    strcat(cache_path, path);
+    strcat(cache_path, ".scenecache");
+
+    struct Scene* scene = UseSceneCache ? scene_cache_load(cache_path, cache_key) : 0;
+    if (scene)
+    {
+        printf("Scene: %s (cached)\n", path);
+        unmap_file(&source_file);
+        free(cache_path);
+        scene_flatten(scene);
+        scene_flatten_bounds(scene);
+        scene_update_world_transforms(scene);
+        return scene;
+    }
+
+    ufbx_error error;
+    ufbx_scene *fbx_scene = load_fbx_mapped(path, &source_file, opts, &error);
+    unmap_file(&source_file);
+    if (!fbx_scene)
+    {
+        fprintf(stderr, "Failed to load: %s\n", error.description.data);
+        exit(1);
+    }
+
+    printf("Scene: %s\n", path);
+
+    scene = calloc(1, sizeof(struct Scene));
+    scene->arena = arena_create(0);
+    scene->root = load_scene(fbx_scene, scene->arena, thread_pool);
+
+    ufbx_free_scene(fbx_scene);
+
+    if (UseSceneCache)
+        scene_cache_save(cache_path, cache_key, scene->root);
+    free(cache_path);
+    scene_flatten(scene);
+    scene_flatten_bounds(scene);
+    scene_update_world_transforms(scene);
+    return scene;
+}
+
+// Merges mesh parts that share their material textures into pre-transformed batches, so they go out in
+// one draw instead of one each. The merged parts are taken out of their nodes and the batches hang off
+// one new child of the root, in the root's space, so moving the root still moves everything. Other nodes
+// are treated as static: moving them afterwards does not move what was batched out of them.
+// A batch stays within StaticBatchMaxVertices so its indices stay 16 bit, and parts are taken in spatial
+// order so each batch covers one region of the scene rather than bits from everywhere.
+static size_t StaticBatchMaxVertices = 65536;
+struct Static_Batch_Item
+{
+    struct Node* node;
+    struct Mesh_Part* mesh_part;
+    unsigned int morton;
+    int batched;
+};
+unsigned int morton_spread_10(unsigned int x)
+{
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+int static_batch_item_compare(const void* a, const void* b)
+{
+    const struct Static_Batch_Item* item_a = *(const struct Static_Batch_Item* const*)a;
+    const struct Static_Batch_Item* item_b = *(const struct Static_Batch_Item* const*)b;
+    if (item_a->mesh_part->color_texture != item_b->mesh_part->color_texture)
+        return item_a->mesh_part->color_texture < item_b->mesh_part->color_texture ? -1 : 1;
+    if (item_a->mesh_part->normal_texture != item_b->mesh_part->normal_texture)
+        return item_a->mesh_part->normal_texture < item_b->mesh_part->normal_texture ? -1 : 1;
+    return (item_a->morton > item_b->morton) - (item_a->morton < item_b->morton);
+}
+int static_batch_compatible(struct Static_Batch_Item* a, struct Static_Batch_Item* b)
+{
+    return a->mesh_part->color_texture == b->mesh_part->color_texture && a->mesh_part->normal_texture == b->mesh_part->normal_texture;
+}
+void static_batch_collect(struct Node* node, struct Static_Batch_Item* items, size_t* count)
+{
+    if (node->type == NODE_TYPE_MESH)
+    {
+        for (size_t i = 0; i < node->mesh.mesh_parts_count; i++)
+            items[(*count)++] = (struct Static_Batch_Item){ .node = node, .mesh_part = &node->mesh.mesh_parts[i] };
+    }
+    for (size_t i = 0; i < node->child_count; i++)
+        static_batch_collect(node->child_array[i], items, count);
+}
+size_t static_batch_count_parts(struct Node* node)
+{
+    size_t count = node->type == NODE_TYPE_MESH ? node->mesh.mesh_parts_count : 0;
+    for (size_t i = 0; i < node->child_count; i++)
+        count += static_batch_count_parts(node->child_array[i]);
+    return count;
+}
+// Bakes item's part into the batch at the given vertex and index offsets, in the space of root_inverse.
+void static_batch_append(struct Scene* scene, Mat4 root_inverse, struct Static_Batch_Item* item, struct Vertex* vertices, unsigned int* indices, size_t base_vertex)
+{
+    struct Mesh_Part* mesh_part = item->mesh_part;
+    Mat4 transform = MulM4(root_inverse, scene->transforms.world_geometry[item->node->transform_index]);
+    Mat3 linear = { .Columns = { transform.Columns[0].XYZ, transform.Columns[1].XYZ, transform.Columns[2].XYZ } };
+    // The shader builds the bitangent from the baked normal and tangent, a mirroring transform has to
+    // flip its sign to keep it pointing where the original transform would have taken it.
+    float handedness = DeterminantM3(linear) < 0.0f ? -1.0f : 1.0f;
+    for (size_t v = 0; v < mesh_part->vertex_count; v++)
+    {
+        struct Vertex vertex = mesh_part->vertex_array[v];
+        vertex.pos = MulM4V4(transform, V4V(vertex.pos, 1.0f)).XYZ;
+        vertex.normal = NormV3(MulM3V3(linear, vertex.normal));
+        Vec3 tangent = MulM3V3(linear, vertex.tangent.XYZ);
+        if (LenSqrV3(tangent) > 0.0f)
+            tangent = NormV3(tangent);
+        vertex.tangent = V4V(tangent, vertex.tangent.W * handedness);
+        vertices[base_vertex + v] = vertex;
+    }
+    for (size_t i = 0; i < mesh_part->index_count; i++)
+        indices[i] = (unsigned int)base_vertex + mesh_part_get_index(mesh_part, i);
+}
+void build_static_batches(struct Scene* scene)
+{
+    size_t part_count = static_batch_count_parts(scene->root);
+    struct Static_Batch_Item* items = malloc(part_count * sizeof(struct Static_Batch_Item));
+    struct Static_Batch_Item** order = malloc(part_count * sizeof(struct Static_Batch_Item*));
+    size_t item_count = 0;
+    static_batch_collect(scene->root, items, &item_count);
+
+    Mat4 root_inverse = InvGeneralM4(scene->transforms.world[scene->root->transform_index]);
+    Vec3 scene_min = V3(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vec3 scene_max = V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    Vec3* centers = malloc(part_count * sizeof(Vec3));
+    for (size_t i = 0; i < item_count; i++)
+    {
+        struct Mesh_Part* mesh_part = items[i].mesh_part;
+        mesh_part_compute_bounds(mesh_part);
+        Mat4 transform = MulM4(root_inverse, scene->transforms.world_geometry[items[i].node->transform_index]);
+        centers[i] = MulM4V4(transform, V4V(AddV3(mesh_part->position_min, MulV3F(mesh_part->position_extent, 0.5f)), 1.0f)).XYZ;
+        for (int k = 0; k < 3; k++)
+        {
+            scene_min.Elements[k] = min(scene_min.Elements[k], centers[i].Elements[k]);
+            scene_max.Elements[k] = max(scene_max.Elements[k], centers[i].Elements[k]);
+        }
+    }
+    for (size_t i = 0; i < item_count; i++)
+    {
+        unsigned int cell[3];
+        for (int k = 0; k < 3; k++)
+        {
+            float extent = scene_max.Elements[k] - scene_min.Elements[k];
+            cell[k] = extent > 0.0f ? (unsigned int)((centers[i].Elements[k] - scene_min.Elements[k]) / extent * 1023.0f) : 0;
+        }
+        items[i].morton = morton_spread_10(cell[0]) | (morton_spread_10(cell[1]) << 1) | (morton_spread_10(cell[2]) << 2);
+        order[i] = &items[i];
+    }
+    free(centers);
+    qsort(order, item_count, sizeof(struct Static_Batch_Item*), static_batch_item_compare);
+
+    // Count the batches first so they can go in one array, runs of a single part are left alone.
+    struct Mesh_Part* batches = 0;
+    size_t batch_count = 0;
+    size_t batched_part_count = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+            batches = arena_alloc(scene->arena, batch_count * sizeof(struct Mesh_Part));
+        batch_count = 0;
+        for (size_t first = 0; first < item_count;)
+        {
+            size_t last = first;
+            size_t vertex_count = 0;
+            size_t index_count = 0;
+            while (last < item_count && static_batch_compatible(order[first], order[last]) && order[last]->mesh_part->vertex_count > 0 &&
+                vertex_count + order[last]->mesh_part->vertex_count <= StaticBatchMaxVertices)
+            {
+                vertex_count += order[last]->mesh_part->vertex_count;
+                index_count += order[last]->mesh_part->index_count;
+                last++;
+            }
+            if (last - first < 2)
+            {
+                first = max(last, first + 1);
+                continue;
+            }
+
+            if (pass == 1)
+            {
+                struct Mesh_Part* batch = &batches[batch_count];
+                *batch = (struct Mesh_Part){
+                    .vertex_array = arena_alloc(scene->arena, vertex_count * sizeof(struct Vertex)),
+                    .vertex_count = vertex_count,
+                    .index_count = index_count,
+                    .lod_array = { { .index_offset = 0, .index_count = index_count } },
+                    .lod_count = 1,
+                    .color_texture = order[first]->mesh_part->color_texture,
+                    .normal_texture = order[first]->mesh_part->normal_texture,
+                };
+                unsigned int* indices = malloc(index_count * sizeof(unsigned int));
+                size_t base_vertex = 0;
+                size_t base_index = 0;
+                for (size_t i = first; i < last; i++)
+                {
+                    static_batch_append(scene, root_inverse, order[i], batch->vertex_array, indices + base_index, base_vertex);
+                    base_vertex += order[i]->mesh_part->vertex_count;
+                    base_index += order[i]->mesh_part->index_count;
+                    order[i]->batched = 1;
+                }
+                mesh_part_store_indices(batch, indices, scene->arena);
+                mesh_part_compute_bounds(batch);
+                free(indices);
+                batched_part_count += last - first;
+            }
+            batch_count++;
+            first = last;
+        }
+    }
+
+    // Take the batched parts out of their nodes. Items are in node order, so each node's parts are contiguous.
+    for (size_t first = 0; first < item_count;)
+    {
+        struct Node* node = items[first].node;
+        size_t kept = 0;
+        size_t i = first;
+        for (; i < item_count && items[i].node == node; i++)
+        {
+            if (!items[i].batched)
+                node->mesh.mesh_parts[kept++] = *items[i].mesh_part;
+        }
+        node->mesh.mesh_parts_count = kept;
+        first = i;
+    }
+
+    if (batch_count > 0)
+    {
+        struct Node* batch_node = node_create(scene->arena);
+        *batch_node = (struct Node){
+            .type = NODE_TYPE_MESH,
+            .mesh = { .mesh_parts = batches, .mesh_parts_count = batch_count },
+            .name = arena_strdup(scene->arena, "Static batches"),
+            .local_rotation = { 0.0f, 0.0f, 0.0f, 1.0f },
+            .local_scale = V3(1.0f, 1.0f, 1.0f),
+            .geometry_rotation = { 0.0f, 0.0f, 0.0f, 1.0f },
+            .geometry_scale = V3(1.0f, 1.0f, 1.0f),
+            .parent = scene->root,
+        };
+        struct Node** child_array = arena_alloc(scene->arena, (scene->root->child_count + 1) * sizeof(struct Node*));
+        memcpy(child_array, scene->root->child_array, scene->root->child_count * sizeof(struct Node*));
+        child_array[scene->root->child_count] = batch_node;
+        scene->root->child_array = child_array;
+        scene->root->child_count++;
+
+        scene_flatten(scene);
+        scene_flatten_bounds(scene);
+        scene_update_world_transforms(scene);
+    }
+
+    size_t draw_count = item_count - batched_part_count + batch_count;
+    printf("Static batching: %zu of %zu parts merged into %zu batches, draw calls %zu -> %zu (%.1fx fewer)\n", batched_part_count, item_count, batch_count,
+        item_count, draw_count, draw_count ? (double)item_count / (double)draw_count : 0.0);
+
+    free(order);
+    free(items);
+}
+
+// Times ufbx_load_file alone with 1, 2, 4, ... threads up to the logical core count.
+void benchmark_fbx_load(char* path)
+{
+    unsigned int core_count = get_logical_core_count();
+    printf("FBX load benchmark: %s (%u logical cores)\n", path, core_count);
+
+    double single_thread_time = 0.0;
+    for (unsigned int thread_count = 1; ; thread_count = min(thread_count * 2, core_count))
+    {
+        struct Thread_Pool* thread_pool = thread_pool_create(thread_count);
+        struct Ufbx_Thread_Pool ufbx_pool = { .pool = thread_pool };
+        ufbx_load_opts opts = fbx_load_opts(&ufbx_pool);
+
+        double best_time = 0.0;
+        for (int run = 0; run < 3; run++)
+        {
+            unsigned long long timestamp1 = GetRdtsc();
+            ufbx_error error;
+            ufbx_scene *fbx_scene = ufbx_load_file(path, &opts, &error);
+            unsigned long long timestamp2 = GetRdtsc();
+            if (!fbx_scene)
+            {
+                fprintf(stderr, "Failed to load: %s\n", error.description.data);
+                exit(1);
+            }
+            ufbx_free_scene(fbx_scene);
+
+            double time = (double)(timestamp2 - timestamp1) / GetRdtscFreq();
+            if (run == 0 || time < best_time)
+                best_time = time;
+        }
+        thread_pool_destroy(thread_pool);
+
+        if (thread_count == 1)
+            single_thread_time = best_time;
+        printf("threads: %2u  parse ms: %10.3f  speedup: %.2fx\n", thread_count, best_time * 1000.0, single_thread_time / best_time);
+
+        if (thread_count == core_count)
+            break;
+    }
+}
+
+// Compares parsing through stdio against parsing the mapped file, in wall time and peak memory.
+void benchmark_fbx_stream(char* path, struct Thread_Pool* thread_pool)
+{
+    struct Ufbx_Thread_Pool ufbx_pool = { .pool = thread_pool };
+    ufbx_load_opts opts = fbx_load_opts(&ufbx_pool);
+    const char* names[] = { "stdio", "mapped" };
+
+    for (int mode = 0; mode < 2; mode++)
+    {
+        struct Memory_Sampler* sampler = memory_sampler_start();
+        unsigned long long timestamp1 = GetRdtsc();
+
+        ufbx_error error;
+        ufbx_scene *fbx_scene = 0;
+        if (mode == 0)
+        {
+            fbx_scene = ufbx_load_file(path, &opts, &error);
+        }
+        else
+        {
+            struct Mapped_File source_file;
+            if (map_file(path, 0, &source_file))
+            {
+                fbx_scene = load_fbx_mapped(path, &source_file, opts, &error);
+                unmap_file(&source_file);
+            }
+        }
+
+        unsigned long long timestamp2 = GetRdtsc();
+        size_t peak_working_set = 0;
+        size_t peak_private_bytes = 0;
+        memory_sampler_stop(sampler, &peak_working_set, &peak_private_bytes);
+
+        if (!fbx_scene)
+        {
+            fprintf(stderr, "Failed to load: %s\n", path);
+            exit(1);
+        }
+        ufbx_free_scene(fbx_scene);
+
+        double time = (double)(timestamp2 - timestamp1) / GetRdtscFreq();
+        printf("FBX %-6s ms: %10.3f  peak working set: %8.2f MB  peak private: %8.2f MB\n", names[mode], time * 1000.0, peak_working_set / (1024.0 * 1024.0), peak_private_bytes / (1024.0 * 1024.0));
+    }
+}
+
+int node_mesh_parts_equal(struct Node* a, struct Node* b)
+{
+    if (a->type != b->type || a->child_count != b->child_count)
+        return 0;
+
+    if (a->type == NODE_TYPE_MESH)
+    {
+        if (a->mesh.mesh_parts_count != b->mesh.mesh_parts_count)
+            return 0;
+
+        for (size_t i = 0; i < a->mesh.mesh_parts_count; i++)
+        {
+            struct Mesh_Part* part_a = &a->mesh.mesh_parts[i];
+            struct Mesh_Part* part_b = &b->mesh.mesh_parts[i];
+            if (part_a->vertex_count != part_b->vertex_count || part_a->index_count != part_b->index_count || part_a->index_16_bit != part_b->index_16_bit)
+                return 0;
+            if (memcmp(part_a->vertex_array, part_b->vertex_array, part_a->vertex_count * sizeof(struct Vertex)) != 0)
+                return 0;
+            if (part_a->lod_count != part_b->lod_count || memcmp(part_a->lod_array, part_b->lod_array, sizeof(part_a->lod_array)) != 0)
+                return 0;
+            if (memcmp(part_a->index_array, part_b->index_array, mesh_part_total_index_count(part_a) * mesh_part_index_size(part_a)) != 0)
+                return 0;
+            if (part_a->meshlet_count != part_b->meshlet_count || part_a->meshlet_vertex_count != part_b->meshlet_vertex_count || part_a->meshlet_triangle_count != part_b->meshlet_triangle_count)
+                return 0;
+            if (part_a->meshlet_count && memcmp(part_a->meshlet_array, part_b->meshlet_array, part_a->meshlet_count * sizeof(struct Meshlet)) != 0)
+                return 0;
+            if (part_a->meshlet_vertex_count && memcmp(part_a->meshlet_vertex_array, part_b->meshlet_vertex_array, part_a->meshlet_vertex_count * sizeof(unsigned int)) != 0)
+                return 0;
+            if (part_a->meshlet_triangle_count && memcmp(part_a->meshlet_triangle_array, part_b->meshlet_triangle_array, part_a->meshlet_triangle_count * 3) != 0)
+                return 0;
+            if ((part_a->color_texture ? part_a->color_texture - a->texture_array : -1) != (part_b->color_texture ? part_b->color_texture - b->texture_array : -1))
+                return 0;
+            if ((part_a->normal_texture ? part_a->normal_texture - a->texture_array : -1) != (part_b->normal_texture ? part_b->normal_texture - b->texture_array : -1))
+                return 0;
+        }
+    }
+
+    for (size_t i = 0; i < a->child_count; i++)
+    {
+        if (!node_mesh_parts_equal(a->child_array[i], b->child_array[i]))
+            return 0;
+    }
+    return 1;
+}
+
+// Times building the node tree serially and on the thread pool from the same parsed scene,
+// and checks that both produce the same mesh parts byte for byte.
+void benchmark_mesh_part_load(char* path, struct Thread_Pool* thread_pool)
+{
+    struct Ufbx_Thread_Pool ufbx_pool = { .pool = thread_pool };
+    ufbx_load_opts opts = fbx_load_opts(&ufbx_pool);
+    ufbx_error error;
+    ufbx_scene *fbx_scene = ufbx_load_file(path, &opts, &error);
+    if (!fbx_scene)
+    {
+        fprintf(stderr, "Failed to load: %s\n", error.description.data);
+        exit(1);
+    }
+
+    struct Arena* serial_arena = arena_create(0);
+    struct Arena* parallel_arena = arena_create(0);
+
+    unsigned long long timestamp1 = GetRdtsc();
+    struct Node* serial_scene = load_scene(fbx_scene, serial_arena, 0);
+    unsigned long long timestamp2 = GetRdtsc();
+    struct Node* parallel_scene = load_scene(fbx_scene, parallel_arena, thread_pool);
+    unsigned long long timestamp3 = GetRdtsc();
+
+    double serial_time = (double)(timestamp2 - timestamp1) / GetRdtscFreq();
+    double parallel_time = (double)(timestamp3 - timestamp2) / GetRdtscFreq();
+    printf("Mesh part load: serial ms: %.3f  parallel ms (%u threads): %.3f  speedup: %.2fx\n", serial_time * 1000.0, thread_pool_get_thread_count(thread_pool), parallel_time * 1000.0, serial_time / parallel_time);
+    printf("Mesh part load: outputs %s\n", node_mesh_parts_equal(serial_scene, parallel_scene) ? "match" : "DIFFER");
+
+    arena_destroy(serial_arena);
+    arena_destroy(parallel_arena);
+    ufbx_free_scene(fbx_scene);
+}
+
+// Resolves the textures of every material part the way load_mesh_part used to, comparing against every
+// texture, and through the texture index, and checks both bind the same slots.
+void benchmark_texture_binding(char* path)
+{
+    ufbx_load_opts opts = fbx_load_opts(0);
+    ufbx_error error;
+    ufbx_scene *fbx_scene = ufbx_load_file(path, &opts, &error);
+    if (!fbx_scene)
+    {
+        fprintf(stderr, "Failed to load: %s\n", error.description.data);
+        exit(1);
+    }
+
+    struct Arena* arena = arena_create(0);
+    size_t texture_count = fbx_scene->textures.count;
+    struct Texture* texture_array = arena_alloc(arena, texture_count * sizeof(struct Texture));
+    for (size_t i = 0; i < texture_count; i++)
+        texture_array[i].path = arena_get_asset_path(arena, fbx_scene->textures.data[i]->relative_filename.data);
+
+    size_t part_count = 0;
+    size_t mismatches = 0;
+    double linear_time = 0.0;
+    double indexed_time = 0.0;
+    unsigned long long timestamp1 = GetRdtsc();
+    struct Texture_Index texture_index = {0};
+    texture_index_build(&texture_index, texture_array, texture_count);
+    unsigned long long timestamp2 = GetRdtsc();
+    double build_time = (double)(timestamp2 - timestamp1) / GetRdtscFreq();
+
+    for (size_t m = 0; m < fbx_scene->meshes.count; m++)
+    {
+        ufbx_mesh* mesh = fbx_scene->meshes.data[m];
+        for (size_t material_index = 0; material_index < mesh->material_parts.count && material_index < mesh->materials.count; material_index++)
+        {
+            ufbx_material* material = mesh->materials.data[material_index];
+            struct Texture* linear_color = 0;
+            struct Texture* linear_normal = 0;
+
+            unsigned long long timestamp3 = GetRdtsc();
+            for (size_t i = 0; i < texture_count; i++)
+            {
+                if (material->pbr.base_color.texture && strcmp(material->pbr.base_color.texture->filename.data, texture_array[i].path) == 0)
+                    linear_color = &texture_array[i];
+                if (material->pbr.normal_map.texture && strcmp(material->pbr.normal_map.texture->filename.data, texture_array[i].path) == 0)
+                    linear_normal = &texture_array[i];
+            }
+            unsigned long long timestamp4 = GetRdtsc();
+            struct Texture* indexed_color = texture_index_find_fbx(&texture_index, material->pbr.base_color.texture);
+            struct Texture* indexed_normal = texture_index_find_fbx(&texture_index, material->pbr.normal_map.texture);
+            unsigned long long timestamp5 = GetRdtsc();
+
+            linear_time += (double)(timestamp4 - timestamp3) / GetRdtscFreq();
+            indexed_time += (double)(timestamp5 - timestamp4) / GetRdtscFreq();
+            mismatches += (linear_color != indexed_color) + (linear_normal != indexed_normal);
+            part_count++;
+        }
+    }
+
+    printf("Texture binding (%zu parts, %zu textures): linear ms: %.3f  indexed ms: %.3f (+ %.3f build)  speedup: %.2fx  mismatches: %zu\n", part_count, texture_count, linear_time * 1000.0, indexed_time * 1000.0, build_time * 1000.0, linear_time / (indexed_time + build_time), mismatches);
+
+    texture_index_destroy(&texture_index);
+    arena_destroy(arena);
+    ufbx_free_scene(fbx_scene);
+}
+
+// Counts what ufbx_generate_indices allocates, for comparing peak memory against the welder.
+struct Tracked_Memory
+{
+    size_t bytes;
+    size_t peak_bytes;
+};
+void* tracked_alloc(void* user, size_t size)
+{
+    struct Tracked_Memory* memory = user;
+    memory->bytes += size;
+    memory->peak_bytes = max(memory->peak_bytes, memory->bytes);
+    return malloc(size);
+}
+void* tracked_realloc(void* user, void* old_ptr, size_t old_size, size_t new_size)
+{
+    struct Tracked_Memory* memory = user;
+    memory->peak_bytes = max(memory->peak_bytes, memory->bytes + new_size);
+    memory->bytes = memory->bytes + new_size - old_size;
+    return realloc(old_ptr, new_size);
+}
+void tracked_free(void* user, void* ptr, size_t size)
+{
+    struct Tracked_Memory* memory = user;
+    memory->bytes -= size;
+    free(ptr);
+}
+// Welds every mesh part the old way, expanding all corners and running ufbx_generate_indices, and
+// through the streaming welder. Checks the two agree bit for bit and compares the largest amount of
+// scratch memory either needed for a single part, which is what bounds a load's peak.
+void benchmark_vertex_welding(char* path)
+{
+    ufbx_load_opts opts = fbx_load_opts(0);
+    ufbx_error error;
+    ufbx_scene *fbx_scene = ufbx_load_file(path, &opts, &error);
+    if (!fbx_scene)
+    {
+        fprintf(stderr, "Failed to load: %s\n", error.description.data);
+        exit(1);
+    }
+
+    size_t part_count = 0;
+    size_t mismatches = 0;
+    size_t expanded_peak = 0;
+    size_t streaming_peak = 0;
+    double expanded_time = 0.0;
+    double streaming_time = 0.0;
+    for (size_t m = 0; m < fbx_scene->meshes.count; m++)
+    {
+        ufbx_mesh* mesh = fbx_scene->meshes.data[m];
+        for (size_t p = 0; p < mesh->material_parts.count; p++)
+        {
+            ufbx_mesh_part* part = &mesh->material_parts.data[p];
+            size_t num_indices = part->num_triangles * 3;
+            if (num_indices == 0)
+                continue;
+
+            unsigned long long timestamp1 = GetRdtsc();
+            struct Vertex* vertices = calloc(num_indices, sizeof(struct Vertex));
+            uint32_t* expanded_indices = calloc(num_indices, sizeof(uint32_t));
+            size_t num_tri_indices = mesh->max_face_triangles * 3;
+            uint32_t* tri_indices = calloc(num_tri_indices, sizeof(uint32_t));
+            size_t num_vertices = 0;
+            for (size_t face_ix = 0; face_ix < part->num_faces; face_ix++)
+            {
+                uint32_t num_tris = ufbx_triangulate_face(tri_indices, num_tri_indices, mesh, mesh->faces.data[part->face_indices.data[face_ix]]);
+                for (size_t i = 0; i < num_tris * 3; i++)
+                    load_mesh_vertex(mesh, tri_indices[i], &vertices[num_vertices++]);
+            }
+            free(tri_indices);
+            struct Tracked_Memory ufbx_memory = {0};
+            ufbx_allocator_opts allocator = { .allocator = { .alloc_fn = tracked_alloc, .realloc_fn = tracked_realloc, .free_fn = tracked_free, .user = &ufbx_memory } };
+            ufbx_vertex_stream streams[1] = {
+                { vertices, num_vertices, sizeof(struct Vertex) },
+            };
+            num_vertices = ufbx_generate_indices(streams, 1, expanded_indices, num_indices, &allocator, NULL);
+            unsigned long long timestamp2 = GetRdtsc();
+
+            uint32_t* streaming_indices = calloc(num_indices, sizeof(uint32_t));
+            struct Vertex_Welder welder = vertex_welder_create(num_indices);
+            load_mesh_part_vertices(mesh, part, &welder, streaming_indices);
+            unsigned long long timestamp3 = GetRdtsc();
+
+            if (welder.count != num_vertices || memcmp(welder.vertices, vertices, num_vertices * sizeof(struct Vertex)) != 0 || memcmp(streaming_indices, expanded_indices, num_indices * sizeof(uint32_t)) != 0)
+                mismatches++;
+            expanded_peak = max(expanded_peak, num_indices * (sizeof(struct Vertex) + sizeof(uint32_t)) + ufbx_memory.peak_bytes);
+            streaming_peak = max(streaming_peak, num_indices * sizeof(uint32_t) + welder.peak_bytes);
+            expanded_time += (double)(timestamp2 - timestamp1) / GetRdtscFreq();
+            streaming_time += (double)(timestamp3 - timestamp2) / GetRdtscFreq();
+            part_count++;
+
+            vertex_welder_destroy(&welder);
+            free(streaming_indices);
+            free(expanded_indices);
+            free(vertices);
+        }
+    }
+
+    printf("Vertex welding (%zu parts): expanded peak %.2f MB, %.3f ms  streaming peak %.2f MB, %.3f ms  peak reduced %.2fx  mismatches: %zu\n", part_count,
+        (double)expanded_peak / (1024.0 * 1024.0), expanded_time * 1000.0, (double)streaming_peak / (1024.0 * 1024.0), streaming_time * 1000.0,
+        streaming_peak ? (double)expanded_peak / (double)streaming_peak : 0.0, mismatches);
+    ufbx_free_scene(fbx_scene);
+}
+
+// Compares walking up the parents for every mesh part, like upload_node_buffers used to, against the
+// flattened pass, and reports the largest difference between the two.
+void benchmark_transforms(struct Scene* scene, int rounds)
+{
+    struct Scene_Transforms* transforms = &scene->transforms;
+    Mat4* reference = calloc(transforms->count, sizeof(Mat4));
+
+    unsigned long long timestamp1 = GetRdtsc();
+    for (int round = 0; round < rounds; round++)
+    {
+        for (size_t i = 0; i < transforms->count; i++)
+        {
+            struct Node* node = transforms->nodes[i];
+            size_t part_count = node->type == NODE_TYPE_MESH ? max(node->mesh.mesh_parts_count, 1) : 1;
+            for (size_t part = 0; part < part_count; part++)
+                reference[i] = node_global_transform_geometry(node);
+        }
+    }
+    unsigned long long timestamp2 = GetRdtsc();
+    for (int round = 0; round < rounds; round++)
+        scene_update_world_transforms(scene);
+    unsigned long long timestamp3 = GetRdtsc();
+
+    float max_error = 0.0f;
+    for (size_t i = 0; i < transforms->count; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            for (int r = 0; r < 4; r++)
+            {
+                float error = fabsf(reference[i].Elements[c][r] - transforms->world_geometry[i].Elements[c][r]);
+                if (error > max_error)
+                    max_error = error;
+            }
+        }
+    }
+    free(reference);
+
+    double recursive_time = (double)(timestamp2 - timestamp1) / GetRdtscFreq() / rounds;
+    double flat_time = (double)(timestamp3 - timestamp2) / GetRdtscFreq() / rounds;
+    printf("Transforms (%zu nodes): recursive ms: %.4f  flat ms: %.4f  speedup: %.2fx  max error: %g\n", transforms->count, recursive_time * 1000.0, flat_time * 1000.0, recursive_time / flat_time, max_error);
+
+    // Moving a single leaf should only cost that leaf, and must land on the same matrices as a full update.
+    struct Node* leaf = transforms->nodes[transforms->count - 1];
+    Vec3 original_position = leaf->local_position;
+    unsigned long long timestamp4 = GetRdtsc();
+    for (int round = 0; round < rounds; round++)
+    {
+        scene_set_local_transform(scene, leaf, AddV3(original_position, V3((float)round, 0.0f, 0.0f)), leaf->local_rotation, leaf->local_scale);
+        scene_update_dirty_transforms(scene);
+    }
+    unsigned long long timestamp5 = GetRdtsc();
+    size_t changed_count = transforms->changed_count;
+
+    Mat4 incremental = transforms->world_geometry[transforms->count - 1];
+    scene_update_world_transforms(scene);
+    int incremental_equal = memcmp(&incremental, &transforms->world_geometry[transforms->count - 1], sizeof(Mat4)) == 0;
+
+    scene_set_local_transform(scene, leaf, original_position, leaf->local_rotation, leaf->local_scale);
+    scene_update_world_transforms(scene);
+
+    double dirty_time = (double)(timestamp5 - timestamp4) / GetRdtscFreq() / rounds;
+    printf("Transforms one moved leaf: dirty ms: %.4f  nodes updated: %zu  matches full update: %s\n", dirty_time * 1000.0, changed_count, incremental_equal ? "yes" : "no");
+}
+
+// Round trips every vertex of the scene through struct Compact_Vertex and checks the error against what
+// each encoding allows: half a quantization step for positions and colors, half a half-float ulp for uvs,
+// and a small angle for the octahedral normals and tangents.
+struct Compact_Vertex_Errors
+{
+    size_t vertex_count;
+    float position_steps;
+    float position_excess;
+    float color;
+    float uv_ulps;
+    float normal_degrees;
+    float tangent_degrees;
+    size_t tangent_sign_mismatches;
+};
+float vector_angle_degrees(Vec3 a, Vec3 b)
+{
+    // atan2 rather than acos, which has no precision left for angles this small.
+    if (DotV3(a, a) <= 0.0f || DotV3(b, b) <= 0.0f)
+        return 0.0f;
+    return ToDeg(atan2f(LenV3(Cross(a, b)), DotV3(a, b)));
+}
+void check_compact_vertices_node(struct Node* node, struct Compact_Vertex_Errors* errors)
+{
+    if (node->type == NODE_TYPE_MESH)
+    {
+        for (size_t i = 0; i < node->mesh.mesh_parts_count; i++)
+        {
+            struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[i];
+            mesh_part_compute_bounds(mesh_part);
+            for (size_t j = 0; j < mesh_part->vertex_count; j++)
+            {
+                struct Vertex* vertex = &mesh_part->vertex_array[j];
+                struct Compact_Vertex compact = compact_vertex_encode(vertex, mesh_part->position_min, mesh_part->position_extent);
+                struct Vertex decoded = compact_vertex_decode(&compact, mesh_part->position_min, mesh_part->position_extent);
+
+                for (int k = 0; k < 3; k++)
+                {
+                    // Decoding in float adds rounding on top of the quantization, a few ulps of the coordinate.
+                    float step = mesh_part->position_extent.Elements[k] / 65535.0f;
+                    float error = fabsf(decoded.pos.Elements[k] - vertex->pos.Elements[k]);
+                    float float_slack = 4.0f * FLT_EPSILON * (fabsf(mesh_part->position_min.Elements[k]) + mesh_part->position_extent.Elements[k]);
+                    if (step > 0.0f)
+                        errors->position_steps = max(errors->position_steps, error / step);
+                    errors->position_excess = max(errors->position_excess, error - (0.5f * step + float_slack));
+                }
+                for (int k = 0; k < 4; k++)
+                {
+                    float color = vertex->color.Elements[k] < 0.0f ? 0.0f : vertex->color.Elements[k] > 1.0f ? 1.0f : vertex->color.Elements[k];
+                    errors->color = max(errors->color, fabsf(decoded.color.Elements[k] - color));
+                }
+                for (int k = 0; k < 2; k++)
+                {
+                    // One ulp of a half is 2^-10 of its power of two, or 2^-24 for subnormals.
+                    float value = fabsf(vertex->uv.Elements[k]);
+                    float ulp = value >= 6.103515625e-05f ? ldexpf(1.0f, ilogbf(value) - 10) : 5.9604645e-08f;
+                    errors->uv_ulps = max(errors->uv_ulps, fabsf(decoded.uv.Elements[k] - vertex->uv.Elements[k]) / ulp);
+                }
+                errors->normal_degrees = max(errors->normal_degrees, vector_angle_degrees(vertex->normal, decoded.normal));
+                errors->tangent_degrees = max(errors->tangent_degrees, vector_angle_degrees(vertex->tangent.XYZ, decoded.tangent.XYZ));
+                errors->tangent_sign_mismatches += (vertex->tangent.W < 0.0f) != (decoded.tangent.W < 0.0f);
+            }
+            errors->vertex_count += mesh_part->vertex_count;
+        }
+    }
+
+    for (size_t i = 0; i < node->child_count; i++)
+        check_compact_vertices_node(node->child_array[i], errors);
+}
+int check_compact_vertices(struct Node* root)
+{
+    struct Compact_Vertex_Errors errors = {0};
+    check_compact_vertices_node(root, &errors);
+
+    int passed = errors.position_excess <= 0.0f &&
+        errors.color <= 0.5f / 255.0f + 1e-6f &&
+        errors.uv_ulps <= 0.5f &&
+        errors.normal_degrees <= 0.01f &&
+        errors.tangent_degrees <= 0.01f &&
+        errors.tangent_sign_mismatches == 0;
+
+    printf("Compact vertices (%zu): %zu -> %zu bytes (%.2fx)\n", errors.vertex_count, errors.vertex_count * sizeof(struct Vertex), errors.vertex_count * sizeof(struct Compact_Vertex), (double)sizeof(struct Vertex) / sizeof(struct Compact_Vertex));
+    printf("Compact vertices max error: position steps: %.3f  color: %.5f  uv ulps: %.3f  normal deg: %.4f  tangent deg: %.4f  tangent signs: %zu  %s\n", errors.position_steps, errors.color, errors.uv_ulps, errors.normal_degrees, errors.tangent_degrees, errors.tangent_sign_mismatches, passed ? "PASS" : "FAIL");
+    return passed;
+}
+
+// Every triangle of the part must turn up in exactly one meshlet, with the same winding, and the bounds
+// must hold everything they claim to.
+int triangle_compare(const void* a, const void* b)
+{
+    const unsigned int* triangle_a = a;
+    const unsigned int* triangle_b = b;
+    for (int i = 0; i < 3; i++)
+    {
+        if (triangle_a[i] != triangle_b[i])
+            return triangle_a[i] < triangle_b[i] ? -1 : 1;
+    }
+    return 0;
+}
+void triangle_rotate_smallest_first(unsigned int* triangle)
+{
+    while (triangle[0] > triangle[1] || triangle[0] > triangle[2])
+    {
+        unsigned int first = triangle[0];
+        triangle[0] = triangle[1];
+        triangle[1] = triangle[2];
+        triangle[2] = first;
+    }
+}
+int validate_meshlets(struct Mesh_Part* mesh_part)
+{
+    size_t triangle_count = mesh_part->index_count / 3;
+    unsigned int* original = malloc(triangle_count * 3 * sizeof(unsigned int));
+    unsigned int* rebuilt = malloc(triangle_count * 3 * sizeof(unsigned int));
+    for (size_t i = 0; i < triangle_count * 3; i++)
+        original[i] = mesh_part_get_index(mesh_part, i);
+
+    int valid = 1;
+    size_t rebuilt_count = 0;
+    for (size_t m = 0; m < mesh_part->meshlet_count && valid; m++)
+    {
+        struct Meshlet* meshlet = &mesh_part->meshlet_array[m];
+        if (meshlet->vertex_count > MESHLET_MAX_VERTICES || meshlet->triangle_count > MESHLET_MAX_TRIANGLES || meshlet->triangle_count == 0 ||
+            meshlet->vertex_offset + meshlet->vertex_count > mesh_part->meshlet_vertex_count ||
+            meshlet->triangle_offset + meshlet->triangle_count > mesh_part->meshlet_triangle_count ||
+            rebuilt_count + meshlet->triangle_count > triangle_count)
+        {
+            valid = 0;
+            break;
+        }
+
+        const unsigned int* local_vertices = mesh_part->meshlet_vertex_array + meshlet->vertex_offset;
+        const unsigned char* local_triangles = mesh_part->meshlet_triangle_array + meshlet->triangle_offset * 3;
+        float cone_cos = sqrtf(1.0f - meshlet->cone_cutoff * meshlet->cone_cutoff);
+        for (unsigned int t = 0; t < meshlet->triangle_count && valid; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                if (local_triangles[t * 3 + k] >= meshlet->vertex_count || local_vertices[local_triangles[t * 3 + k]] >= mesh_part->vertex_count)
+                    valid = 0;
+                else
+                    rebuilt[rebuilt_count * 3 + k] = local_vertices[local_triangles[t * 3 + k]];
+            }
+            if (!valid)
+                break;
+
+            if (meshlet->cone_cutoff < 1.0f)
+            {
+                Vec3 p0 = mesh_part->vertex_array[rebuilt[rebuilt_count * 3 + 0]].pos;
+                Vec3 p1 = mesh_part->vertex_array[rebuilt[rebuilt_count * 3 + 1]].pos;
+                Vec3 p2 = mesh_part->vertex_array[rebuilt[rebuilt_count * 3 + 2]].pos;
+                Vec3 normal = meshlet_triangle_normal(p0, p1, p2, meshlet->radius);
+                if (DotV3(normal, normal) > 0.0f && DotV3(normal, meshlet->cone_axis) < cone_cos - 1e-3f)
+                    valid = 0;
+            }
+            rebuilt_count++;
+        }
+        for (unsigned int i = 0; i < meshlet->vertex_count && valid; i++)
+        {
+            float distance = LenV3(SubV3(mesh_part->vertex_array[local_vertices[i]].pos, meshlet->center));
+            if (distance > meshlet->radius * 1.0001f + 1e-5f)
+                valid = 0;
+        }
+    }
+    valid = valid && rebuilt_count == triangle_count;
+
+    if (valid)
+    {
+        for (size_t t = 0; t < triangle_count; t++)
+        {
+            triangle_rotate_smallest_first(&original[t * 3]);
+            triangle_rotate_smallest_first(&rebuilt[t * 3]);
+        }
+        qsort(original, triangle_count, 3 * sizeof(unsigned int), triangle_compare);
+        qsort(rebuilt, triangle_count, 3 * sizeof(unsigned int), triangle_compare);
+        valid = memcmp(original, rebuilt, triangle_count * 3 * sizeof(unsigned int)) == 0;
+    }
+
+    free(original);
+    free(rebuilt);
+    return valid;
+}
+struct Meshlet_Stats
+{
+    size_t part_count;
+    size_t invalid_part_count;
+    size_t meshlet_count;
+    size_t vertex_count;
+    size_t triangle_count;
+    size_t cullable_count;
+    size_t bytes;
+};
+void check_meshlets_node(struct Node* node, struct Meshlet_Stats* stats)
+{
+    if (node->type == NODE_TYPE_MESH)
+    {
+        for (size_t i = 0; i < node->mesh.mesh_parts_count; i++)
+        {
+            struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[i];
+            stats->part_count++;
+            stats->invalid_part_count += !validate_meshlets(mesh_part);
+            stats->meshlet_count += mesh_part->meshlet_count;
+            for (size_t m = 0; m < mesh_part->meshlet_count; m++)
+            {
+                stats->vertex_count += mesh_part->meshlet_array[m].vertex_count;
+                stats->triangle_count += mesh_part->meshlet_array[m].triangle_count;
+                stats->cullable_count += mesh_part->meshlet_array[m].cone_cutoff < 1.0f;
+            }
+            stats->bytes += mesh_part->meshlet_count * sizeof(struct Meshlet) + mesh_part->meshlet_vertex_count * sizeof(unsigned int) + mesh_part->meshlet_triangle_count * 3;
+        }
+    }
+
+    for (size_t i = 0; i < node->child_count; i++)
+        check_meshlets_node(node->child_array[i], stats);
+}
+int check_meshlets(struct Node* root)
+{
+    struct Meshlet_Stats stats = {0};
+    check_meshlets_node(root, &stats);
+    double meshlet_count = stats.meshlet_count ? (double)stats.meshlet_count : 1.0;
+    printf("Meshlets: %zu over %zu parts, %.1f vertices and %.1f triangles on average, %zu with a usable normal cone, %.2f MB  %s (%zu invalid parts)\n",
+        stats.meshlet_count, stats.part_count, stats.vertex_count / meshlet_count, stats.triangle_count / meshlet_count, stats.cullable_count,
+        (double)stats.bytes / (1024.0 * 1024.0), stats.invalid_part_count ? "FAIL" : "PASS", stats.invalid_part_count);
+    return stats.invalid_part_count == 0;
+}
+
+// Runs MikkTSpace and generate_tangents, serially and on the pool, over every mesh part of the given
+// scenes and reports how far apart their tangents are and how long each took.
+void benchmark_tangents(struct Thread_Pool* thread_pool)
+{
+    const char* files[] = { "Sphere_High.fbx", "Sponza.fbx", "NewSponza_Main_Yup_003.fbx" };
+    for (size_t f = 0; f < ARRAYSIZE(files); f++)
+    {
+        char* path = get_asset_path(files[f]);
+        ufbx_load_opts opts = fbx_load_opts(0);
+        ufbx_error error;
+        ufbx_scene *fbx_scene = ufbx_load_file(path, &opts, &error);
+        free(path);
+        if (!fbx_scene)
+        {
+            fprintf(stderr, "Failed to load %s: %s\n", files[f], error.description.data);
+            continue;
+        }
+
+        size_t vertex_count = 0;
+        size_t sign_mismatches = 0;
+        size_t over_tolerance = 0;
+        double angle_sum = 0.0;
+        double max_angle = 0.0;
+        double mikkt_time = 0.0;
+        double serial_time = 0.0;
+        double parallel_time = 0.0;
+        for (size_t m = 0; m < fbx_scene->meshes.count; m++)
+        {
+            ufbx_mesh* mesh = fbx_scene->meshes.data[m];
+            for (size_t p = 0; p < mesh->material_parts.count; p++)
+            {
+                ufbx_mesh_part* part = &mesh->material_parts.data[p];
+                size_t num_indices = part->num_triangles * 3;
+                if (num_indices == 0)
+                    continue;
+
+                uint32_t* indices = calloc(num_indices, sizeof(uint32_t));
+                struct Vertex_Welder welder = vertex_welder_create(num_indices);
+                load_mesh_part_vertices(mesh, part, &welder, indices);
+                size_t part_vertex_count = welder.count;
+                struct Vertex* mikkt_vertices = malloc(part_vertex_count * sizeof(struct Vertex));
+                struct Vertex* fast_vertices = malloc(part_vertex_count * sizeof(struct Vertex));
+                memcpy(mikkt_vertices, welder.vertices, part_vertex_count * sizeof(struct Vertex));
+                memcpy(fast_vertices, welder.vertices, part_vertex_count * sizeof(struct Vertex));
+                vertex_welder_destroy(&welder);
+
+                struct Mesh_Part mikkt_part = { .vertex_array = mikkt_vertices, .vertex_count = part_vertex_count, .index_array = indices, .index_count = num_indices };
+                struct Mesh_Part fast_part = { .vertex_array = fast_vertices, .vertex_count = part_vertex_count, .index_array = indices, .index_count = num_indices };
+
+                SMikkTSpaceInterface mikkt_interface = {
+                    .m_getNumFaces = mikkt_get_num_faces,
+                    .m_getNumVerticesOfFace = mikkt_get_num_vertices_of_face,
+                    .m_getPosition = mikkt_get_position,
+                    .m_getNormal = mikkt_get_normal,
+                    .m_getTexCoord = mikkt_get_tex_coord,
+                    .m_setTSpaceBasic = mikkt_set_t_space_basic,
+                };
+                SMikkTSpaceContext ctx = { .m_pInterface = &mikkt_interface, .m_pUserData = &mikkt_part };
+                unsigned long long timestamp1 = GetRdtsc();
+                genTangSpaceDefault(&ctx);
+                unsigned long long timestamp2 = GetRdtsc();
+                generate_tangents(&fast_part, indices, 0);
+                unsigned long long timestamp3 = GetRdtsc();
+                generate_tangents(&fast_part, indices, thread_pool);
+                unsigned long long timestamp4 = GetRdtsc();
+                mikkt_time += (double)(timestamp2 - timestamp1) / GetRdtscFreq();
+                serial_time += (double)(timestamp3 - timestamp2) / GetRdtscFreq();
+                parallel_time += (double)(timestamp4 - timestamp3) / GetRdtscFreq();
+
+                for (size_t v = 0; v < part_vertex_count; v++)
+                {
+                    Vec4 a = mikkt_vertices[v].tangent;
+                    Vec4 b = fast_vertices[v].tangent;
+                    double angle = vector_angle_degrees(a.XYZ, b.XYZ);
+                    sign_mismatches += a.W != b.W;
+                    over_tolerance += angle > 1.0;
+                    angle_sum += angle;
+                    max_angle = max(max_angle, angle);
+                }
+                vertex_count += part_vertex_count;
+
+                free(mikkt_vertices);
+                free(fast_vertices);
+                free(indices);
+            }
+        }
+
+        printf("Tangents %s (%zu vertices): MikkTSpace ms: %.3f  generate_tangents ms: %.3f serial, %.3f on %u threads  speedup: %.2fx\n", files[f], vertex_count,
+            mikkt_time * 1000.0, serial_time * 1000.0, parallel_time * 1000.0, thread_pool_get_thread_count(thread_pool), mikkt_time / parallel_time);
+        printf("Tangents %s: mean error %.4f deg  max %.4f deg  over 1 deg: %zu  sign mismatches: %zu\n", files[f],
+            vertex_count ? angle_sum / (double)vertex_count : 0.0, max_angle, over_tolerance, sign_mismatches);
+        ufbx_free_scene(fbx_scene);
+    }
+}
+
+struct Index_Memory
+{
+    size_t part_count;
+    size_t part_16_bit_count;
+    size_t bytes;
+    size_t bytes_32_bit;
+};
+void index_memory_node(struct Node* node, struct Index_Memory* memory)
+{
+    if (node->type == NODE_TYPE_MESH)
+    {
+        for (size_t i = 0; i < node->mesh.mesh_parts_count; i++)
+        {
+            struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[i];
+            memory->part_count++;
+            memory->part_16_bit_count += mesh_part->index_16_bit;
+            memory->bytes += mesh_part_index_size(mesh_part) * mesh_part_total_index_count(mesh_part);
+            memory->bytes_32_bit += sizeof(unsigned int) * mesh_part_total_index_count(mesh_part);
+        }
+    }
 
-    device_create_shader_resource_view(device, 0, cbv_srv_uav_descriptor_set, texture->buffer, &texture->srv);
+    for (size_t i = 0; i < node->child_count; i++)
+        index_memory_node(node->child_array[i], memory);
+}
+void report_index_memory(struct Node* root)
+{
+    struct Index_Memory memory = {0};
+    index_memory_node(root, &memory);
+    printf("Index buffers: %zu of %zu parts 16 bit, %.2f MB instead of %.2f MB, saved %.2f MB\n", memory.part_16_bit_count, memory.part_count,
+        (double)memory.bytes / (1024.0 * 1024.0), (double)memory.bytes_32_bit / (1024.0 * 1024.0), (double)(memory.bytes_32_bit - memory.bytes) / (1024.0 * 1024.0));
+}
 
-    buffer_set_name(texture->buffer, texture->path);
+struct Lod_Stats
+{
+    size_t part_count[MESH_LOD_MAX];
+    size_t triangle_count[MESH_LOD_MAX];
+    double error_sum[MESH_LOD_MAX];
+};
+void lod_stats_node(struct Node* node, struct Lod_Stats* stats)
+{
+    if (node->type == NODE_TYPE_MESH)
+    {
+        for (size_t i = 0; i < node->mesh.mesh_parts_count; i++)
+        {
+            struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[i];
+            for (unsigned int lod = 0; lod < mesh_part->lod_count; lod++)
+            {
+                stats->part_count[lod]++;
+                stats->triangle_count[lod] += mesh_part->lod_array[lod].index_count / 3;
+                stats->error_sum[lod] += mesh_part->lod_array[lod].error;
+            }
+        }
+    }
 
-    struct Upload_Buffer *texture_upload_buffer = 0;
-    device_create_upload_buffer(device, 0, (unsigned long long)(x * y * sizeof(unsigned char) * component_count), &texture_upload_buffer);
+    for (size_t i = 0; i < node->child_count; i++)
+        lod_stats_node(node->child_array[i], stats);
+}
+void report_lods(struct Node* root)
+{
+    struct Lod_Stats stats = {0};
+    lod_stats_node(root, &stats);
+    for (int lod = 0; lod < MESH_LOD_MAX && stats.part_count[lod]; lod++)
+        printf("LOD %d: %zu parts, %zu triangles, average error %f\n", lod, stats.part_count[lod], stats.triangle_count[lod], stats.error_sum[lod] / (double)stats.part_count[lod]);
+}
 
-    void *mapped = upload_buffer_map(texture_upload_buffer);
-    mapped;
+struct Mesh_Optimization_Stats
+{
+    struct Vertex_Cache_Stats vertex_cache;
+    struct Vertex_Fetch_Stats vertex_fetch;
+    struct Vertex_Fetch_Stats vertex_fetch_compact;
+    struct Overdraw_Stats overdraw;
+};
+void mesh_optimization_stats_node(struct Node* node, struct Mesh_Optimization_Stats* stats)
+{
+    if (node->type == NODE_TYPE_MESH)
+    {
+        for (size_t i = 0; i < node->mesh.mesh_parts_count; i++)
+        {
+            vertex_cache_stats_add(&stats->vertex_cache, &node->mesh.mesh_parts[i]);
+            vertex_fetch_stats_add(&stats->vertex_fetch, &node->mesh.mesh_parts[i], sizeof(struct Vertex));
+            vertex_fetch_stats_add(&stats->vertex_fetch_compact, &node->mesh.mesh_parts[i], sizeof(struct Compact_Vertex));
+            overdraw_stats_add(&stats->overdraw, &node->mesh.mesh_parts[i]);
+        }
+    }
+
+    for (size_t i = 0; i < node->child_count; i++)
+        mesh_optimization_stats_node(node->child_array[i], stats);
+}
+// Builds every FBX scene in the asset folder without mesh optimization, with only the vertex cache pass,
+// and with everything, and compares cache efficiency, vertex fetch, overdraw and load time.
+void benchmark_mesh_optimization(struct Thread_Pool* thread_pool)
+{
+    char* pattern = get_asset_path("*.fbx");
+    WIN32_FIND_DATAA find_data;
+    HANDLE find = FindFirstFileA(pattern, &find_data);
+    free(pattern);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
 
-    memcpy(mapped, image_data, sizeof(unsigned char) * component_count * x * y);
+    struct Mesh_Process_Options original_options = MeshProcessOptions;
+    struct Mesh_Process_Options configurations[] = {
+        { .optimize_vertex_cache = 0, .optimize_overdraw = 0, .optimize_vertex_fetch = 0 },
+        { .optimize_vertex_cache = 1, .optimize_overdraw = 0, .optimize_vertex_fetch = 0 },
+        { .optimize_vertex_cache = 1, .optimize_overdraw = 1, .optimize_vertex_fetch = 1 },
+    };
+    const char* configuration_names[] = { "none", "vertex cache", "all" };
+    do
+    {
+        char* path = get_asset_path(find_data.cFileName);
+        struct Ufbx_Thread_Pool ufbx_pool = { .pool = thread_pool };
+        ufbx_load_opts opts = fbx_load_opts(&ufbx_pool);
+        ufbx_error error;
+        ufbx_scene *fbx_scene = ufbx_load_file(path, &opts, &error);
+        free(path);
+        if (!fbx_scene)
+        {
+            fprintf(stderr, "Failed to load %s: %s\n", find_data.cFileName, error.description.data);
+            continue;
+        }
 
-    upload_buffer_unmap(texture_upload_buffer);
+        for (size_t i = 0; i < ARRAYSIZE(configurations); i++)
+        {
+            MeshProcessOptions = configurations[i];
+            struct Arena* arena = arena_create(0);
+            unsigned long long timestamp1 = GetRdtsc();
+            struct Node* root = load_scene(fbx_scene, arena, thread_pool);
+            unsigned long long timestamp2 = GetRdtsc();
+            double load_time = (double)(timestamp2 - timestamp1) / GetRdtscFreq();
+
+            struct Mesh_Optimization_Stats stats = {0};
+            mesh_optimization_stats_node(root, &stats);
+            arena_destroy(arena);
+
+            printf("Mesh optimization %s, %s (%zu triangles): ACMR %.3f  ATVR %.3f  overfetch %.3f (compact %.3f)  overdraw %.3f  load ms: %.3f\n", find_data.cFileName, configuration_names[i], stats.vertex_cache.triangle_count,
+                vertex_cache_acmr(&stats.vertex_cache), vertex_cache_atvr(&stats.vertex_cache), vertex_fetch_overfetch(&stats.vertex_fetch), vertex_fetch_overfetch(&stats.vertex_fetch_compact), overdraw_ratio(&stats.overdraw), load_time * 1000.0);
+        }
+        ufbx_free_scene(fbx_scene);
+    } while (FindNextFileA(find, &find_data));
+    FindClose(find);
 
-    stbi_image_free(image_data);
+    MeshProcessOptions = original_options;
+}
 
-    command_list_copy_upload_buffer_to_buffer(upload_command_list, texture_upload_buffer, texture->buffer);
-    upload_buffer_destroy(texture_upload_buffer);
+// Loads and destroys the scene over and over, memory use after each round should stay flat.
+// Only the CPU side, nothing is uploaded.
+// Every round does a cold load that parses the FBX without the scene cache, then a warm one from the cache.
+void benchmark_scene_reload(char* path, struct Thread_Pool* thread_pool, int rounds)
+{
+    int original_use_scene_cache = UseSceneCache;
+    UseSceneCache = 1;
+    scene_destroy(load_fbx(path, thread_pool)); // Makes sure the warm loads find a cache.
+
+    const char* names[] = { "cold", "warm" };
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int warm = 0; warm < 2; warm++)
+        {
+            UseSceneCache = warm;
+            unsigned long long timestamp1 = GetRdtsc();
+            struct Scene* scene = load_fbx(path, thread_pool);
+            size_t arena_size = scene->arena ? arena_get_committed_size(scene->arena) : 0;
+            scene_destroy(scene);
+            unsigned long long timestamp2 = GetRdtsc();
+
+            size_t working_set = 0;
+            size_t private_bytes = 0;
+            get_process_memory(&working_set, &private_bytes);
+            double time = (double)(timestamp2 - timestamp1) / GetRdtscFreq();
+            printf("Reload %3d %s  ms: %10.3f  arena: %8.2f MB  private after destroy: %8.2f MB\n", round, names[warm], time * 1000.0, arena_size / (1024.0 * 1024.0), private_bytes / (1024.0 * 1024.0));
+        }
+    }
+    UseSceneCache = original_use_scene_cache;
 }
 
-void load_texture_dds(struct Texture *texture, struct Device *device, struct Descriptor_Set *cbv_srv_uav_descriptor_set, struct Command_List *upload_command_list)
+// Block compression of decoded PNGs into the same formats DDS files come in. A 4x4 block is fitted with a
+// line through its colors (principal axis, then least squares refinements), every pixel snapped to the
+// nearest point the format can interpolate along that line. The fitting runs on one row of the block per
+// SSE register, the rows of blocks run across the thread pool.
+enum BC_QUALITY
+{
+    BC_QUALITY_FAST,   // Principal axis only, BC1/BC3 for color.
+    BC_QUALITY_NORMAL, // One refinement.
+    BC_QUALITY_HIGH,   // Three refinements, BC7 for color.
+};
+static int UseTextureCompression = 1;
+static enum BC_QUALITY TextureCompressionQuality = BC_QUALITY_NORMAL;
+static const int BcRefinements[] = { 0, 1, 3 };
+
+struct Bc_Block
+{
+    float channel[4][16]; // Pixels in row order, 0-255.
+};
+// Blocks hanging over the edge of the image (mips smaller than a block) repeat the last row and column.
+void bc_load_block(const unsigned char* pixels, int width, int height, int component_count, int x, int y, struct Bc_Block* block)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        const unsigned char* source = pixels + ((size_t)min(y + row, height - 1) * (size_t)width + (size_t)x) * (size_t)component_count;
+        if (component_count == 4 && x + 4 <= width)
+        {
+            __m128i zero = _mm_setzero_si128();
+            __m128i bytes = _mm_loadu_si128((const __m128i*)source);
+            __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i high = _mm_unpackhi_epi8(bytes, zero);
+            __m128 p0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+            __m128 p1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+            __m128 p2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+            __m128 p3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+            _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+            _mm_storeu_ps(&block->channel[0][row * 4], p0);
+            _mm_storeu_ps(&block->channel[1][row * 4], p1);
+            _mm_storeu_ps(&block->channel[2][row * 4], p2);
+            _mm_storeu_ps(&block->channel[3][row * 4], p3);
+        }
+        else
+        {
+            for (int column = 0; column < 4; column++)
+                for (int c = 0; c < 4; c++)
+                    block->channel[c][row * 4 + column] = c < component_count ? source[min(column, width - 1 - x) * component_count + c] : 0.0f;
+        }
+    }
+}
+float bc_sum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(v);
+}
+float bc_clamp(float value)
+{
+    return value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+}
+// Where each pixel of channels [first, first + count) lies along origin + t * axis.
+void bc_project(const struct Bc_Block* block, int first, int count, const float* origin, const float* axis, float* t)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        __m128 sum = _mm_setzero_ps();
+        for (int c = 0; c < count; c++)
+        {
+            __m128 d = _mm_sub_ps(_mm_loadu_ps(&block->channel[first + c][row * 4]), _mm_set1_ps(origin[c]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(d, _mm_set1_ps(axis[c])));
+        }
+        _mm_storeu_ps(&t[row * 4], sum);
+    }
+}
+// Endpoints at the extremes of the block along its principal axis.
+void bc_fit_line(const struct Bc_Block* block, int first, int count, float* e0, float* e1)
+{
+    float mean[4] = {0};
+    for (int c = 0; c < count; c++)
+    {
+        __m128 sum = _mm_setzero_ps();
+        for (int row = 0; row < 4; row++)
+            sum = _mm_add_ps(sum, _mm_loadu_ps(&block->channel[first + c][row * 4]));
+        mean[c] = bc_sum(sum) / 16.0f;
+    }
+
+    float covariance[4][4] = {0};
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = 0; j <= i; j++)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (int row = 0; row < 4; row++)
+            {
+                __m128 di = _mm_sub_ps(_mm_loadu_ps(&block->channel[first + i][row * 4]), _mm_set1_ps(mean[i]));
+                __m128 dj = _mm_sub_ps(_mm_loadu_ps(&block->channel[first + j][row * 4]), _mm_set1_ps(mean[j]));
+                sum = _mm_add_ps(sum, _mm_mul_ps(di, dj));
+            }
+            covariance[i][j] = covariance[j][i] = bc_sum(sum);
+        }
+    }
+
+    // Power iteration, starting from the channel that varies most.
+    int largest = 0;
+    for (int c = 1; c < count; c++)
+        if (covariance[c][c] > covariance[largest][largest])
+            largest = c;
+    float axis[4] = {0};
+    for (int c = 0; c < count; c++)
+        axis[c] = covariance[largest][c];
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {0};
+        float scale = 0.0f;
+        for (int i = 0; i < count; i++)
+        {
+            for (int j = 0; j < count; j++)
+                next[i] += covariance[i][j] * axis[j];
+            scale = max(scale, fabsf(next[i]));
+        }
+        if (scale == 0.0f)
+            break;
+        for (int c = 0; c < count; c++)
+            axis[c] = next[c] / scale;
+    }
+    float length = 0.0f;
+    for (int c = 0; c < count; c++)
+        length += axis[c] * axis[c];
+    if (length == 0.0f)
+    {
+        // Flat block.
+        for (int c = 0; c < count; c++)
+            e0[c] = e1[c] = mean[c];
+        return;
+    }
+    length = sqrtf(length);
+    for (int c = 0; c < count; c++)
+        axis[c] /= length;
+
+    float t[16];
+    bc_project(block, first, count, mean, axis, t);
+    __m128 t_min = _mm_loadu_ps(&t[0]);
+    __m128 t_max = t_min;
+    for (int row = 1; row < 4; row++)
+    {
+        t_min = _mm_min_ps(t_min, _mm_loadu_ps(&t[row * 4]));
+        t_max = _mm_max_ps(t_max, _mm_loadu_ps(&t[row * 4]));
+    }
+    t_min = _mm_min_ps(t_min, _mm_movehl_ps(t_min, t_min));
+    t_min = _mm_min_ss(t_min, _mm_shuffle_ps(t_min, t_min, _MM_SHUFFLE(1, 1, 1, 1)));
+    t_max = _mm_max_ps(t_max, _mm_movehl_ps(t_max, t_max));
+    t_max = _mm_max_ss(t_max, _mm_shuffle_ps(t_max, t_max, _MM_SHUFFLE(1, 1, 1, 1)));
+    for (int c = 0; c < count; c++)
+    {
+        e0[c] = bc_clamp(mean[c] + _mm_cvtss_f32(t_min) * axis[c]);
+        e1[c] = bc_clamp(mean[c] + _mm_cvtss_f32(t_max) * axis[c]);
+    }
+}
+// Snaps every pixel to the nearest of steps evenly spaced points from e0 (position 0) to e1.
+void bc_positions(const struct Bc_Block* block, int first, int count, const float* e0, const float* e1, int steps, int* position)
+{
+    float axis[4] = {0};
+    float length = 0.0f;
+    for (int c = 0; c < count; c++)
+    {
+        axis[c] = e1[c] - e0[c];
+        length += axis[c] * axis[c];
+    }
+    if (length < 1e-6f)
+    {
+        memset(position, 0, sizeof(int) * 16);
+        return;
+    }
+    for (int c = 0; c < count; c++)
+        axis[c] *= (float)(steps - 1) / length;
+
+    float t[16];
+    bc_project(block, first, count, e0, axis, t);
+    for (int row = 0; row < 4; row++)
+    {
+        __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&t[row * 4]), _mm_setzero_ps()), _mm_set1_ps((float)(steps - 1)));
+        _mm_storeu_si128((__m128i*)&position[row * 4], _mm_cvtps_epi32(clamped));
+    }
+}
+// Least squares endpoints for pixels interpolated with the given weights, 0 at e0 and 1 at e1.
+void bc_refine_line(const struct Bc_Block* block, int first, int count, const float* weight, float* e0, float* e1)
+{
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 aa = _mm_setzero_ps();
+    __m128 ab = _mm_setzero_ps();
+    __m128 bb = _mm_setzero_ps();
+    __m128 xa[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+    __m128 xb[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+    for (int row = 0; row < 4; row++)
+    {
+        __m128 b = _mm_loadu_ps(&weight[row * 4]);
+        __m128 a = _mm_sub_ps(one, b);
+        aa = _mm_add_ps(aa, _mm_mul_ps(a, a));
+        ab = _mm_add_ps(ab, _mm_mul_ps(a, b));
+        bb = _mm_add_ps(bb, _mm_mul_ps(b, b));
+        for (int c = 0; c < count; c++)
+        {
+            __m128 p = _mm_loadu_ps(&block->channel[first + c][row * 4]);
+            xa[c] = _mm_add_ps(xa[c], _mm_mul_ps(a, p));
+            xb[c] = _mm_add_ps(xb[c], _mm_mul_ps(b, p));
+        }
+    }
+    float sum_aa = bc_sum(aa), sum_ab = bc_sum(ab), sum_bb = bc_sum(bb);
+    float determinant = sum_aa * sum_bb - sum_ab * sum_ab;
+    if (fabsf(determinant) < 1e-6f)
+        return; // Every pixel on the same weight, nothing to solve.
+    for (int c = 0; c < count; c++)
+    {
+        float sum_xa = bc_sum(xa[c]), sum_xb = bc_sum(xb[c]);
+        e0[c] = bc_clamp((sum_bb * sum_xa - sum_ab * sum_xb) / determinant);
+        e1[c] = bc_clamp((sum_aa * sum_xb - sum_ab * sum_xa) / determinant);
+    }
+}
+void bc_fit_refined(const struct Bc_Block* block, int first, int count, int steps, const int* weights, int refinements, float* e0, float* e1)
+{
+    bc_fit_line(block, first, count, e0, e1);
+    for (int i = 0; i < refinements; i++)
+    {
+        int position[16];
+        float weight[16];
+        bc_positions(block, first, count, e0, e1, steps, position);
+        for (int p = 0; p < 16; p++)
+            weight[p] = weights ? (float)weights[position[p]] / 64.0f : (float)position[p] / (float)(steps - 1);
+        bc_refine_line(block, first, count, weight, e0, e1);
+    }
+}
+
+unsigned short bc_pack_565(const float* color)
+{
+    int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+void bc_unpack_565(unsigned short packed, float* color)
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (float)((r << 3) | (r >> 2));
+    color[1] = (float)((g << 2) | (g >> 4));
+    color[2] = (float)((b << 3) | (b >> 2));
+}
+// Four color mode only (color0 > color1), which is also how BC3 reads its color half.
+void bc1_encode_block(const struct Bc_Block* block, int refinements, unsigned char* out)
+{
+    float e0[4], e1[4];
+    bc_fit_refined(block, 0, 3, 4, 0, refinements, e0, e1);
+    unsigned short color0 = bc_pack_565(e0);
+    unsigned short color1 = bc_pack_565(e1);
+    if (color0 < color1)
+    {
+        unsigned short swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    unsigned int indices = 0;
+    if (color0 != color1)
+    {
+        static const unsigned int order[4] = { 0, 2, 3, 1 };
+        float d0[4], d1[4];
+        int position[16];
+        bc_unpack_565(color0, d0);
+        bc_unpack_565(color1, d1);
+        bc_positions(block, 0, 3, d0, d1, 4, position);
+        for (int p = 0; p < 16; p++)
+            indices |= order[position[p]] << (2 * p);
+    }
+    memcpy(out, &color0, 2);
+    memcpy(out + 2, &color1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+// Eight value mode only (value0 > value1).
+void bc4_encode_block(const struct Bc_Block* block, int channel, int refinements, unsigned char* out)
+{
+    float e0[4], e1[4];
+    bc_fit_refined(block, channel, 1, 8, 0, refinements, e0, e1);
+    int value0 = (int)(e0[0] + 0.5f);
+    int value1 = (int)(e1[0] + 0.5f);
+    if (value0 < value1)
+    {
+        int swap = value0;
+        value0 = value1;
+        value1 = swap;
+    }
+
+    unsigned long long bits = (unsigned long long)value0 | ((unsigned long long)value1 << 8);
+    if (value0 != value1)
+    {
+        static const unsigned long long order[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+        float d0 = (float)value0, d1 = (float)value1;
+        int position[16];
+        bc_positions(block, channel, 1, &d0, &d1, 8, position);
+        for (int p = 0; p < 16; p++)
+            bits |= order[position[p]] << (16 + 3 * p);
+    }
+    memcpy(out, &bits, 8);
+}
+
+static const int Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+void bc7_put_bits(unsigned long long* bits, int* offset, unsigned int value, int count)
+{
+    for (int i = 0; i < count; i++, (*offset)++)
+        if ((value >> i) & 1)
+            bits[*offset >> 6] |= 1ull << (*offset & 63);
+}
+// 7 bit endpoint plus a shared low bit, keeps whichever low bit lands closer.
+void bc7_quantize_endpoint(const float* endpoint, int* quantized, int* p_bit)
+{
+    float best_error = FLT_MAX;
+    for (int p = 0; p < 2; p++)
+    {
+        int candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++)
+        {
+            candidate[c] = min(127, max(0, (int)((endpoint[c] - (float)p) / 2.0f + 0.5f)));
+            float d = (float)((candidate[c] << 1) | p) - endpoint[c];
+            error += d * d;
+        }
+        if (error < best_error)
+        {
+            best_error = error;
+            memcpy(quantized, candidate, sizeof(candidate));
+            *p_bit = p;
+        }
+    }
+}
+// Mode 6 only: one subset, RGBA endpoints and 4 bit indices.
+void bc7_encode_block(const struct Bc_Block* block, int refinements, unsigned char* out)
+{
+    float e0[4], e1[4];
+    bc_fit_refined(block, 0, 4, 16, Bc7Weights, refinements, e0, e1);
+    int q0[4], q1[4], p0, p1;
+    bc7_quantize_endpoint(e0, q0, &p0);
+    bc7_quantize_endpoint(e1, q1, &p1);
+
+    float d0[4], d1[4];
+    for (int c = 0; c < 4; c++)
+    {
+        d0[c] = (float)((q0[c] << 1) | p0);
+        d1[c] = (float)((q1[c] << 1) | p1);
+    }
+    int position[16];
+    bc_positions(block, 0, 4, d0, d1, 16, position);
+    if (position[0] >= 8)
+    {
+        // The first index has an implied top bit of 0, swapping the endpoints mirrors it down.
+        for (int c = 0; c < 4; c++)
+        {
+            int swap = q0[c];
+            q0[c] = q1[c];
+            q1[c] = swap;
+        }
+        int swap = p0;
+        p0 = p1;
+        p1 = swap;
+        for (int p = 0; p < 16; p++)
+            position[p] = 15 - position[p];
+    }
+
+    unsigned long long bits[2] = {0};
+    int offset = 0;
+    bc7_put_bits(bits, &offset, 1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        bc7_put_bits(bits, &offset, (unsigned int)q0[c], 7);
+        bc7_put_bits(bits, &offset, (unsigned int)q1[c], 7);
+    }
+    bc7_put_bits(bits, &offset, (unsigned int)p0, 1);
+    bc7_put_bits(bits, &offset, (unsigned int)p1, 1);
+    bc7_put_bits(bits, &offset, (unsigned int)position[0], 3);
+    for (int p = 1; p < 16; p++)
+        bc7_put_bits(bits, &offset, (unsigned int)position[p], 4);
+    memcpy(out, bits, 16);
+}
+
+size_t bc_block_size(enum FORMAT format)
+{
+    return (format == FORMAT_BC1_UNORM || format == FORMAT_BC4_UNORM) ? 8 : 16;
+}
+size_t bc_compressed_size(enum FORMAT format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * bc_block_size(format);
+}
+// BC4 for one channel, BC5 for two channels and normal maps (only x and y are kept, the shader rebuilds
+// z), and for color BC7 at the high preset, otherwise BC1, or BC3 when any pixel isn't opaque.
+enum FORMAT bc_choose_format(const unsigned char* pixels, size_t pixel_count, int component_count, enum TEXTURE_USAGE usage, enum BC_QUALITY quality)
+{
+    if (component_count == 1)
+        return FORMAT_BC4_UNORM;
+    if (component_count == 2 || usage == TEXTURE_USAGE_NORMAL)
+        return FORMAT_BC5_UNORM;
+    if (quality == BC_QUALITY_HIGH)
+        return FORMAT_BC7_UNORM;
+    for (size_t i = 0; i < pixel_count; i++)
+        if (pixels[i * 4 + 3] != 255)
+            return FORMAT_BC3_UNORM;
+    return FORMAT_BC1_UNORM;
+}
+
+struct Bc_Compress_Job
+{
+    const unsigned char* pixels;
+    int width;
+    int height;
+    int component_count;
+    enum FORMAT format;
+    int refinements;
+    unsigned char* out;
+};
+void bc_compress_row_task(void* user, size_t row)
+{
+    struct Bc_Compress_Job* job = user;
+    size_t block_size = bc_block_size(job->format);
+    int blocks_x = (job->width + 3) / 4;
+    unsigned char* out = job->out + row * (size_t)blocks_x * block_size;
+    for (int x = 0; x < blocks_x; x++, out += block_size)
+    {
+        struct Bc_Block block;
+        bc_load_block(job->pixels, job->width, job->height, job->component_count, x * 4, (int)row * 4, &block);
+        switch (job->format)
+        {
+            case FORMAT_BC1_UNORM:
+                bc1_encode_block(&block, job->refinements, out);
+                break;
+            case FORMAT_BC3_UNORM:
+                bc4_encode_block(&block, 3, job->refinements, out);
+                bc1_encode_block(&block, job->refinements, out + 8);
+                break;
+            case FORMAT_BC4_UNORM:
+                bc4_encode_block(&block, 0, job->refinements, out);
+                break;
+            case FORMAT_BC5_UNORM:
+                bc4_encode_block(&block, 0, job->refinements, out);
+                bc4_encode_block(&block, 1, job->refinements, out + 8);
+                break;
+            case FORMAT_BC7_UNORM:
+                bc7_encode_block(&block, job->refinements, out);
+                break;
+            default:
+                break;
+        }
+    }
+}
+// Blocks are written in row order, the layout of a DDS mip.
+void bc_compress(const unsigned char* pixels, int width, int height, int component_count, enum FORMAT format, enum BC_QUALITY quality, void* out, struct Thread_Pool* thread_pool)
+{
+    struct Bc_Compress_Job job = {
+        .pixels = pixels,
+        .width = width,
+        .height = height,
+        .component_count = component_count,
+        .format = format,
+        .refinements = BcRefinements[quality],
+        .out = out,
+    };
+    thread_pool_for(thread_pool, bc_compress_row_task, &job, (size_t)(height + 3) / 4);
+}
+// D3D12 wants a block compressed texture's top level in whole blocks, so images that are not get their
+// last column and row repeated out to the next multiple of 4, the same padding bc_load_block gives the
+// small mips. As with DDS files of such sizes, uv 0-1 then covers the padding too, up to 3 texels past
+// the image. Returns the padded pixels (to be freed) and grows the description to match.
+unsigned char* texture_pad_to_blocks(const unsigned char* pixels, int component_count, struct Buffer_Descriptor* description, size_t* size)
+{
+    int width = (int)description->width;
+    int height = (int)description->height;
+    int padded_width = (width + 3) & ~3;
+    int padded_height = (height + 3) & ~3;
+    size_t row_size = (size_t)width * (size_t)component_count;
+    size_t padded_row_size = (size_t)padded_width * (size_t)component_count;
+    *size = padded_row_size * (size_t)padded_height;
+    unsigned char* padded = malloc(*size);
+    for (int y = 0; y < padded_height; y++)
+    {
+        unsigned char* row = padded + (size_t)y * padded_row_size;
+        memcpy(row, pixels + (size_t)min(y, height - 1) * row_size, row_size);
+        for (size_t x = row_size; x < padded_row_size; x += (size_t)component_count)
+            memcpy(row + x, row + row_size - (size_t)component_count, (size_t)component_count);
+    }
+    description->width = (unsigned long long)padded_width;
+    description->height = (unsigned long long)padded_height;
+    return padded;
+}
+// Block compresses decoded PNG pixels on load, every mip of the chain in turn. Returns the blocks (to be
+// freed) and switches the description to their format, or 0 when the pixels should go up as they are.
+// The top level has to be whole blocks already, see texture_pad_to_blocks.
+void* texture_compress(const unsigned char* pixels, int component_count, enum TEXTURE_USAGE usage, struct Buffer_Descriptor* description, size_t* size, struct Thread_Pool* thread_pool)
+{
+    if (!UseTextureCompression || description->width % 4 != 0 || description->height % 4 != 0)
+        return 0;
+
+    int width = (int)description->width;
+    int height = (int)description->height;
+    unsigned int mip_count = max(1u, description->mip_count);
+    enum FORMAT format = bc_choose_format(pixels, (size_t)width * (size_t)height, component_count, usage, TextureCompressionQuality);
+    *size = 0;
+    for (unsigned int mip = 0; mip < mip_count; mip++)
+        *size += bc_compressed_size(format, max(1, width >> mip), max(1, height >> mip));
+
+    unsigned char* blocks = malloc(*size);
+    unsigned char* out = blocks;
+    for (unsigned int mip = 0; mip < mip_count; mip++)
+    {
+        int mip_width = max(1, width >> mip);
+        int mip_height = max(1, height >> mip);
+        bc_compress(pixels, mip_width, mip_height, component_count, format, TextureCompressionQuality, out, thread_pool);
+        pixels += (size_t)mip_width * (size_t)mip_height * (size_t)component_count;
+        out += bc_compressed_size(format, mip_width, mip_height);
+    }
+    description->format = format;
+    return blocks;
+}
+
+// Mip chains for decoded PNGs, a 2x2 box filter from each level to the next. Color is averaged in linear
+// space and converted back to sRGB, normals are averaged as vectors and renormalized, anything else
+// (single and two channel maps, alpha) is averaged as is. Each level's rows run across the thread pool.
+static int UseMipGeneration = 1;
+struct Mip_Job
+{
+    const unsigned char* source;
+    unsigned char* destination;
+    int source_width;
+    int source_height;
+    int width;
+    int component_count;
+    enum TEXTURE_USAGE usage;
+    float srgb_to_linear[256];
+};
+// sRGB curve through square roots, within half a step of 8 bit output.
+__m128 mip_linear_to_srgb(__m128 linear)
+{
+    linear = _mm_min_ps(_mm_max_ps(linear, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    __m128 s1 = _mm_sqrt_ps(linear);
+    __m128 s2 = _mm_sqrt_ps(s1);
+    __m128 s3 = _mm_sqrt_ps(s2);
+    __m128 curve = _mm_mul_ps(s1, _mm_set1_ps(0.662002687f));
+    curve = _mm_add_ps(curve, _mm_mul_ps(s2, _mm_set1_ps(0.684122060f)));
+    curve = _mm_sub_ps(curve, _mm_mul_ps(s3, _mm_set1_ps(0.323583601f)));
+    curve = _mm_sub_ps(curve, _mm_mul_ps(linear, _mm_set1_ps(0.0225411470f)));
+    __m128 toe = _mm_mul_ps(linear, _mm_set1_ps(12.92f));
+    __m128 is_toe = _mm_cmplt_ps(linear, _mm_set1_ps(0.0031308f));
+    return _mm_or_ps(_mm_and_ps(is_toe, toe), _mm_andnot_ps(is_toe, curve));
+}
+void mip_store_pixel(__m128 value, unsigned char* destination)
+{
+    // value is 0-1, rounded to bytes and packed down to the four channels.
+    __m128i integer = _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(255.0f)));
+    integer = _mm_packs_epi32(integer, integer);
+    integer = _mm_packus_epi16(integer, integer);
+    int packed = _mm_cvtsi128_si32(integer);
+    memcpy(destination, &packed, 4);
+}
+void mip_row_task(void* user, size_t row)
+{
+    struct Mip_Job* job = user;
+    int component_count = job->component_count;
+    size_t source_pitch = (size_t)job->source_width * (size_t)component_count;
+    // Odd sizes drop the last row or column, 1 pixel wide levels reuse it.
+    const unsigned char* rows[2] = {
+        job->source + (size_t)min((int)row * 2, job->source_height - 1) * source_pitch,
+        job->source + (size_t)min((int)row * 2 + 1, job->source_height - 1) * source_pitch,
+    };
+    unsigned char* destination = job->destination + row * (size_t)job->width * (size_t)component_count;
+    __m128 quarter = _mm_set1_ps(0.25f);
+    __m128 inverse_255 = _mm_set1_ps(1.0f / 255.0f);
+    __m128 alpha_mask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+    for (int x = 0; x < job->width; x++, destination += component_count)
+    {
+        size_t columns[2] = {
+            (size_t)min(x * 2, job->source_width - 1) * (size_t)component_count,
+            (size_t)min(x * 2 + 1, job->source_width - 1) * (size_t)component_count,
+        };
+        if (component_count != 4)
+        {
+            for (int c = 0; c < component_count; c++)
+            {
+                int sum = rows[0][columns[0] + c] + rows[0][columns[1] + c] + rows[1][columns[0] + c] + rows[1][columns[1] + c];
+                destination[c] = (unsigned char)((sum + 2) / 4);
+            }
+            continue;
+        }
+
+        __m128 sum = _mm_setzero_ps();
+        __m128 alpha = _mm_setzero_ps();
+        for (int i = 0; i < 4; i++)
+        {
+            const unsigned char* p = rows[i >> 1] + columns[i & 1];
+            if (job->usage == TEXTURE_USAGE_NORMAL)
+            {
+                __m128 pixel = _mm_set_ps(p[3], p[2], p[1], p[0]);
+                sum = _mm_add_ps(sum, _mm_sub_ps(_mm_mul_ps(pixel, _mm_set1_ps(2.0f / 255.0f)), _mm_set1_ps(1.0f)));
+            }
+            else
+                sum = _mm_add_ps(sum, _mm_set_ps(0.0f, job->srgb_to_linear[p[2]], job->srgb_to_linear[p[1]], job->srgb_to_linear[p[0]]));
+            alpha = _mm_add_ps(alpha, _mm_set1_ps(p[3]));
+        }
+        alpha = _mm_mul_ps(_mm_mul_ps(alpha, quarter), inverse_255);
+
+        __m128 result;
+        if (job->usage == TEXTURE_USAGE_NORMAL)
+        {
+            __m128 xyz = _mm_andnot_ps(alpha_mask, sum);
+            __m128 length = _mm_mul_ps(xyz, xyz);
+            length = _mm_add_ps(length, _mm_shuffle_ps(length, length, _MM_SHUFFLE(2, 3, 0, 1)));
+            length = _mm_add_ps(length, _mm_shuffle_ps(length, length, _MM_SHUFFLE(1, 0, 3, 2)));
+            // Opposing normals can cancel out, flat up is the safest guess then.
+            if (_mm_cvtss_f32(length) < 1e-12f)
+                xyz = _mm_set_ps(0.0f, 1.0f, 0.0f, 0.0f);
+            else
+                xyz = _mm_div_ps(xyz, _mm_sqrt_ps(length));
+            result = _mm_add_ps(_mm_mul_ps(xyz, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f));
+        }
+        else
+            result = mip_linear_to_srgb(_mm_mul_ps(sum, quarter));
+        result = _mm_or_ps(_mm_andnot_ps(alpha_mask, result), _mm_and_ps(alpha_mask, alpha));
+        mip_store_pixel(result, destination);
+    }
+}
+unsigned int mip_count_for(unsigned long long width, unsigned long long height)
+{
+    unsigned int mip_count = 1;
+    while ((max(width, height) >> mip_count) > 0)
+        mip_count++;
+    return mip_count;
+}
+// Returns level 0 followed by every smaller level down to 1x1 (to be freed), packed like the mips of a DDS,
+// and sets the description's mip count and size. Returns 0 when mips are turned off.
+unsigned char* texture_generate_mips(const unsigned char* pixels, int component_count, enum TEXTURE_USAGE usage, struct Buffer_Descriptor* description, size_t* size, struct Thread_Pool* thread_pool)
+{
+    if (!UseMipGeneration)
+        return 0;
+
+    int width = (int)description->width;
+    int height = (int)description->height;
+    unsigned int mip_count = mip_count_for(description->width, description->height);
+    *size = 0;
+    for (unsigned int mip = 0; mip < mip_count; mip++)
+        *size += (size_t)max(1, width >> mip) * (size_t)max(1, height >> mip) * (size_t)component_count;
+
+    unsigned char* chain = malloc(*size);
+    memcpy(chain, pixels, (size_t)width * (size_t)height * (size_t)component_count);
+
+    struct Mip_Job job = {
+        .component_count = component_count,
+        .usage = usage,
+    };
+    for (int i = 0; i < 256; i++)
+    {
+        float c = (float)i / 255.0f;
+        job.srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    unsigned char* source = chain;
+    for (unsigned int mip = 1; mip < mip_count; mip++)
+    {
+        job.source = source;
+        job.source_width = max(1, width >> (mip - 1));
+        job.source_height = max(1, height >> (mip - 1));
+        job.destination = source + (size_t)job.source_width * (size_t)job.source_height * (size_t)component_count;
+        job.width = max(1, width >> mip);
+        thread_pool_for(thread_pool, mip_row_task, &job, (size_t)max(1, height >> mip));
+        source = job.destination;
+    }
+
+    description->mip_count = mip_count;
+    return chain;
+}
+
+// What a DDS file describes, image points into the file data right after the headers.
+struct Dds_Image
+{
+    struct Buffer_Descriptor description;
+    unsigned int array_size;
+    const uint8_t* image;
+    size_t image_size; // Every mip of every array element, in file order.
+    int has_alpha; // Any texel of the top level below full alpha, see dds_map.
+};
+enum DXGI_FORMAT
+{
+    DXGI_FORMAT_UNKNOWN = 0,
+    DXGI_FORMAT_R32G32B32A32_TYPELESS = 1,
+    DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+    DXGI_FORMAT_R32G32B32A32_UINT = 3,
+    DXGI_FORMAT_R32G32B32A32_SINT = 4,
+    DXGI_FORMAT_R32G32B32_TYPELESS = 5,
+    DXGI_FORMAT_R32G32B32_FLOAT = 6,
+    DXGI_FORMAT_R32G32B32_UINT = 7,
+    DXGI_FORMAT_R32G32B32_SINT = 8,
+    DXGI_FORMAT_R16G16B16A16_TYPELESS = 9,
+    DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+    DXGI_FORMAT_R16G16B16A16_UNORM = 11,
+    DXGI_FORMAT_R16G16B16A16_UINT = 12,
+    DXGI_FORMAT_R16G16B16A16_SNORM = 13,
+    DXGI_FORMAT_R16G16B16A16_SINT = 14,
+    DXGI_FORMAT_R32G32_TYPELESS = 15,
+    DXGI_FORMAT_R32G32_FLOAT = 16,
+    DXGI_FORMAT_R32G32_UINT = 17,
+    DXGI_FORMAT_R32G32_SINT = 18,
+    DXGI_FORMAT_R32G8X24_TYPELESS = 19,
+    DXGI_FORMAT_D32_FLOAT_S8X24_UINT = 20,
+    DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS = 21,
+    DXGI_FORMAT_X32_TYPELESS_G8X24_UINT = 22,
+    DXGI_FORMAT_R10G10B10A2_TYPELESS = 23,
+    DXGI_FORMAT_R10G10B10A2_UNORM = 24,
+    DXGI_FORMAT_R10G10B10A2_UINT = 25,
+    DXGI_FORMAT_R11G11B10_FLOAT = 26,
+    DXGI_FORMAT_R8G8B8A8_TYPELESS = 27,
+    DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+    DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+    DXGI_FORMAT_R8G8B8A8_UINT = 30,
+    DXGI_FORMAT_R8G8B8A8_SNORM = 31,
+    DXGI_FORMAT_R8G8B8A8_SINT = 32,
+    DXGI_FORMAT_R16G16_TYPELESS = 33,
+    DXGI_FORMAT_R16G16_FLOAT = 34,
+    DXGI_FORMAT_R16G16_UNORM = 35,
+    DXGI_FORMAT_R16G16_UINT = 36,
+    DXGI_FORMAT_R16G16_SNORM = 37,
+    DXGI_FORMAT_R16G16_SINT = 38,
+    DXGI_FORMAT_R32_TYPELESS = 39,
+    DXGI_FORMAT_D32_FLOAT = 40,
+    DXGI_FORMAT_R32_FLOAT = 41,
+    DXGI_FORMAT_R32_UINT = 42,
+    DXGI_FORMAT_R32_SINT = 43,
+    DXGI_FORMAT_R24G8_TYPELESS = 44,
+    DXGI_FORMAT_D24_UNORM_S8_UINT = 45,
+    DXGI_FORMAT_R24_UNORM_X8_TYPELESS = 46,
+    DXGI_FORMAT_X24_TYPELESS_G8_UINT = 47,
+    DXGI_FORMAT_R8G8_TYPELESS = 48,
+    DXGI_FORMAT_R8G8_UNORM = 49,
+    DXGI_FORMAT_R8G8_UINT = 50,
+    DXGI_FORMAT_R8G8_SNORM = 51,
+    DXGI_FORMAT_R8G8_SINT = 52,
+    DXGI_FORMAT_R16_TYPELESS = 53,
+    DXGI_FORMAT_R16_FLOAT = 54,
+    DXGI_FORMAT_D16_UNORM = 55,
+    DXGI_FORMAT_R16_UNORM = 56,
+    DXGI_FORMAT_R16_UINT = 57,
+    DXGI_FORMAT_R16_SNORM = 58,
+    DXGI_FORMAT_R16_SINT = 59,
+    DXGI_FORMAT_R8_TYPELESS = 60,
+    DXGI_FORMAT_R8_UNORM = 61,
+    DXGI_FORMAT_R8_UINT = 62,
+    DXGI_FORMAT_R8_SNORM = 63,
+    DXGI_FORMAT_R8_SINT = 64,
+    DXGI_FORMAT_A8_UNORM = 65,
+    DXGI_FORMAT_R1_UNORM = 66,
+    DXGI_FORMAT_R9G9B9E5_SHAREDEXP = 67,
+    DXGI_FORMAT_R8G8_B8G8_UNORM = 68,
+    DXGI_FORMAT_G8R8_G8B8_UNORM = 69,
+    DXGI_FORMAT_BC1_TYPELESS = 70,
+    DXGI_FORMAT_BC1_UNORM = 71,
+    DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+    DXGI_FORMAT_BC2_TYPELESS = 73,
+    DXGI_FORMAT_BC2_UNORM = 74,
+    DXGI_FORMAT_BC2_UNORM_SRGB = 75,
+    DXGI_FORMAT_BC3_TYPELESS = 76,
+    DXGI_FORMAT_BC3_UNORM = 77,
+    DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+    DXGI_FORMAT_BC4_TYPELESS = 79,
+    DXGI_FORMAT_BC4_UNORM = 80,
+    DXGI_FORMAT_BC4_SNORM = 81,
+    DXGI_FORMAT_BC5_TYPELESS = 82,
+    DXGI_FORMAT_BC5_UNORM = 83,
+    DXGI_FORMAT_BC5_SNORM = 84,
+    DXGI_FORMAT_B5G6R5_UNORM = 85,
+    DXGI_FORMAT_B5G5R5A1_UNORM = 86,
+    DXGI_FORMAT_B8G8R8A8_UNORM = 87,
+    DXGI_FORMAT_B8G8R8X8_UNORM = 88,
+    DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM = 89,
+    DXGI_FORMAT_B8G8R8A8_TYPELESS = 90,
+    DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
+    DXGI_FORMAT_B8G8R8X8_TYPELESS = 92,
+    DXGI_FORMAT_B8G8R8X8_UNORM_SRGB = 93,
+    DXGI_FORMAT_BC6H_TYPELESS = 94,
+    DXGI_FORMAT_BC6H_UF16 = 95,
+    DXGI_FORMAT_BC6H_SF16 = 96,
+    DXGI_FORMAT_BC7_TYPELESS = 97,
+    DXGI_FORMAT_BC7_UNORM = 98,
+    DXGI_FORMAT_BC7_UNORM_SRGB = 99,
+    DXGI_FORMAT_AYUV = 100,
+    DXGI_FORMAT_Y410 = 101,
+    DXGI_FORMAT_Y416 = 102,
+    DXGI_FORMAT_NV12 = 103,
+    DXGI_FORMAT_P010 = 104,
+    DXGI_FORMAT_P016 = 105,
+    DXGI_FORMAT_420_OPAQUE = 106,
+    DXGI_FORMAT_YUY2 = 107,
+    DXGI_FORMAT_Y210 = 108,
+    DXGI_FORMAT_Y216 = 109,
+    DXGI_FORMAT_NV11 = 110,
+    DXGI_FORMAT_AI44 = 111,
+    DXGI_FORMAT_IA44 = 112,
+    DXGI_FORMAT_P8 = 113,
+    DXGI_FORMAT_A8P8 = 114,
+    DXGI_FORMAT_B4G4R4A4_UNORM = 115,
+    DXGI_FORMAT_P208 = 130,
+    DXGI_FORMAT_V208 = 131,
+    DXGI_FORMAT_V408 = 132,
+    DXGI_FORMAT_SAMPLER_FEEDBACK_MIN_MIP_OPAQUE = 189,
+    DXGI_FORMAT_SAMPLER_FEEDBACK_MIP_REGION_USED_OPAQUE = 190,
+    DXGI_FORMAT_FORCE_UINT = 0xffffffff
+};
+enum D3D10_RESOURCE_DIMENSION
+{
+    D3D10_RESOURCE_DIMENSION_UNKNOWN = 0,
+    D3D10_RESOURCE_DIMENSION_BUFFER = 1,
+    D3D10_RESOURCE_DIMENSION_TEXTURE1D = 2,
+    D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3,
+    D3D10_RESOURCE_DIMENSION_TEXTURE3D = 4
+};
+struct DDS_HEADER_DXT10
+{
+    enum DXGI_FORMAT                dxgiFormat;
+    enum D3D10_RESOURCE_DIMENSION   resourceDimension;
+    UINT                            miscFlag;
+    UINT                            arraySize;
+    UINT                            miscFlags2;
+};
+struct DDS_PIXELFORMAT
+{
+    DWORD dwSize;
+    DWORD dwFlags;
+    DWORD dwFourCC;
+    DWORD dwRGBBitCount;
+    DWORD dwRBitMask;
+    DWORD dwGBitMask;
+    DWORD dwBBitMask;
+    DWORD dwABitMask;
+};
+struct DDS_HEADER
+{
+    DWORD                   dwSize;
+    DWORD                   dwFlags;
+    DWORD                   dwHeight;
+    DWORD                   dwWidth;
+    DWORD                   dwPitchOrLinearSize;
+    DWORD                   dwDepth;
+    DWORD                   dwMipMapCount;
+    DWORD                   dwReserved1[11];
+    struct DDS_PIXELFORMAT  ddspf;
+    DWORD                   dwCaps;
+    DWORD                   dwCaps2;
+    DWORD                   dwCaps3;
+    DWORD                   dwCaps4;
+    DWORD                   dwReserved2;
+};
+enum DDPF_FLAGS 
 {
-    FILE* file = fopen(texture->path, "rb");
-    if (!file)
-        __debugbreak();
-
-    fseek(file, 0L, SEEK_END);
-    size_t file_size = ftell(file);
-    fseek(file, 0L, SEEK_SET);
-
-    char* buffer = malloc(file_size);
-    fread(buffer, 1, file_size, file);
-    fclose(file);
-
-    printf("buffersize: %zd\n", file_size);
-
-    enum DXGI_FORMAT
-    {
-        DXGI_FORMAT_UNKNOWN = 0,
-        DXGI_FORMAT_R32G32B32A32_TYPELESS = 1,
-        DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
-        DXGI_FORMAT_R32G32B32A32_UINT = 3,
-        DXGI_FORMAT_R32G32B32A32_SINT = 4,
-        DXGI_FORMAT_R32G32B32_TYPELESS = 5,
-        DXGI_FORMAT_R32G32B32_FLOAT = 6,
-        DXGI_FORMAT_R32G32B32_UINT = 7,
-        DXGI_FORMAT_R32G32B32_SINT = 8,
-        DXGI_FORMAT_R16G16B16A16_TYPELESS = 9,
-        DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
-        DXGI_FORMAT_R16G16B16A16_UNORM = 11,
-        DXGI_FORMAT_R16G16B16A16_UINT = 12,
-        DXGI_FORMAT_R16G16B16A16_SNORM = 13,
-        DXGI_FORMAT_R16G16B16A16_SINT = 14,
-        DXGI_FORMAT_R32G32_TYPELESS = 15,
-        DXGI_FORMAT_R32G32_FLOAT = 16,
-        DXGI_FORMAT_R32G32_UINT = 17,
-        DXGI_FORMAT_R32G32_SINT = 18,
-        DXGI_FORMAT_R32G8X24_TYPELESS = 19,
-        DXGI_FORMAT_D32_FLOAT_S8X24_UINT = 20,
-        DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS = 21,
-        DXGI_FORMAT_X32_TYPELESS_G8X24_UINT = 22,
-        DXGI_FORMAT_R10G10B10A2_TYPELESS = 23,
-        DXGI_FORMAT_R10G10B10A2_UNORM = 24,
-        DXGI_FORMAT_R10G10B10A2_UINT = 25,
-        DXGI_FORMAT_R11G11B10_FLOAT = 26,
-        DXGI_FORMAT_R8G8B8A8_TYPELESS = 27,
-        DXGI_FORMAT_R8G8B8A8_UNORM = 28,
-        DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
-        DXGI_FORMAT_R8G8B8A8_UINT = 30,
-        DXGI_FORMAT_R8G8B8A8_SNORM = 31,
-        DXGI_FORMAT_R8G8B8A8_SINT = 32,
-        DXGI_FORMAT_R16G16_TYPELESS = 33,
-        DXGI_FORMAT_R16G16_FLOAT = 34,
-        DXGI_FORMAT_R16G16_UNORM = 35,
-        DXGI_FORMAT_R16G16_UINT = 36,
-        DXGI_FORMAT_R16G16_SNORM = 37,
-        DXGI_FORMAT_R16G16_SINT = 38,
-        DXGI_FORMAT_R32_TYPELESS = 39,
-        DXGI_FORMAT_D32_FLOAT = 40,
-        DXGI_FORMAT_R32_FLOAT = 41,
-        DXGI_FORMAT_R32_UINT = 42,
-        DXGI_FORMAT_R32_SINT = 43,
-        DXGI_FORMAT_R24G8_TYPELESS = 44,
-        DXGI_FORMAT_D24_UNORM_S8_UINT = 45,
-        DXGI_FORMAT_R24_UNORM_X8_TYPELESS = 46,
-        DXGI_FORMAT_X24_TYPELESS_G8_UINT = 47,
-        DXGI_FORMAT_R8G8_TYPELESS = 48,
-        DXGI_FORMAT_R8G8_UNORM = 49,
-        DXGI_FORMAT_R8G8_UINT = 50,
-        DXGI_FORMAT_R8G8_SNORM = 51,
-        DXGI_FORMAT_R8G8_SINT = 52,
-        DXGI_FORMAT_R16_TYPELESS = 53,
-        DXGI_FORMAT_R16_FLOAT = 54,
-        DXGI_FORMAT_D16_UNORM = 55,
-        DXGI_FORMAT_R16_UNORM = 56,
-        DXGI_FORMAT_R16_UINT = 57,
-        DXGI_FORMAT_R16_SNORM = 58,
-        DXGI_FORMAT_R16_SINT = 59,
-        DXGI_FORMAT_R8_TYPELESS = 60,
-        DXGI_FORMAT_R8_UNORM = 61,
-        DXGI_FORMAT_R8_UINT = 62,
-        DXGI_FORMAT_R8_SNORM = 63,
-        DXGI_FORMAT_R8_SINT = 64,
-        DXGI_FORMAT_A8_UNORM = 65,
-        DXGI_FORMAT_R1_UNORM = 66,
-        DXGI_FORMAT_R9G9B9E5_SHAREDEXP = 67,
-        DXGI_FORMAT_R8G8_B8G8_UNORM = 68,
-        DXGI_FORMAT_G8R8_G8B8_UNORM = 69,
-        DXGI_FORMAT_BC1_TYPELESS = 70,
-        DXGI_FORMAT_BC1_UNORM = 71,
-        DXGI_FORMAT_BC1_UNORM_SRGB = 72,
-        DXGI_FORMAT_BC2_TYPELESS = 73,
-        DXGI_FORMAT_BC2_UNORM = 74,
-        DXGI_FORMAT_BC2_UNORM_SRGB = 75,
-        DXGI_FORMAT_BC3_TYPELESS = 76,
-        DXGI_FORMAT_BC3_UNORM = 77,
-        DXGI_FORMAT_BC3_UNORM_SRGB = 78,
-        DXGI_FORMAT_BC4_TYPELESS = 79,
-        DXGI_FORMAT_BC4_UNORM = 80,
-        DXGI_FORMAT_BC4_SNORM = 81,
-        DXGI_FORMAT_BC5_TYPELESS = 82,
-        DXGI_FORMAT_BC5_UNORM = 83,
-        DXGI_FORMAT_BC5_SNORM = 84,
-        DXGI_FORMAT_B5G6R5_UNORM = 85,
-        DXGI_FORMAT_B5G5R5A1_UNORM = 86,
-        DXGI_FORMAT_B8G8R8A8_UNORM = 87,
-        DXGI_FORMAT_B8G8R8X8_UNORM = 88,
-        DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM = 89,
-        DXGI_FORMAT_B8G8R8A8_TYPELESS = 90,
-        DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
-        DXGI_FORMAT_B8G8R8X8_TYPELESS = 92,
-        DXGI_FORMAT_B8G8R8X8_UNORM_SRGB = 93,
-        DXGI_FORMAT_BC6H_TYPELESS = 94,
-        DXGI_FORMAT_BC6H_UF16 = 95,
-        DXGI_FORMAT_BC6H_SF16 = 96,
-        DXGI_FORMAT_BC7_TYPELESS = 97,
-        DXGI_FORMAT_BC7_UNORM = 98,
-        DXGI_FORMAT_BC7_UNORM_SRGB = 99,
-        DXGI_FORMAT_AYUV = 100,
-        DXGI_FORMAT_Y410 = 101,
-        DXGI_FORMAT_Y416 = 102,
-        DXGI_FORMAT_NV12 = 103,
-        DXGI_FORMAT_P010 = 104,
-        DXGI_FORMAT_P016 = 105,
-        DXGI_FORMAT_420_OPAQUE = 106,
-        DXGI_FORMAT_YUY2 = 107,
-        DXGI_FORMAT_Y210 = 108,
-        DXGI_FORMAT_Y216 = 109,
-        DXGI_FORMAT_NV11 = 110,
-        DXGI_FORMAT_AI44 = 111,
-        DXGI_FORMAT_IA44 = 112,
-        DXGI_FORMAT_P8 = 113,
-        DXGI_FORMAT_A8P8 = 114,
-        DXGI_FORMAT_B4G4R4A4_UNORM = 115,
-        DXGI_FORMAT_P208 = 130,
-        DXGI_FORMAT_V208 = 131,
-        DXGI_FORMAT_V408 = 132,
-        DXGI_FORMAT_SAMPLER_FEEDBACK_MIN_MIP_OPAQUE = 189,
-        DXGI_FORMAT_SAMPLER_FEEDBACK_MIP_REGION_USED_OPAQUE = 190,
-        DXGI_FORMAT_FORCE_UINT = 0xffffffff
-    };
-    enum D3D10_RESOURCE_DIMENSION
-    {
-        D3D10_RESOURCE_DIMENSION_UNKNOWN = 0,
-        D3D10_RESOURCE_DIMENSION_BUFFER = 1,
-        D3D10_RESOURCE_DIMENSION_TEXTURE1D = 2,
-        D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3,
-        D3D10_RESOURCE_DIMENSION_TEXTURE3D = 4
-    };
-    struct DDS_HEADER_DXT10
+    DDPF_ALPHAPIXELS =  0x1,
+    DDPF_ALPHA =        0x2,
+    DDPF_FOURCC =       0x4,
+    DDPF_RGB =          0x40,
+    DDPF_YUV =          0x200,
+    DDPF_LUMINANCE =    0x20000,
+};
+enum DDSD_FLAGS
+{
+    DDSD_CAPS =        0x1,
+    DDSD_HEIGHT =      0x2,
+    DDSD_WIDTH =       0x4,
+    DDSD_PITCH =       0x8,
+    DDSD_PIXELFORMAT = 0x1000,
+    DDSD_MIPMAPCOUNT = 0x20000,
+    DDSD_LINEARSIZE =  0x80000,
+    DDSD_DEPTH =       0x800000,
+};
+enum DDS
+{
+    DDS_FOURCC = 0x00000004,  // DDPF_FOURCC
+    DDS_RGB = 0x00000040,  // DDPF_RGB
+    DDS_RGBA = 0x00000041,  // DDPF_RGB | DDPF_ALPHAPIXELS
+    DDS_LUMINANCE = 0x00020000,  // DDPF_LUMINANCE
+    DDS_LUMINANCEA = 0x00020001,  // DDPF_LUMINANCE | DDPF_ALPHAPIXELS
+    DDS_ALPHAPIXELS = 0x00000001,  // DDPF_ALPHAPIXELS
+    DDS_ALPHA = 0x00000002,  // DDPF_ALPHA
+    DDS_PAL8 = 0x00000020,  // DDPF_PALETTEINDEXED8
+    DDS_PAL8A = 0x00000021,  // DDPF_PALETTEINDEXED8 | DDPF_ALPHAPIXELS
+    DDS_BUMPLUMINANCE = 0x00040000,  // DDPF_BUMPLUMINANCE
+    DDS_BUMPDUDV = 0x00080000,  // DDPF_BUMPDUDV
+    DDS_BUMPDUDVA = 0x00080001  // DDPF_BUMPDUDV | DDPF_ALPHAPIXELS
+};
+enum DDS_ALPHA_MODE // The low bits of DDS_HEADER_DXT10::miscFlags2.
+{
+    DDS_ALPHA_MODE_UNKNOWN = 0,
+    DDS_ALPHA_MODE_STRAIGHT = 1,
+    DDS_ALPHA_MODE_PREMULTIPLIED = 2,
+    DDS_ALPHA_MODE_OPAQUE = 3,
+    DDS_ALPHA_MODE_CUSTOM = 4,
+};
+int format_is_block_compressed(enum FORMAT format)
+{
+    switch (format)
     {
-        enum DXGI_FORMAT                dxgiFormat;
-        enum D3D10_RESOURCE_DIMENSION   resourceDimension;
-        UINT                            miscFlag;
-        UINT                            arraySize;
-        UINT                            miscFlags2;
-    };
-    struct DDS_PIXELFORMAT
-    {
-        DWORD dwSize;
-        DWORD dwFlags;
-        DWORD dwFourCC;
-        DWORD dwRGBBitCount;
-        DWORD dwRBitMask;
-        DWORD dwGBitMask;
-        DWORD dwBBitMask;
-        DWORD dwABitMask;
-    };
-    struct DDS_HEADER
-    {
-        DWORD                   dwSize;
-        DWORD                   dwFlags;
-        DWORD                   dwHeight;
-        DWORD                   dwWidth;
-        DWORD                   dwPitchOrLinearSize;
-        DWORD                   dwDepth;
-        DWORD                   dwMipMapCount;
-        DWORD                   dwReserved1[11];
-        struct DDS_PIXELFORMAT  ddspf;
-        DWORD                   dwCaps;
-        DWORD                   dwCaps2;
-        DWORD                   dwCaps3;
-        DWORD                   dwCaps4;
-        DWORD                   dwReserved2;
-    };
-    enum DDPF_FLAGS 
-    {
-        DDPF_ALPHAPIXELS =  0x1,
-        DDPF_ALPHA =        0x2,
-        DDPF_FOURCC =       0x4,
-        DDPF_RGB =          0x40,
-        DDPF_YUV =          0x200,
-        DDPF_LUMINANCE =    0x20000,
-    };
-    enum DDSD_FLAGS
-    {
-        DDSD_CAPS =        0x1,
-        DDSD_HEIGHT =      0x2,
-        DDSD_WIDTH =       0x4,
-        DDSD_PITCH =       0x8,
-        DDSD_PIXELFORMAT = 0x1000,
-        DDSD_MIPMAPCOUNT = 0x20000,
-        DDSD_LINEARSIZE =  0x80000,
-        DDSD_DEPTH =       0x800000,
-    };
-    enum DDS
-    {
-        DDS_FOURCC = 0x00000004,  // DDPF_FOURCC
-        DDS_RGB = 0x00000040,  // DDPF_RGB
-        DDS_RGBA = 0x00000041,  // DDPF_RGB | DDPF_ALPHAPIXELS
-        DDS_LUMINANCE = 0x00020000,  // DDPF_LUMINANCE
-        DDS_LUMINANCEA = 0x00020001,  // DDPF_LUMINANCE | DDPF_ALPHAPIXELS
-        DDS_ALPHAPIXELS = 0x00000001,  // DDPF_ALPHAPIXELS
-        DDS_ALPHA = 0x00000002,  // DDPF_ALPHA
-        DDS_PAL8 = 0x00000020,  // DDPF_PALETTEINDEXED8
-        DDS_PAL8A = 0x00000021,  // DDPF_PALETTEINDEXED8 | DDPF_ALPHAPIXELS
-        DDS_BUMPLUMINANCE = 0x00040000,  // DDPF_BUMPLUMINANCE
-        DDS_BUMPDUDV = 0x00080000,  // DDPF_BUMPDUDV
-        DDS_BUMPDUDVA = 0x00080001  // DDPF_BUMPDUDV | DDPF_ALPHAPIXELS
-    };
-
+        case FORMAT_BC1_TYPELESS: case FORMAT_BC1_UNORM: case FORMAT_BC1_UNORM_SRGB:
+        case FORMAT_BC2_TYPELESS: case FORMAT_BC2_UNORM: case FORMAT_BC2_UNORM_SRGB:
+        case FORMAT_BC3_TYPELESS: case FORMAT_BC3_UNORM: case FORMAT_BC3_UNORM_SRGB:
+        case FORMAT_BC4_TYPELESS: case FORMAT_BC4_UNORM: case FORMAT_BC4_SNORM:
+        case FORMAT_BC5_TYPELESS: case FORMAT_BC5_UNORM: case FORMAT_BC5_SNORM:
+        case FORMAT_BC6H_TYPELESS: case FORMAT_BC6H_UF16: case FORMAT_BC6H_SF16:
+        case FORMAT_BC7_TYPELESS: case FORMAT_BC7_UNORM: case FORMAT_BC7_UNORM_SRGB:
+            return 1;
+        default:
+            return 0;
+    }
+}
+void dds_parse(char* buffer, struct Dds_Image* dds)
+{
     DWORD* dwMagic = (DWORD*)buffer; dwMagic;
     buffer += sizeof(DWORD);
     if (!memcmp(dwMagic, "DDS ", 4) && false)
@@ -949,80 +5520,948 @@ void load_texture_dds(struct Texture *texture, struct Device *device, struct Des
     unsigned int mip_count = (header->dwFlags & DDSD_MIPMAPCOUNT) ? header->dwMipMapCount : 1;
 
     struct Buffer_Descriptor buffer_desc = {0};
-    buffer_desc.width = (unsigned long long)(((header->dwWidth) + (4) - 1) & ~((4) - 1));
-    buffer_desc.height = (unsigned long long)(((header->dwHeight) + (4) - 1) & ~((4) - 1));
+    // Block compressed textures are padded out to whole blocks.
+    int block_compressed = format_is_block_compressed(texture_format);
+    buffer_desc.width = block_compressed ? (unsigned long long)(((header->dwWidth) + (4) - 1) & ~((4) - 1)) : header->dwWidth;
+    buffer_desc.height = block_compressed ? (unsigned long long)(((header->dwHeight) + (4) - 1) & ~((4) - 1)) : header->dwHeight;
     buffer_desc.mip_count = mip_count;
     buffer_desc.format = texture_format;
     buffer_desc.buffer_type = BUFFER_TYPE_TEXTRUE2D;
     buffer_desc.bind_types[0] = BIND_TYPE_SRV;
     buffer_desc.bind_types_count = 1;
-    device_create_buffer(device, buffer_desc, &texture->buffer);
+
+    size_t image_size = 0;
+    for (unsigned int array_element = 0; array_element < texture_array_size; array_element++)
+    {
+        for (unsigned int mip = 0; mip < mip_count; ++mip)
+        {
+            int mip_width = max(1, header->dwWidth >> mip);
+            int mip_height = max(1, header->dwHeight >> mip);
+            image_size += format_compute_mip_size(texture_format, mip_width, mip_height);
+        }
+    }
+
+    dds->description = buffer_desc;
+    dds->array_size = texture_array_size;
+    dds->image = image_data;
+    dds->image_size = image_size;
+}
+
+// 1 when any texel of the top level is below full alpha. Formats that can't be scanned cheaply (BC7)
+// count as having alpha, so they are never trusted as occluders.
+int texture_has_alpha(const uint8_t* pixels, enum FORMAT format, int width, int height)
+{
+    size_t block_count = (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4);
+    switch (format)
+    {
+        case FORMAT_BC1_UNORM: case FORMAT_BC1_UNORM_SRGB:
+            // Blocks with color0 <= color1 use index 3 for transparent black.
+            for (size_t i = 0; i < block_count; i++)
+            {
+                const uint8_t* block = pixels + i * 8;
+                unsigned int color0 = block[0] | (block[1] << 8);
+                unsigned int color1 = block[2] | (block[3] << 8);
+                if (color0 > color1)
+                    continue;
+                unsigned int indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+                for (int k = 0; k < 16; k++)
+                    if (((indices >> (k * 2)) & 3) == 3)
+                        return 1;
+            }
+            return 0;
+        case FORMAT_BC2_UNORM: case FORMAT_BC2_UNORM_SRGB:
+            for (size_t i = 0; i < block_count; i++)
+                for (int k = 0; k < 8; k++)
+                    if (pixels[i * 16 + k] != 0xff)
+                        return 1;
+            return 0;
+        case FORMAT_BC3_UNORM: case FORMAT_BC3_UNORM_SRGB:
+            // Only alpha0, alpha1 or, in 6 value blocks, index 7 can come out as 255.
+            for (size_t i = 0; i < block_count; i++)
+            {
+                const uint8_t* block = pixels + i * 16;
+                if (block[0] == 255 && block[1] == 255)
+                    continue;
+                unsigned long long indices = 0;
+                for (int k = 0; k < 6; k++)
+                    indices |= (unsigned long long)block[2 + k] << (k * 8);
+                for (int k = 0; k < 16; k++)
+                {
+                    unsigned int index = (unsigned int)(indices >> (k * 3)) & 7;
+                    int opaque = (index == 0 && block[0] == 255) || (index == 1 && block[1] == 255) || (index == 7 && block[0] <= block[1]);
+                    if (!opaque)
+                        return 1;
+                }
+            }
+            return 0;
+        case FORMAT_R8G8B8A8_UNORM: case FORMAT_R8G8B8A8_UNORM_SRGB: case FORMAT_B8G8R8A8_UNORM: case FORMAT_B8G8R8A8_UNORM_SRGB:
+            for (size_t i = 0; i < (size_t)width * (size_t)height; i++)
+                if (pixels[i * 4 + 3] != 255)
+                    return 1;
+            return 0;
+        case FORMAT_BC7_TYPELESS: case FORMAT_BC7_UNORM: case FORMAT_BC7_UNORM_SRGB:
+            return 1;
+        default:
+            return 0;
+    }
+}
+// Maps the DDS and parses it in place, so the pixels go from the mapping straight to where they are needed.
+// Returns 0 when the file can't be mapped or is shorter than its header says.
+int dds_map(const char* path, struct Mapped_File* file, struct Dds_Image* dds)
+{
+    if (!map_file(path, 0, file))
+        return 0;
+    // dds_parse trusts the headers, so they have to be in the file before it looks at them.
+    size_t header_size = sizeof(DWORD) + sizeof(struct DDS_HEADER);
+    if (file->size >= header_size)
+    {
+        const struct DDS_HEADER* header = (const struct DDS_HEADER*)((const char*)file->data + sizeof(DWORD));
+        if (header->ddspf.dwFlags & DDPF_FOURCC && !memcmp(&header->ddspf.dwFourCC, "DX10", 4))
+            header_size += sizeof(struct DDS_HEADER_DXT10);
+    }
+    if (file->size < header_size)
+    {
+        printf("Truncated DDS file: %s\n", path);
+        unmap_file(file);
+        return 0;
+    }
+
+    // dds_parse only reads, the mapping is read-only.
+    dds_parse(file->data, dds);
+    if (dds->image_size > file->size - (size_t)(dds->image - (const uint8_t*)file->data))
+    {
+        printf("Truncated DDS file: %s\n", path);
+        unmap_file(file);
+        return 0;
+    }
+
+    // Files that state their alpha mode are taken at their word, the rest have their top level scanned.
+    const struct DDS_HEADER* header = (const struct DDS_HEADER*)((const char*)file->data + sizeof(DWORD));
+    const struct DDS_HEADER_DXT10* header10 = (const struct DDS_HEADER_DXT10*)(header + 1);
+    enum DDS_ALPHA_MODE alpha_mode = DDS_ALPHA_MODE_UNKNOWN;
+    if (header->ddspf.dwFlags & DDPF_FOURCC && !memcmp(&header->ddspf.dwFourCC, "DX10", 4))
+        alpha_mode = (enum DDS_ALPHA_MODE)(header10->miscFlags2 & 7);
+    if (alpha_mode == DDS_ALPHA_MODE_STRAIGHT || alpha_mode == DDS_ALPHA_MODE_PREMULTIPLIED)
+        dds->has_alpha = 1;
+    else if (alpha_mode == DDS_ALPHA_MODE_OPAQUE)
+        dds->has_alpha = 0;
+    else
+        dds->has_alpha = texture_has_alpha(dds->image, dds->description.format, (int)dds->description.width, (int)dds->description.height);
+    return 1;
+}
+
+void load_texture_dds(struct Texture *texture, struct Device *device, struct Descriptor_Set *cbv_srv_uav_descriptor_set, struct Command_List *upload_command_list)
+{
+    struct Mapped_File file;
+    struct Dds_Image dds;
+    if (!dds_map(texture->path, &file, &dds))
+        __debugbreak();
+
+    texture->has_alpha = dds.has_alpha;
+    device_create_buffer(device, dds.description, &texture->buffer);
     buffer_set_name(texture->buffer, texture->path);
     device_create_shader_resource_view(device, 0, cbv_srv_uav_descriptor_set, texture->buffer, &texture->srv);
 
-    struct Allocation_Info buffer_allocation_info = device_get_allocation_info(device, buffer_desc);
+    struct Allocation_Info buffer_allocation_info = device_get_allocation_info(device, dds.description);
 
     struct Upload_Buffer* texture_upload_buffer = 0;
     device_create_upload_buffer(device, 0, buffer_allocation_info.size, &texture_upload_buffer);
 
     uint8_t* mapped_ptr = upload_buffer_map(texture_upload_buffer);
-    size_t offset = 0;
-    for (unsigned int array_element = 0; array_element < texture_array_size; array_element++)
+    memcpy(mapped_ptr, dds.image, dds.image_size);
+    upload_buffer_unmap(texture_upload_buffer);
+    unmap_file(&file);
+
+    command_list_copy_upload_buffer_to_buffer(upload_command_list, texture_upload_buffer, texture->buffer);
+    upload_buffer_destroy(texture_upload_buffer);
+}
+
+// A texture ready for upload: its description and every subresource packed in DDS order. The pixels point
+// into a mapping (DDS files, texture cache hits) or into one of the allocations made converting a PNG.
+struct Texture_Data
+{
+    struct Mapped_File file;
+    struct Buffer_Descriptor description;
+    const void* pixels;
+    size_t pixel_size;
+    unsigned char* decoded; // stb_image allocation, freed as soon as mips or blocks replace it.
+    unsigned char* mips; // The mip chain, or just the top level padded out to whole blocks.
+    void* compressed;
+    int has_alpha;
+};
+void texture_data_free(struct Texture_Data* data)
+{
+    unmap_file(&data->file);
+    stbi_image_free(data->decoded);
+    free(data->mips);
+    free(data->compressed);
+    data->decoded = 0;
+    data->mips = 0;
+    data->compressed = 0;
+}
+// Decodes a PNG and converts it for upload: mip chain, then block compression, each when turned on.
+int texture_data_convert_png(struct Texture_Data* data, const void* source, size_t source_size, enum TEXTURE_USAGE usage, struct Thread_Pool* thread_pool)
+{
+    // RGB is expanded to RGBA since there is no 3 channel format.
+    int expected_component_count = 0;
+    stbi_info_from_memory(source, (int)source_size, &(int){0}, &(int){0}, &expected_component_count);
+    int x, y, component_count;
+    data->decoded = stbi_load_from_memory(source, (int)source_size, &x, &y, &component_count, (expected_component_count == 3) ? 4 : 0);
+    if (!data->decoded)
+        return 0;
+    if (expected_component_count == 3)
+        component_count = 4;
+
+    enum FORMAT formats[] = {FORMAT_UNKNOWN, FORMAT_R8_UNORM, FORMAT_R8G8_UNORM, FORMAT_R8G8B8A8_UNORM, FORMAT_R8G8B8A8_UNORM};
+    data->description = (struct Buffer_Descriptor){
+        .width = (unsigned long long)x,
+        .height = (unsigned long long)y,
+        .mip_count = 1,
+        .buffer_type = BUFFER_TYPE_TEXTRUE2D,
+        .bind_types = {
+            BIND_TYPE_SRV
+        },
+        .bind_types_count = 1,
+        .format = formats[component_count]};
+    data->pixels = data->decoded;
+    data->pixel_size = (size_t)x * (size_t)y * (size_t)component_count;
+    if (expected_component_count == 2 || expected_component_count == 4)
+    {
+        for (size_t i = (size_t)component_count - 1; i < data->pixel_size && !data->has_alpha; i += (size_t)component_count)
+            data->has_alpha = data->decoded[i] != 255;
+    }
+
+    if (UseTextureCompression && (x % 4 != 0 || y % 4 != 0))
+    {
+        data->mips = texture_pad_to_blocks(data->decoded, component_count, &data->description, &data->pixel_size);
+        stbi_image_free(data->decoded);
+        data->decoded = 0;
+        data->pixels = data->mips;
+    }
+    unsigned char* mips = texture_generate_mips(data->pixels, component_count, usage, &data->description, &data->pixel_size, thread_pool);
+    if (mips)
+    {
+        stbi_image_free(data->decoded);
+        free(data->mips);
+        data->decoded = 0;
+        data->mips = mips;
+        data->pixels = mips;
+    }
+    data->compressed = texture_compress(data->pixels, component_count, usage, &data->description, &data->pixel_size, thread_pool);
+    if (data->compressed)
+    {
+        stbi_image_free(data->decoded);
+        free(data->mips);
+        data->decoded = 0;
+        data->mips = 0;
+        data->pixels = data->compressed;
+    }
+    return 1;
+}
+
+// Converted PNGs are kept on disk as DDS files named after a hash of the source file and the conversion
+// settings, so a texture is only converted again when either of them changes. A hit is read like any other
+// DDS, straight from its mapping. Hits refresh the file's write time, and once loading is done the files
+// used longest ago are deleted until the cache fits in TextureCacheMaxSize.
+#define TEXTURE_CACHE_VERSION 3
+static int UseTextureCache = 1;
+static size_t TextureCacheMaxSize = 1ull << 30;
+struct Texture_Cache_Stats
+{
+    volatile LONG64 hits;
+    volatile LONG64 misses;
+    volatile LONG64 bytes_read;
+    volatile LONG64 bytes_written;
+
+    // As of the last trim.
+    size_t file_count;
+    size_t size;
+    size_t evicted_file_count;
+    size_t evicted_size;
+};
+static struct Texture_Cache_Stats TextureCacheStats;
+struct Texture_Cache_Settings
+{
+    unsigned int version;
+    int use_mip_generation;
+    int use_texture_compression;
+    enum BC_QUALITY quality;
+    enum TEXTURE_USAGE usage;
+};
+char* texture_cache_path(const void* source, size_t source_size, enum TEXTURE_USAGE usage)
+{
+    struct Texture_Cache_Settings settings = {
+        .version = TEXTURE_CACHE_VERSION,
+        .use_mip_generation = UseMipGeneration,
+        .use_texture_compression = UseTextureCompression,
+        .quality = TextureCompressionQuality,
+        .usage = usage,
+    };
+    unsigned long long key = hash64(source, source_size, hash64(&settings, sizeof(settings), 0));
+    char name[64];
+    snprintf(name, sizeof(name), "texturecache\\%016llx.dds", key);
+    return get_asset_path(name);
+}
+int texture_cache_load(const char* path, struct Texture_Data* data)
+{
+    // Opening for the write time doubles as the existence check.
+    HANDLE file = CreateFileA(path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        InterlockedIncrement64(&TextureCacheStats.misses);
+        return 0;
+    }
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(file, 0, 0, &now);
+    CloseHandle(file);
+
+    struct Dds_Image dds;
+    if (!dds_map(path, &data->file, &dds))
+    {
+        InterlockedIncrement64(&TextureCacheStats.misses);
+        return 0;
+    }
+    data->description = dds.description;
+    data->pixels = dds.image;
+    data->pixel_size = dds.image_size;
+    data->has_alpha = dds.has_alpha;
+    InterlockedIncrement64(&TextureCacheStats.hits);
+    InterlockedExchangeAdd64(&TextureCacheStats.bytes_read, (LONG64)data->file.size);
+    return 1;
+}
+void texture_cache_store(const char* path, const struct Texture_Data* data)
+{
+    enum DXGI_FORMAT format;
+    switch (data->description.format)
+    {
+        case FORMAT_R8_UNORM: format = DXGI_FORMAT_R8_UNORM; break;
+        case FORMAT_R8G8_UNORM: format = DXGI_FORMAT_R8G8_UNORM; break;
+        case FORMAT_R8G8B8A8_UNORM: format = DXGI_FORMAT_R8G8B8A8_UNORM; break;
+        case FORMAT_BC1_UNORM: format = DXGI_FORMAT_BC1_UNORM; break;
+        case FORMAT_BC3_UNORM: format = DXGI_FORMAT_BC3_UNORM; break;
+        case FORMAT_BC4_UNORM: format = DXGI_FORMAT_BC4_UNORM; break;
+        case FORMAT_BC5_UNORM: format = DXGI_FORMAT_BC5_UNORM; break;
+        case FORMAT_BC7_UNORM: format = DXGI_FORMAT_BC7_UNORM; break;
+        default: return;
+    }
+
+    struct DDS_HEADER header = {
+        .dwSize = sizeof(struct DDS_HEADER),
+        .dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT,
+        .dwHeight = (DWORD)data->description.height,
+        .dwWidth = (DWORD)data->description.width,
+        .dwMipMapCount = data->description.mip_count,
+        .ddspf = {
+            .dwSize = sizeof(struct DDS_PIXELFORMAT),
+            .dwFlags = DDPF_FOURCC,
+        },
+        .dwCaps = 0x401008, // DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX
+    };
+    memcpy(&header.ddspf.dwFourCC, "DX10", 4);
+    struct DDS_HEADER_DXT10 header10 = {
+        .dxgiFormat = format,
+        .resourceDimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D,
+        .arraySize = 1,
+        .miscFlags2 = data->has_alpha ? DDS_ALPHA_MODE_STRAIGHT : DDS_ALPHA_MODE_OPAQUE, // Saves dds_map the scan.
+    };
+
+    size_t size = 4 + sizeof(header) + sizeof(header10) + data->pixel_size;
+    char* buffer = malloc(size);
+    memcpy(buffer, "DDS ", 4);
+    memcpy(buffer + 4, &header, sizeof(header));
+    memcpy(buffer + 4 + sizeof(header), &header10, sizeof(header10));
+    memcpy(buffer + 4 + sizeof(header) + sizeof(header10), data->pixels, data->pixel_size);
+
+    char* directory = get_asset_path("texturecache");
+    CreateDirectoryA(directory, 0);
+    free(directory);
+    if (write_file(path, buffer, size))
+        InterlockedExchangeAdd64(&TextureCacheStats.bytes_written, (LONG64)size);
+    else
+        fprintf(stderr, "Failed to write texture cache: %s\n", path);
+    free(buffer);
+}
+struct Texture_Cache_Entry
+{
+    unsigned long long last_used;
+    unsigned long long size;
+    char name[MAX_PATH];
+};
+int texture_cache_entry_compare(const void* a, const void* b)
+{
+    const struct Texture_Cache_Entry* entry_a = a;
+    const struct Texture_Cache_Entry* entry_b = b;
+    return (entry_a->last_used > entry_b->last_used) - (entry_a->last_used < entry_b->last_used);
+}
+// Evicts the least recently used files while the cache is over TextureCacheMaxSize, then prints the stats.
+void texture_cache_trim(void)
+{
+    char* pattern = get_asset_path("texturecache\\*.dds");
+    WIN32_FIND_DATAA find_data;
+    HANDLE find = FindFirstFileA(pattern, &find_data);
+    free(pattern);
+
+    struct Texture_Cache_Entry* entries = 0;
+    size_t entry_count = 0;
+    size_t entry_capacity = 0;
+    size_t total_size = 0;
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (entry_count == entry_capacity)
+            {
+                entry_capacity = entry_capacity ? entry_capacity * 2 : 64;
+                entries = realloc(entries, entry_capacity * sizeof(struct Texture_Cache_Entry));
+            }
+            struct Texture_Cache_Entry* entry = &entries[entry_count++];
+            entry->last_used = ((unsigned long long)find_data.ftLastWriteTime.dwHighDateTime << 32) | find_data.ftLastWriteTime.dwLowDateTime;
+            entry->size = ((unsigned long long)find_data.nFileSizeHigh << 32) | find_data.nFileSizeLow;
+            snprintf(entry->name, sizeof(entry->name), "texturecache\\%s", find_data.cFileName);
+            total_size += entry->size;
+        } while (FindNextFileA(find, &find_data));
+        FindClose(find);
+    }
+
+    size_t file_count = entry_count;
+    if (total_size > TextureCacheMaxSize)
+    {
+        qsort(entries, entry_count, sizeof(struct Texture_Cache_Entry), texture_cache_entry_compare);
+        for (size_t i = 0; i < entry_count && total_size > TextureCacheMaxSize; i++)
+        {
+            char* path = get_asset_path(entries[i].name);
+            if (DeleteFileA(path))
+            {
+                total_size -= entries[i].size;
+                file_count--;
+                TextureCacheStats.evicted_file_count++;
+                TextureCacheStats.evicted_size += entries[i].size;
+            }
+            free(path);
+        }
+    }
+    free(entries);
+    TextureCacheStats.file_count = file_count;
+    TextureCacheStats.size = total_size;
+
+    printf("Texture cache: %lld hits, %lld misses, %.1f MB read, %.1f MB written, %zu files %.1f MB on disk (cap %.1f MB), %zu files %.1f MB evicted\n",
+        (long long)TextureCacheStats.hits, (long long)TextureCacheStats.misses, TextureCacheStats.bytes_read / (1024.0 * 1024.0), TextureCacheStats.bytes_written / (1024.0 * 1024.0),
+        TextureCacheStats.file_count, TextureCacheStats.size / (1024.0 * 1024.0), TextureCacheMaxSize / (1024.0 * 1024.0),
+        TextureCacheStats.evicted_file_count, TextureCacheStats.evicted_size / (1024.0 * 1024.0));
+}
+
+// Maps a DDS, or converts a PNG (going through the texture cache when it is on).
+int texture_data_load(const char* path, enum TEXTURE_USAGE usage, struct Texture_Data* data, struct Thread_Pool* thread_pool)
+{
+    size_t path_len = strlen(path);
+    if (path_len > 4 && strcmp(path + path_len - 4, ".dds") == 0)
+    {
+        struct Dds_Image dds;
+        if (!dds_map(path, &data->file, &dds))
+            return 0;
+        data->description = dds.description;
+        data->pixels = dds.image;
+        data->pixel_size = dds.image_size;
+        data->has_alpha = dds.has_alpha;
+        return 1;
+    }
+
+    struct Mapped_File source;
+    if (!map_file(path, 0, &source))
+        return 0;
+    char* cache_path = UseTextureCache ? texture_cache_path(source.data, source.size, usage) : 0;
+    if (cache_path && texture_cache_load(cache_path, data))
+    {
+        unmap_file(&source);
+        free(cache_path);
+        return 1;
+    }
+
+    int converted = texture_data_convert_png(data, source.data, source.size, usage, thread_pool);
+    unmap_file(&source);
+    if (converted && cache_path)
+        texture_cache_store(cache_path, data);
+    free(cache_path);
+    return converted;
+}
+
+void load_texture_png(struct Texture *texture, struct Device *device, struct Descriptor_Set *cbv_srv_uav_descriptor_set, struct Command_List *upload_command_list)
+{
+    stbi_set_flip_vertically_on_load(1);
+    struct Texture_Data data = {0};
+    if (!texture_data_load(texture->path, texture->usage, &data, 0))
+        return;
+
+    texture->has_alpha = data.has_alpha;
+    device_create_buffer(device, data.description, &texture->buffer);
+
+    device_create_shader_resource_view(device, 0, cbv_srv_uav_descriptor_set, texture->buffer, &texture->srv);
+
+    buffer_set_name(texture->buffer, texture->path);
+
+    struct Allocation_Info allocation_info = device_get_allocation_info(device, data.description);
+    struct Upload_Buffer *texture_upload_buffer = 0;
+    device_create_upload_buffer(device, 0, max(allocation_info.size, data.pixel_size), &texture_upload_buffer);
+
+    void *mapped = upload_buffer_map(texture_upload_buffer);
+    mapped;
+
+    memcpy(mapped, data.pixels, data.pixel_size);
+
+    upload_buffer_unmap(texture_upload_buffer);
+
+    texture_data_free(&data);
+
+    command_list_copy_upload_buffer_to_buffer(upload_command_list, texture_upload_buffer, texture->buffer);
+    upload_buffer_destroy(texture_upload_buffer);
+}
+
+void load_texture(struct Texture *texture, struct Device *device, struct Descriptor_Set *cbv_srv_uav_descriptor_set, struct Command_List *upload_command_list)
+{
+    size_t path_len = strlen(texture->path);
+    if (path_len <= 4)
+        return;
+    
+    char* extension = texture->path + (path_len - 4);
+    if (strcmp(extension, ".png") == 0)
+        load_texture_png(texture, device, cbv_srv_uav_descriptor_set, upload_command_list);
+    else if (strcmp(extension, ".dds") == 0)
+        load_texture_dds(texture, device, cbv_srv_uav_descriptor_set, upload_command_list);
+}
+
+// Texture loading split into stages so many textures are in flight at once. Worker threads map and decode
+// (and for DDS only parse) the files, the main thread creates the GPU objects and maps the upload buffers,
+// workers copy the pixels in, and the main thread records the copies. New files only start while the
+// bytes held by textures in flight stay under TextureLoadBudget.
+static int UseTexturePipeline = 1;
+static size_t TextureLoadBudget = 256ull << 20;
+struct Texture_Load
+{
+    struct Texture* texture;
+    size_t budget_bytes; // Estimated when the texture is admitted, given back once it is done.
+    struct Thread_Pool* thread_pool; // Converting a large PNG splits it across the pool.
+
+    // Decode stage.
+    struct Texture_Data data;
+
+    // Staging stage.
+    void* mapped;
+    struct Upload_Buffer* upload_buffer;
+
+    struct Thread_Pool_Job job;
+};
+// Bytes a texture will hold while in flight: the staging copy, plus for PNG the decoded pixels and their
+// mip chain, sized from its header. The mapped file itself is page cache the system can drop, it is not
+// counted.
+size_t texture_load_estimate(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return 0;
+    fseek(file, 0L, SEEK_END);
+    size_t estimate = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+    int x, y, component_count;
+    if (stbi_info_from_file(file, &x, &y, &component_count))
+        estimate = (size_t)x * (size_t)y * 4 * 4;
+    fclose(file);
+    return estimate;
+}
+void texture_load_decode_task(void* user, size_t index)
+{
+    (void)index;
+    struct Texture_Load* load = user;
+    texture_data_load(load->texture->path, load->texture->usage, &load->data, load->thread_pool);
+}
+void texture_load_stage_task(void* user, size_t index)
+{
+    (void)index;
+    struct Texture_Load* load = user;
+    memcpy(load->mapped, load->data.pixels, load->data.pixel_size);
+    texture_data_free(&load->data);
+}
+void texture_load_submit(struct Thread_Pool* thread_pool, struct Texture_Load* load, Thread_Pool_Fn* fn)
+{
+    load->job = (struct Thread_Pool_Job){ .fn = fn, .user = load, .count = 1 };
+    if (thread_pool)
+        thread_pool_submit(thread_pool, &load->job);
+    else
+        fn(load, 0);
+}
+void texture_load_wait(struct Thread_Pool* thread_pool, struct Texture_Load* load)
+{
+    if (thread_pool)
+        thread_pool_wait(thread_pool, &load->job);
+}
+// Loads every texture through the stages above. Each texture is handed to the main thread in order, while
+// the ones after it are still reading and decoding and the one before it is still being copied.
+void load_textures(struct Texture* textures, size_t texture_count, struct Device* device, struct Descriptor_Set* cbv_srv_uav_descriptor_set, struct Command_List* upload_command_list, struct Thread_Pool* thread_pool)
+{
+    unsigned long long timestamp1 = GetRdtsc();
+    stbi_set_flip_vertically_on_load(1);
+
+    struct Texture_Load* loads = calloc(texture_count, sizeof(struct Texture_Load));
+    size_t in_flight = 0;
+    size_t peak_in_flight = 0;
+    size_t total_bytes = 0;
+    size_t next_decode = 0;
+    struct Texture_Load* staging = 0;
+    for (size_t i = 0; i <= texture_count; i++)
+    {
+        // Keep the decoders fed, as far ahead as the budget allows but always at least the next texture.
+        while (next_decode < texture_count)
+        {
+            struct Texture_Load* load = &loads[next_decode];
+            if (!load->texture)
+            {
+                load->texture = &textures[next_decode];
+                load->thread_pool = thread_pool;
+                load->budget_bytes = texture_load_estimate(load->texture->path);
+            }
+            if (next_decode > i && in_flight + load->budget_bytes > TextureLoadBudget)
+                break;
+            in_flight += load->budget_bytes;
+            peak_in_flight = max(peak_in_flight, in_flight);
+            texture_load_submit(thread_pool, load, texture_load_decode_task);
+            next_decode++;
+        }
+
+        struct Texture_Load* load = i < texture_count ? &loads[i] : 0;
+        if (load)
+            texture_load_wait(thread_pool, load);
+        int loaded = load && load->data.pixels;
+        if (loaded)
+        {
+            struct Texture* texture = load->texture;
+            texture->has_alpha = load->data.has_alpha;
+            device_create_buffer(device, load->data.description, &texture->buffer);
+            buffer_set_name(texture->buffer, texture->path);
+            device_create_shader_resource_view(device, 0, cbv_srv_uav_descriptor_set, texture->buffer, &texture->srv);
+
+            struct Allocation_Info allocation_info = device_get_allocation_info(device, load->data.description);
+            device_create_upload_buffer(device, 0, max(allocation_info.size, load->data.pixel_size), &load->upload_buffer);
+            load->mapped = upload_buffer_map(load->upload_buffer);
+            total_bytes += load->data.pixel_size;
+            texture_load_submit(thread_pool, load, texture_load_stage_task);
+        }
+
+        // Finish the previous texture while this one is being copied.
+        if (staging)
+        {
+            texture_load_wait(thread_pool, staging);
+            upload_buffer_unmap(staging->upload_buffer);
+            command_list_copy_upload_buffer_to_buffer(upload_command_list, staging->upload_buffer, staging->texture->buffer);
+            upload_buffer_destroy(staging->upload_buffer);
+            in_flight -= staging->budget_bytes;
+            staging = 0;
+        }
+        if (loaded)
+        {
+            staging = load;
+        }
+        else if (load)
+        {
+            fprintf(stderr, "Failed to load texture: %s\n", load->texture->path);
+            texture_data_free(&load->data);
+            in_flight -= load->budget_bytes;
+        }
+    }
+    free(loads);
+
+    double time = (double)(GetRdtsc() - timestamp1) / GetRdtscFreq();
+    printf("Textures: %zu in %.1f ms, %.1f MB staged, peak in flight %.1f MB, %u threads\n", texture_count, time * 1000.0, total_bytes / (1024.0 * 1024.0),
+        peak_in_flight / (1024.0 * 1024.0), thread_pool ? thread_pool_get_thread_count(thread_pool) : 1);
+}
+
+// Loads every DDS texture in the asset folder by reading the whole file and copying the pixels out of the
+// read buffer, and by mapping the file and copying the pixels straight out of the mapping. The copy goes
+// into a plain allocation standing in for the upload buffer. Files are loaded once first so both modes
+// start with them in the file cache.
+void benchmark_dds_load(void)
+{
+    const char* mode_names[] = { "read", "mapped" };
+    size_t staging_size = 0;
+    void* staging = 0;
+    for (int pass = 0; pass < 3; pass++)
+    {
+        int mapped = pass == 2;
+        char* pattern = get_asset_path("textures\\*.dds");
+        WIN32_FIND_DATAA find_data;
+        HANDLE find = FindFirstFileA(pattern, &find_data);
+        free(pattern);
+        if (find == INVALID_HANDLE_VALUE)
+            return;
+
+        size_t file_count = 0;
+        size_t bytes_read = 0;
+        size_t bytes_copied = 0;
+        unsigned long long timestamp1 = GetRdtsc();
+        do
+        {
+            char name[MAX_PATH];
+            snprintf(name, sizeof(name), "textures\\%s", find_data.cFileName);
+            char* path = get_asset_path(name);
+            struct Dds_Image dds;
+            struct Mapped_File file = {0};
+            char* file_data = 0;
+            if (mapped)
+            {
+                if (!dds_map(path, &file, &dds))
+                {
+                    free(path);
+                    continue;
+                }
+            }
+            else
+            {
+                FILE* f = fopen(path, "rb");
+                if (!f)
+                {
+                    free(path);
+                    continue;
+                }
+                fseek(f, 0L, SEEK_END);
+                size_t file_size = ftell(f);
+                fseek(f, 0L, SEEK_SET);
+                file_data = malloc(file_size);
+                fread(file_data, 1, file_size, f);
+                fclose(f);
+                dds_parse(file_data, &dds);
+                bytes_read += file_size;
+            }
+            free(path);
+
+            if (dds.image_size > staging_size)
+            {
+                staging_size = dds.image_size;
+                staging = realloc(staging, staging_size);
+            }
+            memcpy(staging, dds.image, dds.image_size);
+            bytes_copied += dds.image_size;
+            free(file_data);
+            unmap_file(&file);
+            file_count++;
+        } while (FindNextFileA(find, &find_data));
+        FindClose(find);
+        double time = (double)(GetRdtsc() - timestamp1) / GetRdtscFreq();
+
+        if (pass > 0)
+            printf("DDS load %s: %zu files, %.1f MB read, %.1f MB copied, ms: %.3f\n", mode_names[mapped], file_count,
+                bytes_read / (1024.0 * 1024.0), bytes_copied / (1024.0 * 1024.0), time * 1000.0);
+    }
+    free(staging);
+}
+
+// Decoders for what bc_compress writes (BC7 mode 6 only), used to measure its error.
+void bc1_decode_block(const unsigned char* in, struct Bc_Block* block)
+{
+    unsigned short color0, color1;
+    unsigned int indices;
+    memcpy(&color0, in, 2);
+    memcpy(&color1, in + 2, 2);
+    memcpy(&indices, in + 4, 4);
+    float palette[4][4];
+    bc_unpack_565(color0, palette[0]);
+    bc_unpack_565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    for (int p = 0; p < 16; p++)
+        for (int c = 0; c < 3; c++)
+            block->channel[c][p] = palette[(indices >> (2 * p)) & 3][c];
+}
+void bc4_decode_block(const unsigned char* in, int channel, struct Bc_Block* block)
+{
+    unsigned long long bits;
+    memcpy(&bits, in, 8);
+    float palette[8] = { (float)in[0], (float)in[1] };
+    for (int i = 2; i < 8; i++)
+        palette[i] = ((float)(8 - i) * palette[0] + (float)(i - 1) * palette[1]) / 7.0f;
+    for (int p = 0; p < 16; p++)
+        block->channel[channel][p] = palette[(bits >> (16 + 3 * p)) & 7];
+}
+void bc7_decode_block(const unsigned char* in, struct Bc_Block* block)
+{
+    unsigned long long bits[2];
+    memcpy(bits, in, 16);
+    int offset = 7;
+    #define BC7_GET(count) (int)(((offset += (count)), (bits[(offset - (count)) >> 6] >> ((offset - (count)) & 63))) & ((1u << (count)) - 1))
+    int q[2][4];
+    for (int c = 0; c < 4; c++)
     {
-        for (unsigned int mip = 0; mip < mip_count; ++mip)
+        q[0][c] = BC7_GET(7);
+        q[1][c] = BC7_GET(7);
+    }
+    int p0 = BC7_GET(1);
+    int p1 = BC7_GET(1);
+    for (int p = 0; p < 16; p++)
+    {
+        int index = BC7_GET(p == 0 ? 3 : 4);
+        for (int c = 0; c < 4; c++)
         {
-            int mip_width = max(1, header->dwWidth >> mip);
-            int mip_height = max(1, header->dwHeight >> mip);
-            size_t mip_size = format_compute_mip_size(texture_format, mip_width, mip_height);
-            memcpy(mapped_ptr + offset, image_data + offset, mip_size);
-            offset  += mip_size;
-
-            printf("Mip level: %d\n", mip);
-            printf("Mip width: %d\n", mip_width);
-            printf("Mip height: %d\n", mip_height);
-            printf("Mip size: %zd\n", mip_size);
+            int d0 = (q[0][c] << 1) | p0, d1 = (q[1][c] << 1) | p1;
+            block->channel[c][p] = (float)(((64 - Bc7Weights[index]) * d0 + Bc7Weights[index] * d1 + 32) >> 6);
         }
     }
-    upload_buffer_unmap(texture_upload_buffer);
+    #undef BC7_GET
+}
+// Root mean square error over the channels the format keeps.
+double bc_measure_error(const unsigned char* pixels, int width, int height, int component_count, enum FORMAT format, const unsigned char* blocks)
+{
+    int first = 0, count = 4;
+    if (format == FORMAT_BC1_UNORM) count = 3;
+    if (format == FORMAT_BC4_UNORM) count = 1;
+    if (format == FORMAT_BC5_UNORM) count = 2;
+    double error = 0.0;
+    for (int y = 0; y < height; y += 4)
+    {
+        for (int x = 0; x < width; x += 4, blocks += bc_block_size(format))
+        {
+            struct Bc_Block source, decoded;
+            bc_load_block(pixels, width, height, component_count, x, y, &source);
+            switch (format)
+            {
+                case FORMAT_BC1_UNORM: bc1_decode_block(blocks, &decoded); break;
+                case FORMAT_BC3_UNORM: bc4_decode_block(blocks, 3, &decoded); bc1_decode_block(blocks + 8, &decoded); break;
+                case FORMAT_BC4_UNORM: bc4_decode_block(blocks, 0, &decoded); break;
+                case FORMAT_BC5_UNORM: bc4_decode_block(blocks, 0, &decoded); bc4_decode_block(blocks + 8, 1, &decoded); break;
+                case FORMAT_BC7_UNORM: bc7_decode_block(blocks, &decoded); break;
+                default: return 0.0;
+            }
+            for (int c = first; c < first + count; c++)
+                for (int p = 0; p < 16; p++)
+                    error += (source.channel[c][p] - decoded.channel[c][p]) * (source.channel[c][p] - decoded.channel[c][p]);
+        }
+    }
+    return sqrt(error / ((double)width * (double)height * count));
+}
+// Compresses every PNG in the asset folder at each quality preset, files with "normal" in the name as normal
+// maps, and prints throughput, bits per pixel and error against the source.
+void benchmark_texture_compression(struct Thread_Pool* thread_pool)
+{
+    const char* quality_names[] = { "fast", "normal", "high" };
+    for (int quality = BC_QUALITY_FAST; quality <= BC_QUALITY_HIGH; quality++)
+    {
+        char* pattern = get_asset_path("*.png");
+        WIN32_FIND_DATAA find_data;
+        HANDLE find = FindFirstFileA(pattern, &find_data);
+        free(pattern);
+        if (find == INVALID_HANDLE_VALUE)
+            return;
+
+        size_t file_count = 0;
+        size_t pixel_count = 0;
+        size_t compressed_bytes = 0;
+        double error = 0.0;
+        double time = 0.0;
+        do
+        {
+            char* path = get_asset_path(find_data.cFileName);
+            int expected_component_count = 0;
+            stbi_info(path, &(int){0}, &(int){0}, &expected_component_count);
+            int x, y, component_count;
+            unsigned char* pixels = stbi_load(path, &x, &y, &component_count, (expected_component_count == 3) ? 4 : 0);
+            free(path);
+            if (!pixels)
+                continue;
+            if (expected_component_count == 3)
+                component_count = 4;
+            if (x % 4 != 0 || y % 4 != 0)
+            {
+                stbi_image_free(pixels);
+                continue;
+            }
 
-    command_list_copy_upload_buffer_to_buffer(upload_command_list, texture_upload_buffer, texture->buffer);
-    upload_buffer_destroy(texture_upload_buffer);
+            int is_normal_map = strstr(find_data.cFileName, "normal") || strstr(find_data.cFileName, "Normal");
+            enum TEXTURE_USAGE usage = is_normal_map ? TEXTURE_USAGE_NORMAL : TEXTURE_USAGE_COLOR;
+
+            unsigned long long timestamp1 = GetRdtsc();
+            enum FORMAT format = bc_choose_format(pixels, (size_t)x * (size_t)y, component_count, usage, (enum BC_QUALITY)quality);
+            size_t size = bc_compressed_size(format, x, y);
+            unsigned char* blocks = malloc(size);
+            bc_compress(pixels, x, y, component_count, format, (enum BC_QUALITY)quality, blocks, thread_pool);
+            unsigned long long timestamp2 = GetRdtsc();
+            time += (double)(timestamp2 - timestamp1) / GetRdtscFreq();
+
+            error += bc_measure_error(pixels, x, y, component_count, format, blocks);
+            file_count++;
+            pixel_count += (size_t)x * (size_t)y;
+            compressed_bytes += size;
+            free(blocks);
+            stbi_image_free(pixels);
+        } while (FindNextFileA(find, &find_data));
+        FindClose(find);
+
+        printf("Texture compression %s: %zu files, %.1f MP in %.1f ms (%.1f MP/s), %.2f bits per pixel, average RMSE %.3f\n", quality_names[quality], file_count,
+            pixel_count / 1e6, time * 1000.0, pixel_count / 1e6 / time, compressed_bytes * 8.0 / pixel_count, file_count ? error / file_count : 0.0);
+    }
 }
 
-void load_texture(struct Texture *texture, struct Device *device, struct Descriptor_Set *cbv_srv_uav_descriptor_set, struct Command_List *upload_command_list)
+struct Model_Constant
 {
-    size_t path_len = strlen(texture->path);
-    if (path_len <= 4)
-        return;
-    
-    char* extension = texture->path + (path_len - 4);
-    if (strcmp(extension, ".png") == 0)
-        load_texture_png(texture, device, cbv_srv_uav_descriptor_set, upload_command_list);
-    else if (strcmp(extension, ".dds") == 0)
-        load_texture_dds(texture, device, cbv_srv_uav_descriptor_set, upload_command_list);
+    Mat4 model_to_world;
+    unsigned int enabled_color_texture;
+    unsigned int enabled_normal_texture;
+    unsigned int enabled_roughness_texture;
+    unsigned int enabled_metallic_texture;
+    Vec3 position_scale;
+    unsigned int compact_vertices;
+    Vec3 position_offset;
+    float pad;
+};
+struct Model_Constant model_constant(struct Scene* scene, struct Node* node, struct Mesh_Part* mesh_part)
+{
+    struct Model_Constant constant = { 
+        .model_to_world = scene->transforms.world_geometry[node->transform_index],
+        .enabled_color_texture = mesh_part->color_texture != 0,
+        .enabled_normal_texture = mesh_part->normal_texture != 0,
+        .enabled_roughness_texture = 0,
+        .enabled_metallic_texture = 0,
+        .position_scale = UseCompactVertices ? mesh_part->position_extent : V3(1.0f, 1.0f, 1.0f),
+        .compact_vertices = UseCompactVertices,
+        .position_offset = UseCompactVertices ? mesh_part->position_min : V3(0.0f, 0.0f, 0.0f),
+    };
+    return constant;
 }
-
-void upload_node_buffers(struct Node *node, struct Device *device, struct Command_List *upload_command_list, struct Descriptor_Set *cbv_srv_uav_descriptor_set)
+void upload_node_buffers(struct Node *node, struct Scene *scene, struct Device *device, struct Command_List *upload_command_list, struct Descriptor_Set *cbv_srv_uav_descriptor_set, struct Thread_Pool* thread_pool)
 {
     if (node->type == NODE_TYPE_MESH)
     {
         for (size_t i = 0; i < node->mesh.mesh_parts_count; i++)
         {
             struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[i];
+            // Textures are loaded after every node, by then each one knows whether it is a normal map.
+            if (mesh_part->normal_texture)
+                mesh_part->normal_texture->usage = TEXTURE_USAGE_NORMAL;
 
             struct Vertex* vertex_array = mesh_part->vertex_array;
             size_t vertex_count = mesh_part->vertex_count;
-            unsigned int* index_array = mesh_part->index_array;
-            size_t index_count = mesh_part->index_count;
+            void* index_array = mesh_part->index_array;
+            size_t index_count = mesh_part_total_index_count(mesh_part);
 
             if (vertex_count == 0 || index_count == 0)
                 continue;
 
+            mesh_part_compute_bounds(mesh_part);
+            void* vertex_data = vertex_array;
+            if (UseCompactVertices)
+            {
+                struct Compact_Vertex* compact_array = malloc(sizeof(struct Compact_Vertex) * vertex_count);
+                for (size_t j = 0; j < vertex_count; j++)
+                    compact_array[j] = compact_vertex_encode(&vertex_array[j], mesh_part->position_min, mesh_part->position_extent);
+                vertex_data = compact_array;
+            }
+
             struct Upload_Buffer* vertex_upload_buffer = 0;
-            device_create_upload_buffer(device, vertex_array, sizeof(struct Vertex) * vertex_count, &vertex_upload_buffer);
+            device_create_upload_buffer(device, vertex_data, vertex_stride() * vertex_count, &vertex_upload_buffer);
+            if (vertex_data != vertex_array)
+                free(vertex_data);
             {
                 struct Buffer_Descriptor buffer_description = {
-                    .width = sizeof(struct Vertex) * vertex_count,
+                    .width = vertex_stride() * vertex_count,
                     .height = 1,
                     .buffer_type = BUFFER_TYPE_BUFFER,
                 };
@@ -1030,24 +6469,16 @@ void upload_node_buffers(struct Node *node, struct Device *device, struct Comman
             }
 
             struct Upload_Buffer* index_upload_buffer = 0;
-            device_create_upload_buffer(device, index_array, sizeof(unsigned int) * index_count, &index_upload_buffer);
+            device_create_upload_buffer(device, index_array, mesh_part_index_size(mesh_part) * index_count, &index_upload_buffer);
             {
                 struct Buffer_Descriptor buffer_description = {
-                    .width = sizeof(unsigned int) * index_count,
+                    .width = mesh_part_index_size(mesh_part) * index_count,
                     .height = 1,
                     .buffer_type = BUFFER_TYPE_BUFFER,
                 };
                 device_create_buffer(device, buffer_description, &mesh_part->index_buffer);
             }
 
-            struct Model_Constant
-            {
-                Mat4 model_to_world;
-                unsigned int enabled_color_texture;
-                unsigned int enabled_normal_texture;
-                unsigned int enabled_roughness_texture;
-                unsigned int enabled_metallic_texture;
-            };
             {
                 struct Buffer_Descriptor buffer_description = {
                     .width = sizeof(struct Model_Constant),
@@ -1065,13 +6496,7 @@ void upload_node_buffers(struct Node *node, struct Device *device, struct Comman
 
             struct Upload_Buffer* constant_upload_buffer = 0;
             {
-                struct Model_Constant constant = { 
-                    .model_to_world = node_global_transform_geometry(node),
-                    .enabled_color_texture = mesh_part->color_texture != 0,
-                    .enabled_normal_texture = mesh_part->normal_texture != 0,
-                    .enabled_roughness_texture = 0,
-                    .enabled_metallic_texture = 0,
-                };
+                struct Model_Constant constant = model_constant(scene, node, mesh_part);
                 device_create_upload_buffer(device, &constant, sizeof(struct Model_Constant), &constant_upload_buffer);
             }
             
@@ -1088,22 +6513,639 @@ void upload_node_buffers(struct Node *node, struct Device *device, struct Comman
 
     for (size_t i = 0; i < node->child_count; i++)
     {
-        upload_node_buffers(node->child_array[i], device, upload_command_list, cbv_srv_uav_descriptor_set);
+        upload_node_buffers(node->child_array[i], scene, device, upload_command_list, cbv_srv_uav_descriptor_set, thread_pool);
     }
 
-    if (!node->parent) // is_root
+    if (!node->parent && UseTexturePipeline) // is_root
+    {
+        load_textures(node->texture_array, node->texture_count, device, cbv_srv_uav_descriptor_set, upload_command_list, thread_pool);
+    }
+    else if (!node->parent)
     {
         for (size_t i = 0; i < node->texture_count; i++)
         {
             struct Texture* texture = &node->texture_array[i];
-            printf("Texture Path: %s\n", texture->path);
-
             load_texture(texture, device, cbv_srv_uav_descriptor_set, upload_command_list);
         }
     }
+
+    if (!node->parent && UseTextureCache)
+    {
+        texture_cache_trim();
+    }
+}
+
+// Rewrites the model constants of the nodes the last scene_update_dirty_transforms touched.
+void upload_changed_transforms(struct Scene* scene, struct Command_List* command_list)
+{
+    struct Scene_Transforms* transforms = &scene->transforms;
+    for (size_t i = 0; i < transforms->changed_count; i++)
+    {
+        struct Node* node = transforms->nodes[transforms->changed_list[i]];
+        if (node->type != NODE_TYPE_MESH)
+            continue;
+
+        for (size_t j = 0; j < node->mesh.mesh_parts_count; j++)
+        {
+            struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[j];
+            if (!mesh_part->constant_buffer)
+                continue;
+
+            struct Model_Constant* constant_buffer_ptr = command_list_map_buffer(command_list, mesh_part->constant_buffer);
+            *constant_buffer_ptr = model_constant(scene, node, mesh_part);
+            command_list_unmap_buffer(command_list, mesh_part->constant_buffer);
+        }
+    }
+}
+// Skips mesh parts outside the camera frustum before any draw is recorded, see frustum_cull.
+static int UseFrustumCulling = 1;
+// Cull through scene->bvh when it has been built rather than testing every part.
+static int UseSceneBvh = 1;
+struct Frustum_Cull_Stats
+{
+    size_t visible;
+    size_t culled;
+    size_t nodes_tested; // BVH nodes, 0 for the flat pass.
+    double milliseconds;
+};
+// The 6 planes of world_to_clip's frustum, normalized and pointing inwards. Depth is 0 to w, as Perspective_LH_ZO makes it.
+void frustum_planes(Mat4 world_to_clip, Vec4 planes[6])
+{
+    Vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = V4(world_to_clip.Elements[0][r], world_to_clip.Elements[1][r], world_to_clip.Elements[2][r], world_to_clip.Elements[3][r]);
+    planes[0] = AddV4(rows[3], rows[0]);
+    planes[1] = SubV4(rows[3], rows[0]);
+    planes[2] = AddV4(rows[3], rows[1]);
+    planes[3] = SubV4(rows[3], rows[1]);
+    planes[4] = rows[2];
+    planes[5] = SubV4(rows[3], rows[2]);
+    for (int i = 0; i < 6; i++)
+        planes[i] = MulV4F(planes[i], 1.0f / LenV3(planes[i].XYZ));
+}
+// Tests parts [first, first + 4) at once. Their boxes and spheres go to world space first, the box as
+// the world AABB around the transformed box, the sphere scaled by the largest axis scale. A part is
+// visible while both stay on the inner side of every plane.
+void frustum_cull_x4(struct Scene* scene, const Vec4 planes[6], size_t first)
+{
+    struct Scene_Bounds* bounds = &scene->bounds;
+    const Mat4* world[4];
+    for (int i = 0; i < 4; i++)
+        world[i] = &scene->transforms.world_geometry[bounds->transform_index[first + i]];
+
+    __m128 m[4][3];
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 3; r++)
+            m[c][r] = _mm_setr_ps(world[0]->Elements[c][r], world[1]->Elements[c][r], world[2]->Elements[c][r], world[3]->Elements[c][r]);
+
+    __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 center[3], extent[3];
+    for (int k = 0; k < 3; k++)
+    {
+        center[k] = _mm_loadu_ps(bounds->center[k] + first);
+        extent[k] = _mm_loadu_ps(bounds->extent[k] + first);
+    }
+    __m128 world_center[3], world_extent[3];
+    for (int r = 0; r < 3; r++)
+    {
+        world_center[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][r], center[0]), _mm_mul_ps(m[1][r], center[1])), _mm_add_ps(_mm_mul_ps(m[2][r], center[2]), m[3][r]));
+        world_extent[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, m[0][r]), extent[0]), _mm_mul_ps(_mm_andnot_ps(sign_mask, m[1][r]), extent[1])),
+            _mm_mul_ps(_mm_andnot_ps(sign_mask, m[2][r]), extent[2]));
+    }
+    __m128 scale_squared = _mm_setzero_ps();
+    for (int c = 0; c < 3; c++)
+        scale_squared = _mm_max_ps(scale_squared, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[c][0], m[c][0]), _mm_mul_ps(m[c][1], m[c][1])), _mm_mul_ps(m[c][2], m[c][2])));
+    __m128 world_radius = _mm_mul_ps(_mm_loadu_ps(bounds->radius + first), _mm_sqrt_ps(scale_squared));
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 visible = _mm_cmpeq_ps(zero, zero);
+    for (int i = 0; i < 6; i++)
+    {
+        __m128 plane_x = _mm_set1_ps(planes[i].X), plane_y = _mm_set1_ps(planes[i].Y), plane_z = _mm_set1_ps(planes[i].Z);
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x, world_center[0]), _mm_mul_ps(plane_y, world_center[1])),
+            _mm_add_ps(_mm_mul_ps(plane_z, world_center[2]), _mm_set1_ps(planes[i].W)));
+        __m128 box_reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, plane_x), world_extent[0]), _mm_mul_ps(_mm_andnot_ps(sign_mask, plane_y), world_extent[1])),
+            _mm_mul_ps(_mm_andnot_ps(sign_mask, plane_z), world_extent[2]));
+        visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, world_radius), zero));
+        visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, box_reach), zero));
+    }
+
+    int mask = _mm_movemask_ps(visible);
+    for (int i = 0; i < 4; i++)
+        bounds->visible[first + i] = (unsigned char)((mask >> i) & 1);
+}
+// -1 when the box is outside one of the planes, 1 when it is inside all of them, 0 when it straddles.
+int frustum_classify_box(const Vec4 planes[6], Vec3 box_min, Vec3 box_max)
+{
+    Vec3 center = MulV3F(AddV3(box_min, box_max), 0.5f);
+    Vec3 extent = MulV3F(SubV3(box_max, box_min), 0.5f);
+    int inside = 1;
+    for (int i = 0; i < 6; i++)
+    {
+        float distance = DotV3(planes[i].XYZ, center) + planes[i].W;
+        float reach = fabsf(planes[i].X) * extent.X + fabsf(planes[i].Y) * extent.Y + fabsf(planes[i].Z) * extent.Z;
+        if (distance + reach < 0.0f)
+            return -1;
+        if (distance - reach < 0.0f)
+            inside = 0;
+    }
+    return inside;
+}
+// Walks scene->bvh from the root. Subtrees outside a plane are dropped and subtrees inside all planes
+// are taken whole, only the parts in leaves that straddle the frustum are tested one by one.
+void frustum_cull_bvh(struct Scene* scene, const Vec4 planes[6], struct Frustum_Cull_Stats* stats)
+{
+    struct Scene_Bvh* bvh = &scene->bvh;
+    unsigned char* visible = scene->bounds.visible;
+    memset(visible, 0, scene->bounds.padded_count);
+
+    unsigned int stack[64];
+    size_t stack_count = 0;
+    stack[stack_count++] = 0;
+    while (stack_count > 0)
+    {
+        struct Bvh_Node* node = &bvh->nodes[stack[--stack_count]];
+        if (node->item_count == 0)
+            continue;
+        stats->nodes_tested++;
+
+        int classification = frustum_classify_box(planes, node->min, node->max);
+        if (classification < 0)
+            continue;
+        if (classification > 0)
+        {
+            for (unsigned int i = node->first_item; i < node->first_item + node->item_count; i++)
+                visible[bvh->items[i]] = 1;
+            continue;
+        }
+        if (node->left && stack_count + 2 <= ARRAYSIZE(stack))
+        {
+            stack[stack_count++] = node->left + 1;
+            stack[stack_count++] = node->left;
+            continue;
+        }
+        for (unsigned int i = node->first_item; i < node->first_item + node->item_count; i++)
+        {
+            unsigned int item = bvh->items[i];
+            visible[item] = (unsigned char)(frustum_classify_box(planes, bvh->part_min[item], bvh->part_max[item]) >= 0);
+        }
+    }
+}
+// Fills scene->bounds.visible for the current world transforms, draw_node skips the parts left at 0.
+struct Frustum_Cull_Stats frustum_cull(struct Scene* scene, Mat4 world_to_clip)
+{
+    unsigned long long start = GetRdtsc();
+
+    Vec4 planes[6];
+    frustum_planes(world_to_clip, planes);
+    struct Scene_Bounds* bounds = &scene->bounds;
+    struct Frustum_Cull_Stats stats = {0};
+    if (UseSceneBvh && scene->bvh.nodes)
+        frustum_cull_bvh(scene, planes, &stats);
+    else
+    {
+        for (size_t i = 0; i < bounds->padded_count; i += 4)
+            frustum_cull_x4(scene, planes, i);
+    }
+
+    for (size_t i = 0; i < bounds->count; i++)
+        stats.visible += bounds->visible[i];
+    stats.culled = bounds->count - stats.visible;
+    stats.milliseconds = (double)(GetRdtsc() - start) / (double)GetRdtscFreq() * 1000.0;
+    return stats;
+}
+// Deep copy of a node tree for benchmarks. Mesh parts are copied so every copy gets its own bounds slot,
+// the vertex and index data they point to stays shared with the source.
+struct Node* node_replicate(struct Node* source, struct Node* parent, struct Arena* arena)
+{
+    struct Node* node = node_create(arena);
+    *node = *source;
+    node->parent = parent;
+    if (source->type == NODE_TYPE_MESH && source->mesh.mesh_parts_count > 0)
+    {
+        node->mesh.mesh_parts = arena_alloc(arena, source->mesh.mesh_parts_count * sizeof(struct Mesh_Part));
+        memcpy(node->mesh.mesh_parts, source->mesh.mesh_parts, source->mesh.mesh_parts_count * sizeof(struct Mesh_Part));
+    }
+    if (source->child_count > 0)
+    {
+        node->child_array = arena_alloc(arena, source->child_count * sizeof(struct Node*));
+        for (size_t i = 0; i < source->child_count; i++)
+            node->child_array[i] = node_replicate(source->child_array[i], node, arena);
+    }
+    return node;
+}
+// Lays out enough copies of the scene at path on a grid to reach instance_target mesh parts, then compares
+// flat and BVH culling over a fixed set of views, and refitting against rebuilding after some copies move.
+void benchmark_scene_bvh(char* path, struct Thread_Pool* thread_pool, size_t instance_target)
+{
+    struct Scene* source = load_fbx(path, thread_pool);
+    scene_build_bvh(source);
+    Vec3 source_size = SubV3(source->bvh.nodes[0].max, source->bvh.nodes[0].min);
+    float spacing = max(source_size.X, source_size.Z) * 1.1f;
+    size_t copies = max((instance_target + source->bounds.count - 1) / max(source->bounds.count, 1), 1);
+    size_t side = (size_t)ceil(sqrt((double)copies));
+
+    struct Scene* scene = calloc(1, sizeof(struct Scene));
+    scene->arena = arena_create(0);
+    scene->root = node_create(scene->arena);
+    *scene->root = (struct Node){
+        .type = NODE_TYPE_EMPTY,
+        .name = arena_strdup(scene->arena, "Replicas"),
+        .local_rotation = { 0.0f, 0.0f, 0.0f, 1.0f },
+        .local_scale = V3(1.0f, 1.0f, 1.0f),
+        .geometry_rotation = { 0.0f, 0.0f, 0.0f, 1.0f },
+        .geometry_scale = V3(1.0f, 1.0f, 1.0f),
+        .child_array = arena_alloc(scene->arena, copies * sizeof(struct Node*)),
+        .child_count = copies,
+    };
+    for (size_t i = 0; i < copies; i++)
+    {
+        struct Node* copy = node_replicate(source->root, scene->root, scene->arena);
+        copy->local_position = AddV3(copy->local_position, V3((float)(i % side) * spacing, 0.0f, (float)(i / side) * spacing));
+        scene->root->child_array[i] = copy;
+    }
+    scene_flatten(scene);
+    scene_flatten_bounds(scene);
+    scene_update_world_transforms(scene);
+
+    unsigned long long timestamp1 = GetRdtsc();
+    scene_build_bvh(scene);
+    unsigned long long timestamp2 = GetRdtsc();
+    printf("Scene BVH: %zu copies, %zu parts, %zu nodes, build ms: %.3f\n", copies, scene->bounds.count, scene->bvh.node_count, (double)(timestamp2 - timestamp1) / GetRdtscFreq() * 1000.0);
+
+    // Views spread over the grid by low discrepancy sequences, so every run sees the same ones.
+    enum { VIEW_COUNT = 64 };
+    Vec3 scene_min = scene->bvh.nodes[0].min;
+    Vec3 scene_size = SubV3(scene->bvh.nodes[0].max, scene_min);
+    Mat4 projection = Perspective_LH_ZO(AngleDeg(70.0f), 16.0f/9.0f, 0.1f, 1000.0f);
+    Mat4* views = malloc(VIEW_COUNT * sizeof(Mat4));
+    for (int v = 0; v < VIEW_COUNT; v++)
+    {
+        float u = fmodf((float)v * 0.618034f, 1.0f);
+        float w = fmodf((float)v * 0.754878f, 1.0f);
+        Vec3 position = AddV3(scene_min, V3(scene_size.X * u, scene_size.Y * 0.25f, scene_size.Z * w));
+        Mat4 camera = MulM4(Translate(position), Rotate_RH(AngleDeg((float)v * 137.5f), V3(0.0f, 1.0f, 0.0f)));
+        views[v] = MulM4(projection, InvGeneralM4(camera));
+    }
+
+    unsigned char* flat_visible = malloc(scene->bounds.padded_count);
+    double flat_ms = 0.0, bvh_ms = 0.0;
+    size_t flat_count = 0, bvh_count = 0, nodes_tested = 0, missed = 0;
+    int use_scene_bvh = UseSceneBvh;
+    for (int v = 0; v < VIEW_COUNT; v++)
+    {
+        UseSceneBvh = 0;
+        struct Frustum_Cull_Stats flat = frustum_cull(scene, views[v]);
+        memcpy(flat_visible, scene->bounds.visible, scene->bounds.padded_count);
+        UseSceneBvh = 1;
+        struct Frustum_Cull_Stats hierarchical = frustum_cull(scene, views[v]);
+
+        flat_ms += flat.milliseconds;
+        bvh_ms += hierarchical.milliseconds;
+        flat_count += flat.visible;
+        bvh_count += hierarchical.visible;
+        nodes_tested += hierarchical.nodes_tested;
+        for (size_t i = 0; i < scene->bounds.count; i++)
+        {
+            if (flat_visible[i] && !scene->bounds.visible[i])
+                missed++;
+        }
+    }
+    printf("Scene BVH cull per view: flat ms: %.4f  bvh ms: %.4f  speedup: %.2fx  visible flat: %zu bvh: %zu  nodes tested: %zu  missed: %zu\n",
+        flat_ms / VIEW_COUNT, bvh_ms / VIEW_COUNT, flat_ms / bvh_ms, flat_count / VIEW_COUNT, bvh_count / VIEW_COUNT, nodes_tested / VIEW_COUNT, missed);
+
+    // Lift every 100th copy and compare refitting to rebuilding, then cull again on the refitted tree.
+    size_t moved = 0;
+    for (size_t i = 0; i < copies; i += 100, moved++)
+    {
+        struct Node* copy = scene->root->child_array[i];
+        scene_set_local_transform(scene, copy, AddV3(copy->local_position, V3(0.0f, spacing * 0.5f, 0.0f)), copy->local_rotation, copy->local_scale);
+    }
+    unsigned long long timestamp3 = GetRdtsc();
+    scene_update_dirty_transforms(scene);
+    unsigned long long timestamp4 = GetRdtsc();
+    scene_refit_bvh(scene);
+    unsigned long long timestamp5 = GetRdtsc();
+    double refit_cull_ms = 0.0;
+    for (int v = 0; v < VIEW_COUNT; v++)
+        refit_cull_ms += frustum_cull(scene, views[v]).milliseconds;
+    unsigned long long timestamp6 = GetRdtsc();
+    scene_build_bvh(scene);
+    unsigned long long timestamp7 = GetRdtsc();
+    double rebuild_cull_ms = 0.0;
+    for (int v = 0; v < VIEW_COUNT; v++)
+        rebuild_cull_ms += frustum_cull(scene, views[v]).milliseconds;
+    printf("Scene BVH %zu copies moved: transforms ms: %.4f  refit ms: %.4f  rebuild ms: %.3f  cull ms after refit: %.4f  after rebuild: %.4f\n", moved,
+        (double)(timestamp4 - timestamp3) / GetRdtscFreq() * 1000.0, (double)(timestamp5 - timestamp4) / GetRdtscFreq() * 1000.0, (double)(timestamp7 - timestamp6) / GetRdtscFreq() * 1000.0,
+        refit_cull_ms / VIEW_COUNT, rebuild_cull_ms / VIEW_COUNT);
+
+    UseSceneBvh = use_scene_bvh;
+    free(flat_visible);
+    free(views);
+    scene_destroy(scene);
+    scene_destroy(source);
+}
+// Software occlusion culling: the parts that cover the most of the screen are rasterized on the CPU into
+// a small depth buffer, then every part that survived frustum culling is tested against it by the screen
+// rectangle and nearest depth of its world box. Occluders are assumed opaque, so parts with an alpha
+// tested color texture (Texture::has_alpha) are never picked as one.
+static int UseOcclusionCulling = 1;
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 144
+#define OCCLUSION_TILE_WIDTH 64
+#define OCCLUSION_TILE_HEIGHT 48
+#define OCCLUSION_TILES_X (OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH)
+#define OCCLUSION_TILES_Y (OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT)
+#define OCCLUSION_MAX_OCCLUDERS 64
+#define OCCLUSION_MAX_OCCLUDER_TRIANGLES 4096 // Per occluder, denser parts cost more than they hide.
+#define OCCLUSION_MAX_TRIANGLES 16384
+struct Occlusion_Triangle
+{
+    float x[3], y[3], z[3]; // Depth buffer pixels and z/w, dropped triangles are moved off the left edge.
+};
+struct Occlusion_Cull_Stats
+{
+    size_t occluders;
+    size_t triangles;
+    size_t tested;
+    size_t occluded;
+    double raster_milliseconds;
+    double test_milliseconds;
+};
+struct Occlusion_Culler
+{
+    float* depth; // z/w, OCCLUSION_WIDTH * OCCLUSION_HEIGHT, cleared to 1 every frame.
+    struct Occlusion_Triangle* triangles;
+    size_t triangle_capacity;
+
+    // Filled per frame for the tasks.
+    struct Scene* scene;
+    Mat4 world_to_clip;
+    unsigned int occluders[OCCLUSION_MAX_OCCLUDERS];
+    size_t occluder_triangle_offset[OCCLUSION_MAX_OCCLUDERS + 1];
+    size_t occluder_count;
+};
+struct Occlusion_Culler occlusion_culler_create(void)
+{
+    struct Occlusion_Culler culler = {0};
+    culler.depth = malloc(OCCLUSION_WIDTH * OCCLUSION_HEIGHT * sizeof(float));
+    return culler;
+}
+void occlusion_culler_destroy(struct Occlusion_Culler* culler)
+{
+    free(culler->depth);
+    free(culler->triangles);
+    *culler = (struct Occlusion_Culler){0};
+}
+// Projects one occluder's LOD0 triangles into its slice of culler->triangles.
+void occlusion_transform_task(void* user, size_t index)
+{
+    struct Occlusion_Culler* culler = user;
+    struct Scene* scene = culler->scene;
+    unsigned int part = culler->occluders[index];
+    struct Mesh_Part* mesh_part = scene->bounds.mesh_parts[part];
+    Mat4 object_to_clip = MulM4(culler->world_to_clip, scene->transforms.world_geometry[scene->bounds.transform_index[part]]);
+    struct Occlusion_Triangle* triangle = culler->triangles + culler->occluder_triangle_offset[index];
+    for (size_t t = 0; t < mesh_part->index_count; t += 3, triangle++)
+    {
+        int dropped = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            Vec4 clip = MulM4V4(object_to_clip, V4V(mesh_part->vertex_array[mesh_part_get_index(mesh_part, t + k)].pos, 1.0f));
+            // Dropping a triangle only ever hides less, so the ones crossing the near plane (z = 0 for the
+            // Perspective_LH_ZO camera) are simply skipped. In front of it w is at least the near distance.
+            if (clip.Z < 0.0f)
+            {
+                dropped = 1;
+                break;
+            }
+            float inverse_w = 1.0f / clip.W;
+            triangle->x[k] = (clip.X * inverse_w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+            triangle->y[k] = (0.5f - clip.Y * inverse_w * 0.5f) * OCCLUSION_HEIGHT;
+            triangle->z[k] = clip.Z * inverse_w;
+        }
+        if (dropped)
+            *triangle = (struct Occlusion_Triangle){ .x = { -1.0f, -1.0f, -1.0f } };
+    }
+}
+// Rasterizes every triangle overlapping one tile, 4 pixels at a time, keeping the nearest depth.
+void occlusion_raster_tile_task(void* user, size_t tile)
+{
+    struct Occlusion_Culler* culler = user;
+    int tile_x0 = (int)(tile % OCCLUSION_TILES_X) * OCCLUSION_TILE_WIDTH;
+    int tile_y0 = (int)(tile / OCCLUSION_TILES_X) * OCCLUSION_TILE_HEIGHT;
+    int tile_x1 = tile_x0 + OCCLUSION_TILE_WIDTH;
+    int tile_y1 = tile_y0 + OCCLUSION_TILE_HEIGHT;
+    for (int y = tile_y0; y < tile_y1; y++)
+        for (int x = tile_x0; x < tile_x1; x += 4)
+            _mm_storeu_ps(culler->depth + y * OCCLUSION_WIDTH + x, _mm_set1_ps(1.0f));
+
+    size_t triangle_count = culler->occluder_triangle_offset[culler->occluder_count];
+    __m128 lane_offset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 zero = _mm_setzero_ps();
+    for (size_t i = 0; i < triangle_count; i++)
+    {
+        struct Occlusion_Triangle* triangle = &culler->triangles[i];
+        float area = (triangle->x[1] - triangle->x[0]) * (triangle->y[2] - triangle->y[0]) - (triangle->y[1] - triangle->y[0]) * (triangle->x[2] - triangle->x[0]);
+        if (fabsf(area) < 1e-6f)
+            continue;
+
+        // Pixel centers inside the triangle, the box rounded out to whole groups of 4.
+        int x0 = max((int)floorf(min(triangle->x[0], min(triangle->x[1], triangle->x[2])) - 0.5f) & ~3, tile_x0);
+        int x1 = min((int)ceilf(max(triangle->x[0], max(triangle->x[1], triangle->x[2])) - 0.5f), tile_x1 - 1);
+        int y0 = max((int)floorf(min(triangle->y[0], min(triangle->y[1], triangle->y[2])) - 0.5f), tile_y0);
+        int y1 = min((int)ceilf(max(triangle->y[0], max(triangle->y[1], triangle->y[2])) - 0.5f), tile_y1 - 1);
+        if (x0 > x1 || y0 > y1)
+            continue;
+
+        // Edge k is opposite vertex k, scaled so each edge function is that vertex's barycentric weight.
+        float inverse_area = 1.0f / area;
+        __m128 edge_dx[3], edge_dy[3], edge_c[3];
+        for (int k = 0; k < 3; k++)
+        {
+            int a = (k + 1) % 3, b = (k + 2) % 3;
+            float dx = (triangle->y[a] - triangle->y[b]) * inverse_area;
+            float dy = (triangle->x[b] - triangle->x[a]) * inverse_area;
+            edge_dx[k] = _mm_set1_ps(dx);
+            edge_dy[k] = _mm_set1_ps(dy);
+            edge_c[k] = _mm_set1_ps(-(dx * triangle->x[a] + dy * triangle->y[a]));
+        }
+        __m128 z0 = _mm_set1_ps(triangle->z[0]), z1 = _mm_set1_ps(triangle->z[1]), z2 = _mm_set1_ps(triangle->z[2]);
+
+        for (int y = y0; y <= y1; y++)
+        {
+            __m128 pixel_y = _mm_set1_ps((float)y + 0.5f);
+            float* row = culler->depth + y * OCCLUSION_WIDTH;
+            for (int x = x0; x <= x1; x += 4)
+            {
+                __m128 pixel_x = _mm_add_ps(_mm_set1_ps((float)x), lane_offset);
+                __m128 weight[3];
+                for (int k = 0; k < 3; k++)
+                    weight[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge_dx[k], pixel_x), _mm_mul_ps(edge_dy[k], pixel_y)), edge_c[k]);
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(weight[0], zero), _mm_cmpge_ps(weight[1], zero)), _mm_cmpge_ps(weight[2], zero));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+
+                __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(weight[0], z0), _mm_mul_ps(weight[1], z1)), _mm_mul_ps(weight[2], z2));
+                __m128 old_depth = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_and_ps(inside, _mm_cmplt_ps(depth, old_depth));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(nearer, depth), _mm_andnot_ps(nearer, old_depth)));
+            }
+        }
+    }
+}
+// 1 when every depth buffer pixel the world box could touch is nearer than the box's nearest corner.
+int occlusion_box_occluded(struct Occlusion_Culler* culler, Vec3 box_min, Vec3 box_max)
+{
+    float screen_min_x = FLT_MAX, screen_min_y = FLT_MAX, screen_max_x = -FLT_MAX, screen_max_y = -FLT_MAX;
+    float nearest = FLT_MAX;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        Vec3 position = V3(corner & 1 ? box_max.X : box_min.X, corner & 2 ? box_max.Y : box_min.Y, corner & 4 ? box_max.Z : box_min.Z);
+        Vec4 clip = MulM4V4(culler->world_to_clip, V4V(position, 1.0f));
+        if (clip.Z < 0.0f) // Reaches past the near plane.
+            return 0;
+        float inverse_w = 1.0f / clip.W;
+        float x = (clip.X * inverse_w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        float y = (0.5f - clip.Y * inverse_w * 0.5f) * OCCLUSION_HEIGHT;
+        screen_min_x = min(screen_min_x, x);
+        screen_max_x = max(screen_max_x, x);
+        screen_min_y = min(screen_min_y, y);
+        screen_max_y = max(screen_max_y, y);
+        nearest = min(nearest, clip.Z * inverse_w);
+    }
+
+    // Every pixel the rectangle touches, not only the ones whose centers it covers.
+    int x0 = max((int)floorf(screen_min_x), 0) & ~3;
+    int x1 = min((int)floorf(screen_max_x), OCCLUSION_WIDTH - 1);
+    int y0 = max((int)floorf(screen_min_y), 0);
+    int y1 = min((int)floorf(screen_max_y), OCCLUSION_HEIGHT - 1);
+    if (x0 > x1 || y0 > y1)
+        return 0;
+
+    __m128 box_depth = _mm_set1_ps(nearest);
+    __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 last_x = _mm_set1_ps((float)x1);
+    for (int y = y0; y <= y1; y++)
+    {
+        const float* row = culler->depth + y * OCCLUSION_WIDTH;
+        for (int x = x0; x <= x1; x += 4)
+        {
+            // Lanes past x1 are ignored, the buffer width is a multiple of 4 so they are still in the row.
+            __m128 in_rect = _mm_cmple_ps(_mm_add_ps(_mm_set1_ps((float)x), lane), last_x);
+            __m128 visible = _mm_and_ps(in_rect, _mm_cmpge_ps(_mm_loadu_ps(row + x), box_depth));
+            if (_mm_movemask_ps(visible))
+                return 0;
+        }
+    }
+    return 1;
 }
+// Runs after frustum_cull and clears scene->bounds.visible for the parts hidden behind the biggest visible ones.
+struct Occlusion_Cull_Stats occlusion_cull(struct Occlusion_Culler* culler, struct Scene* scene, Mat4 world_to_clip, Vec3 camera_position, struct Thread_Pool* thread_pool)
+{
+    struct Occlusion_Cull_Stats stats = {0};
+    struct Scene_Bounds* bounds = &scene->bounds;
+    culler->scene = scene;
+    culler->world_to_clip = world_to_clip;
+    unsigned long long timestamp1 = GetRdtsc();
+
+    // Keep the visible parts with the largest projected size, a world box diagonal squared over distance squared.
+    float scores[OCCLUSION_MAX_OCCLUDERS];
+    culler->occluder_count = 0;
+    for (size_t i = 0; i < bounds->count; i++)
+    {
+        struct Mesh_Part* mesh_part = bounds->mesh_parts[i];
+        if (!bounds->visible[i] || mesh_part->index_count == 0 || mesh_part->index_count / 3 > OCCLUSION_MAX_OCCLUDER_TRIANGLES)
+            continue;
+        if (mesh_part->color_texture && mesh_part->color_texture->has_alpha) // Alpha tested, see through in places.
+            continue;
+
+        Vec3 box_min, box_max;
+        mesh_part_world_box(mesh_part, &scene->transforms.world_geometry[bounds->transform_index[i]], &box_min, &box_max);
+        Vec3 center = MulV3F(AddV3(box_min, box_max), 0.5f);
+        float score = LenSqrV3(SubV3(box_max, box_min)) / max(LenSqrV3(SubV3(center, camera_position)), 1e-4f);
+        if (culler->occluder_count == OCCLUSION_MAX_OCCLUDERS && score <= scores[OCCLUSION_MAX_OCCLUDERS - 1])
+            continue;
+
+        size_t slot = min(culler->occluder_count, OCCLUSION_MAX_OCCLUDERS - 1);
+        for (; slot > 0 && scores[slot - 1] < score; slot--)
+        {
+            scores[slot] = scores[slot - 1];
+            culler->occluders[slot] = culler->occluders[slot - 1];
+        }
+        scores[slot] = score;
+        culler->occluders[slot] = (unsigned int)i;
+        culler->occluder_count = min(culler->occluder_count + 1, OCCLUSION_MAX_OCCLUDERS);
+    }
+
+    // Best first until the triangle budget runs out.
+    culler->occluder_triangle_offset[0] = 0;
+    for (size_t i = 0; i < culler->occluder_count; i++)
+    {
+        size_t end = culler->occluder_triangle_offset[i] + bounds->mesh_parts[culler->occluders[i]]->index_count / 3;
+        if (end > OCCLUSION_MAX_TRIANGLES)
+        {
+            culler->occluder_count = i;
+            break;
+        }
+        culler->occluder_triangle_offset[i + 1] = end;
+    }
+    size_t triangle_count = culler->occluder_triangle_offset[culler->occluder_count];
+    if (triangle_count > culler->triangle_capacity)
+    {
+        culler->triangle_capacity = triangle_count;
+        culler->triangles = realloc(culler->triangles, triangle_count * sizeof(struct Occlusion_Triangle));
+    }
+    thread_pool_for(thread_pool, occlusion_transform_task, culler, culler->occluder_count);
+    thread_pool_for(thread_pool, occlusion_raster_tile_task, culler, OCCLUSION_TILES_X * OCCLUSION_TILES_Y);
+    unsigned long long timestamp2 = GetRdtsc();
+
+    for (size_t i = 0; i < bounds->count; i++)
+    {
+        if (!bounds->visible[i] || bounds->mesh_parts[i]->index_count == 0)
+            continue;
+
+        Vec3 box_min, box_max;
+        mesh_part_world_box(bounds->mesh_parts[i], &scene->transforms.world_geometry[bounds->transform_index[i]], &box_min, &box_max);
+        stats.tested++;
+        if (occlusion_box_occluded(culler, box_min, box_max))
+        {
+            bounds->visible[i] = 0;
+            stats.occluded++;
+        }
+    }
+    unsigned long long timestamp3 = GetRdtsc();
 
-void draw_node(struct Node* node, struct Device* device, struct Command_List* command_list)
+    stats.occluders = culler->occluder_count;
+    stats.triangles = triangle_count;
+    stats.raster_milliseconds = (double)(timestamp2 - timestamp1) / GetRdtscFreq() * 1000.0;
+    stats.test_milliseconds = (double)(timestamp3 - timestamp2) / GetRdtscFreq() * 1000.0;
+    return stats;
+}
+// What draw_node needs to know about the camera to pick each part's LOD.
+struct Lod_View
+{
+    Vec3 camera_position;
+    float pixels_per_unit; // Height in pixels of one unit seen from one unit away, projection[1][1] * viewport height / 2.
+};
+// The coarsest LOD whose error, projected at the near side of the part's bounding sphere, stays under LodErrorPixels.
+unsigned int select_lod(struct Scene* scene, struct Node* node, struct Mesh_Part* mesh_part, struct Lod_View* view)
+{
+    if (mesh_part->lod_count <= 1 || LodErrorPixels <= 0.0f)
+        return 0;
+
+    Mat4 world = scene->transforms.world_geometry[node->transform_index];
+    float scale = max(LenV3(world.Columns[0].XYZ), max(LenV3(world.Columns[1].XYZ), LenV3(world.Columns[2].XYZ)));
+    Vec3 center = MulM4V4(world, V4V(AddV3(mesh_part->position_min, MulV3F(mesh_part->position_extent, 0.5f)), 1.0f)).XYZ;
+    float radius = mesh_part->bounding_radius * scale;
+    float distance = max(LenV3(SubV3(center, view->camera_position)) - radius, 1e-3f);
+
+    unsigned int lod = 0;
+    while (lod + 1 < mesh_part->lod_count && mesh_part->lod_array[lod + 1].error * scale / distance * view->pixels_per_unit <= LodErrorPixels)
+        lod++;
+    return lod;
+}
+void draw_node(struct Scene* scene, struct Node* node, struct Lod_View* view, struct Device* device, struct Command_List* command_list)
 {
     if (node->type == NODE_TYPE_MESH)
     {
@@ -1112,6 +7154,10 @@ void draw_node(struct Node* node, struct Device* device, struct Command_List* co
             struct Mesh_Part* mesh_part = &node->mesh.mesh_parts[i];
             if (mesh_part->vertex_count == 0 || mesh_part->index_count == 0)
                 continue;
+            if (UseFrustumCulling && !scene->bounds.visible[mesh_part->bounds_index])
+                continue;
+
+            struct Mesh_Lod lod = mesh_part->lod_count ? mesh_part->lod_array[select_lod(scene, node, mesh_part, view)] : (struct Mesh_Lod){ .index_count = mesh_part->index_count };
 
             command_list_set_constant_buffer(command_list, mesh_part->cbv, 0);
             if (mesh_part->color_texture)
@@ -1119,15 +7165,15 @@ void draw_node(struct Node* node, struct Device* device, struct Command_List* co
             if (mesh_part->normal_texture)
                 command_list_set_texture_buffer(command_list, mesh_part->normal_texture->srv, 6);
             command_list_set_primitive_topology(command_list, PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-            command_list_set_vertex_buffer(command_list, mesh_part->vertex_buffer, sizeof(struct Vertex) * mesh_part->vertex_count, sizeof(struct Vertex));
-            command_list_set_index_buffer(command_list, mesh_part->index_buffer, sizeof(unsigned int) * mesh_part->index_count, FORMAT_R32_UINT);
-            command_list_draw_indexed_instanced(command_list, mesh_part->index_count, 1, 0, 0, 0);
+            command_list_set_vertex_buffer(command_list, mesh_part->vertex_buffer, vertex_stride() * mesh_part->vertex_count, vertex_stride());
+            command_list_set_index_buffer(command_list, mesh_part->index_buffer, mesh_part_index_size(mesh_part) * mesh_part_total_index_count(mesh_part), mesh_part_index_format(mesh_part));
+            command_list_draw_indexed_instanced(command_list, lod.index_count, 1, lod.index_offset, 0, 0);
         }
     }
 
     for (size_t i = 0; i < node->child_count; i++)
     {
-        draw_node(node->child_array[i], device, command_list);
+        draw_node(scene, node->child_array[i], view, device, command_list);
     }
 }
 
@@ -1136,6 +7182,37 @@ void setup_shader_and_pso(struct Device* device, enum FORMAT swapchain_format, s
     if(device_create_shader(device, out_shader))
         return;
 
+    struct Input_Element_Descriptor compact_input_element_descriptors[] = {
+        {
+            .element_binding.name = "POS",
+            .format = FORMAT_R16G16B16A16_UNORM,
+            .element_classification = INPUT_ELEMENT_CLASSIFICATION_PER_VERTEX,
+        },
+        {
+            .element_binding.name = "COL",
+            .format = FORMAT_R8G8B8A8_UNORM,
+            .element_classification = INPUT_ELEMENT_CLASSIFICATION_PER_VERTEX,
+            .offset = offsetof(struct Compact_Vertex, color)
+        },
+        {
+            .element_binding.name = "NORMAL",
+            .format = FORMAT_R16G16_SNORM,
+            .element_classification = INPUT_ELEMENT_CLASSIFICATION_PER_VERTEX,
+            .offset = offsetof(struct Compact_Vertex, normal)
+        },
+        {
+            .element_binding.name = "TANGENT",
+            .format = FORMAT_R16G16_SNORM,
+            .element_classification = INPUT_ELEMENT_CLASSIFICATION_PER_VERTEX,
+            .offset = offsetof(struct Compact_Vertex, tangent)
+        },
+        {
+            .element_binding.name = "UV",
+            .format = FORMAT_R16G16_FLOAT,
+            .element_classification = INPUT_ELEMENT_CLASSIFICATION_PER_VERTEX,
+            .offset = offsetof(struct Compact_Vertex, uv)
+        },
+    };
     struct Input_Element_Descriptor input_element_descriptors[] = {
         {
             .element_binding.name = "POS",
@@ -1187,8 +7264,8 @@ void setup_shader_and_pso(struct Device* device, enum FORMAT swapchain_format, s
         .depth_stencil_descriptor.back_face_op.stencil_depth_fail_op = STENCIL_OP_KEEP,
         .depth_stencil_descriptor.back_face_op.stencil_fail_op = STENCIL_OP_KEEP,
         .depth_stencil_descriptor.back_face_op.stencil_pass_op = STENCIL_OP_KEEP,
-        .input_element_descriptors = input_element_descriptors,
-        .input_element_descriptors_count = ARRAYSIZE(input_element_descriptors),
+        .input_element_descriptors = UseCompactVertices ? compact_input_element_descriptors : input_element_descriptors,
+        .input_element_descriptors_count = UseCompactVertices ? ARRAYSIZE(compact_input_element_descriptors) : ARRAYSIZE(input_element_descriptors),
         .primitive_topology_type = PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE,
         .render_target_count = 1,
         .render_target_formats[0] = swapchain_format,
@@ -1405,8 +7482,103 @@ int CALLBACK WinMain(HINSTANCE CurrentInstance, HINSTANCE PrevInstance, LPSTR Co
     #else
     char* asset_path = get_asset_path("Sphere_High.fbx");
     #endif
-    struct Node* scene_node = load_fbx(asset_path);
-    scene_node->local_scale = V3(0.5f, 0.5f, 0.5f);
+
+    // #define FBX_LOAD_BENCHMARK
+    #ifdef FBX_LOAD_BENCHMARK
+    benchmark_fbx_load(asset_path);
+    #endif
+
+    struct Thread_Pool* thread_pool = thread_pool_create(0);
+
+    // #define FBX_STREAM_BENCHMARK
+    #ifdef FBX_STREAM_BENCHMARK
+    benchmark_fbx_stream(asset_path, thread_pool);
+    #endif
+
+    // #define MESH_PART_LOAD_BENCHMARK
+    #ifdef MESH_PART_LOAD_BENCHMARK
+    benchmark_mesh_part_load(asset_path, thread_pool);
+    #endif
+
+    // #define MESH_OPTIMIZATION_BENCHMARK
+    #ifdef MESH_OPTIMIZATION_BENCHMARK
+    benchmark_mesh_optimization(thread_pool);
+    #endif
+
+    // #define VERTEX_WELDING_BENCHMARK
+    #ifdef VERTEX_WELDING_BENCHMARK
+    benchmark_vertex_welding(asset_path);
+    #endif
+
+    // #define TANGENT_BENCHMARK
+    #ifdef TANGENT_BENCHMARK
+    benchmark_tangents(thread_pool);
+    #endif
+
+    // #define TEXTURE_BINDING_BENCHMARK
+    #ifdef TEXTURE_BINDING_BENCHMARK
+    benchmark_texture_binding(asset_path);
+    #endif
+
+    // #define DDS_LOAD_BENCHMARK
+    #ifdef DDS_LOAD_BENCHMARK
+    benchmark_dds_load();
+    #endif
+
+    // #define TEXTURE_COMPRESSION_BENCHMARK
+    #ifdef TEXTURE_COMPRESSION_BENCHMARK
+    benchmark_texture_compression(thread_pool);
+    #endif
+
+    // #define SCENE_RELOAD_BENCHMARK
+    #ifdef SCENE_RELOAD_BENCHMARK
+    benchmark_scene_reload(asset_path, thread_pool, 16);
+    #endif
+
+    // #define SCENE_BVH_BENCHMARK
+    #ifdef SCENE_BVH_BENCHMARK
+    {
+        char* bistro_path = get_asset_path("BistroExterior.fbx");
+        benchmark_scene_bvh(bistro_path, thread_pool, 50000);
+        free(bistro_path);
+    }
+    #endif
+
+    struct Scene* scene = load_fbx(asset_path, thread_pool);
+    struct Node* scene_node = scene->root;
+
+    // #define INDEX_MEMORY_REPORT
+    #ifdef INDEX_MEMORY_REPORT
+    report_index_memory(scene_node);
+    #endif
+
+    // #define LOD_REPORT
+    #ifdef LOD_REPORT
+    report_lods(scene_node);
+    #endif
+
+    // #define STATIC_BATCHING
+    #ifdef STATIC_BATCHING
+    build_static_batches(scene);
+    #endif
+
+    // #define COMPACT_VERTEX_CHECK
+    #ifdef COMPACT_VERTEX_CHECK
+    check_compact_vertices(scene_node);
+    #endif
+
+    // #define MESHLET_CHECK
+    #ifdef MESHLET_CHECK
+    check_meshlets(scene_node);
+    #endif
+
+    // #define TRANSFORM_BENCHMARK
+    #ifdef TRANSFORM_BENCHMARK
+    benchmark_transforms(scene, 100);
+    #endif
+    scene_set_local_transform(scene, scene_node, scene_node->local_position, scene_node->local_rotation, V3(0.5f, 0.5f, 0.5f));
+    scene_update_world_transforms(scene);
+    scene_build_bvh(scene);
     free(asset_path);
 
     {
@@ -1415,7 +7587,7 @@ int CALLBACK WinMain(HINSTANCE CurrentInstance, HINSTANCE PrevInstance, LPSTR Co
 
         command_list_reset(upload_command_list);
 
-        upload_node_buffers(scene_node, device, upload_command_list, cbv_srv_uav_descriptor_set);
+        upload_node_buffers(scene_node, scene, device, upload_command_list, cbv_srv_uav_descriptor_set, thread_pool);
 
         // Load eo_lut
         {
@@ -1475,6 +7647,11 @@ int CALLBACK WinMain(HINSTANCE CurrentInstance, HINSTANCE PrevInstance, LPSTR Co
     
     double frame_time_buffer[32] = {0};
     int frame_time_buffer_count = 0;
+    struct Frustum_Cull_Stats cull_stats = {0};
+    double cull_milliseconds_total = 0.0;
+    struct Occlusion_Culler occlusion_culler = occlusion_culler_create();
+    struct Occlusion_Cull_Stats occlusion_stats = {0};
+    double occlusion_milliseconds_total = 0.0;
     double frame_time = 0.0f;
     unsigned long long frame_counter = 0;
     FILETIME lastWrite = {0};
@@ -1514,6 +7691,11 @@ int CALLBACK WinMain(HINSTANCE CurrentInstance, HINSTANCE PrevInstance, LPSTR Co
             camera_pitch += 40.0f * (float)frame_time;
         if (keyboard_input['X'])
             camera_pitch -= 40.0f * (float)frame_time;
+        if (keyboard_input['R'])
+        {
+            Quat spin = QFromAxisAngle_RH((Vec3){ 0.0f, 1.0f, 0.0f }, AngleDeg(40.0f * (float)frame_time));
+            scene_set_local_transform(scene, scene_node, scene_node->local_position, MulQ(spin, scene_node->local_rotation), scene_node->local_scale);
+        }
 
         int backbuffer_index = swapchain_get_current_backbuffer_index(swapchain);
         
@@ -1523,6 +7705,8 @@ int CALLBACK WinMain(HINSTANCE CurrentInstance, HINSTANCE PrevInstance, LPSTR Co
         struct Depth_Stencil_View* dsv = depth_stencil_views[backbuffer_index];
         struct Buffer_Descriptor backbuffer_description = buffer_get_descriptor(render_target_view_get_buffer(backbuffer_rtv));
 
+        struct Lod_View lod_view;
+        Mat4 world_to_clip;
         struct Viewport viewport = {
             .width = (float)backbuffer_description.width,
             .height = (float)backbuffer_description.height,
@@ -1552,8 +7736,13 @@ int CALLBACK WinMain(HINSTANCE CurrentInstance, HINSTANCE PrevInstance, LPSTR Co
             Mat4 camera_rotation_pitch = Rotate_RH(AngleDeg(camera_pitch), (Vec3){ 1.0f, 0.0f, 0.0f });
             camera_transform = MulM4(camera_translation, MulM4(camera_rotation_yaw, camera_rotation_pitch));
             Mat4 camera_projection = Perspective_LH_ZO(AngleDeg(70.0f), 16.0f/9.0f, 0.1f, 1000.0f);
+            lod_view = (struct Lod_View){
+                .camera_position = camera_position,
+                .pixels_per_unit = camera_projection.Elements[1][1] * viewport.height * 0.5f,
+            };
+            world_to_clip = MulM4(camera_projection, InvGeneralM4(camera_transform));
             struct Main_Constant constant = { 
-                .world_to_clip = MulM4(camera_projection, InvGeneralM4(camera_transform)),
+                .world_to_clip = world_to_clip,
                 .camera_position = camera_position,
                 .lights = 1
             };
@@ -1573,7 +7762,22 @@ int CALLBACK WinMain(HINSTANCE CurrentInstance, HINSTANCE PrevInstance, LPSTR Co
         command_list_set_texture_buffer(command_list, eavg_lut_srv, 3);
         command_list_set_texture_buffer(command_list, eo_lut_srv, 4);
         command_list_set_constant_buffer(command_list, camera_cbv, 1);
-        draw_node(scene_node, device, command_list);
+
+        scene_update_dirty_transforms(scene);
+        scene_refit_bvh(scene);
+        upload_changed_transforms(scene, command_list);
+
+        if (UseFrustumCulling)
+        {
+            cull_stats = frustum_cull(scene, world_to_clip);
+            cull_milliseconds_total += cull_stats.milliseconds;
+            if (UseOcclusionCulling)
+            {
+                occlusion_stats = occlusion_cull(&occlusion_culler, scene, world_to_clip, camera_position, thread_pool);
+                occlusion_milliseconds_total += occlusion_stats.raster_milliseconds + occlusion_stats.test_milliseconds;
+            }
+        }
+        draw_node(scene, scene_node, &lod_view, device, command_list);
         
         command_list_set_buffer_state(command_list, render_target_view_get_buffer(backbuffer_rtv), RESOURCE_STATE_PRESENT);
         command_list_close(command_list);
@@ -1597,10 +7801,20 @@ int CALLBACK WinMain(HINSTANCE CurrentInstance, HINSTANCE PrevInstance, LPSTR Co
                 average_frame_time += frame_time_buffer[i];
             }
             average_frame_time /= frame_time_buffer_count;
-            printf("ms: %f \r", average_frame_time * 1000.0);
+            if (UseFrustumCulling && UseOcclusionCulling)
+                printf("ms: %f parts visible: %zu culled: %zu bvh nodes: %zu cull ms: %f occluded: %zu of %zu (%.0f%%) occluder triangles: %zu occlusion ms: %f \r", average_frame_time * 1000.0,
+                    cull_stats.visible - occlusion_stats.occluded, cull_stats.culled, cull_stats.nodes_tested, cull_milliseconds_total / frame_time_buffer_count, occlusion_stats.occluded, occlusion_stats.tested,
+                    occlusion_stats.tested ? 100.0 * (double)occlusion_stats.occluded / (double)occlusion_stats.tested : 0.0, occlusion_stats.triangles, occlusion_milliseconds_total / frame_time_buffer_count);
+            else if (UseFrustumCulling)
+                printf("ms: %f parts visible: %zu culled: %zu bvh nodes: %zu cull ms: %f \r", average_frame_time * 1000.0, cull_stats.visible, cull_stats.culled, cull_stats.nodes_tested, cull_milliseconds_total / frame_time_buffer_count);
+            else
+                printf("ms: %f \r", average_frame_time * 1000.0);
             frame_time_buffer_count = 0;
+            cull_milliseconds_total = 0.0;
+            occlusion_milliseconds_total = 0.0;
         }
     }
+    occlusion_culler_destroy(&occlusion_culler);
     
     return 0;
 }
\ No newline at end of file
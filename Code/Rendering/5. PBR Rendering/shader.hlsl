@@ -1,8 +1,9 @@
+// Either struct Vertex or struct Compact_Vertex, see compact_vertices.
 struct vs_in
 {
-    float3 pos : POS;
+    float4 pos : POS;
     float4 color : COL;
-    float3 normal : NORMAL;
+    float4 normal : NORMAL;
     float4 tangent : TANGENT;
     float2 uv : UV;
 };
@@ -46,6 +47,9 @@ cbuffer model_cbuffer : register(b0)
     uint enabled_normal_texture;
     uint enabled_roughness_texture;
     uint enabled_metallic_texture;
+    float3 position_scale;
+    uint compact_vertices;
+    float3 position_offset;
 }
 
 cbuffer main_cbuffer : register(b1)
@@ -60,16 +64,35 @@ Texture2D eo_lut : register(t2);
 Texture2D color_texture : register(t3);
 Texture2D normal_texture : register(t4);
 
+// Same as octahedral_decode in main.c.
+float3 oct_decode(float2 e)
+{
+    float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 [RootSignature("RootFlags(ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT), CBV(b0), CBV(b1), DescriptorTable(SRV(t0)), DescriptorTable(SRV(t1)), DescriptorTable(SRV(t2)), DescriptorTable(SRV(t3)), DescriptorTable(SRV(t4)), StaticSampler(s0)")]
 vs_out VSMain(vs_in In)
 {
     vs_out Out;
 
-    Out.ws_pos = mul(model_to_world, float4(In.pos, 1.0));
+    float3 pos = In.pos.xyz * position_scale + position_offset;
+    float3 normal = In.normal.xyz;
+    float4 tangent = In.tangent;
+    if (compact_vertices)
+    {
+        normal = oct_decode(In.normal.xy);
+        tangent = float4(oct_decode(In.tangent.xy), In.pos.w > 0.5 ? 1.0 : -1.0);
+    }
+
+    Out.ws_pos = mul(model_to_world, float4(pos, 1.0));
     Out.cs_pos = mul(world_to_clip, Out.ws_pos);
-    Out.ws_normal = normalize(mul(model_to_world, float4(In.normal, 0.0)));
-    Out.ws_tangent = normalize(mul(model_to_world, float4(In.tangent.xyz, 0.0)));
-    Out.ws_bitangent = normalize(mul(model_to_world, float4(cross(In.normal, In.tangent.xyz) * In.tangent.w, 0.0))); // cross(normal, tangent) * sign
+    Out.ws_normal = normalize(mul(model_to_world, float4(normal, 0.0)));
+    Out.ws_tangent = normalize(mul(model_to_world, float4(tangent.xyz, 0.0)));
+    Out.ws_bitangent = normalize(mul(model_to_world, float4(cross(normal, tangent.xyz) * tangent.w, 0.0))); // cross(normal, tangent) * sign
     Out.color = In.color;
     In.uv.y = 1.0 - In.uv.y;
     Out.uv = In.uv;
@@ -96,6 +119,7 @@ float4 PSMain(vs_out In) : SV_TARGET
     if (enabled_normal_texture)
     {
         float3 normal = normal_texture.Sample(Sampler, In.uv).rgb * 2.0 - 1.0;
+        normal.z = sqrt(saturate(1.0 - dot(normal.xy, normal.xy))); // BC5 normal maps only store x and y.
         float3x3 TBN = float3x3(
             normalize(In.ws_tangent.xyz),
             normalize(In.ws_bitangent.xyz),
@@ -11,11 +11,13 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #define WIN32_LEAN_AND_MEAN
 #define VC_EXTRALEAN
 #define NOMINMAX
 #include <Windows.h>
+#include <psapi.h>
 #include <intrin.h>
 
 unsigned long long GetRdtscFreq()
@@ -112,4 +114,509 @@ char* get_asset_path(const char* path)
     strcat(string, ASSET_PATH);
     strcat(string, path);
     return string;
-}
\ No newline at end of file
+}
+
+struct Arena_Block
+{
+    struct Arena_Block* previous;
+    size_t size;
+    size_t used;
+};
+struct Arena
+{
+    CRITICAL_SECTION lock;
+    struct Arena_Block* current;
+    size_t block_size;
+    size_t committed_size;
+};
+
+struct Arena* arena_create(size_t block_size)
+{
+    struct Arena* arena = calloc(1, sizeof(struct Arena));
+    InitializeCriticalSection(&arena->lock);
+    arena->block_size = block_size ? block_size : (64 << 20);
+    return arena;
+}
+
+void arena_destroy(struct Arena* arena)
+{
+    if (!arena)
+        return;
+
+    struct Arena_Block* block = arena->current;
+    while (block)
+    {
+        struct Arena_Block* previous = block->previous;
+        VirtualFree(block, 0, MEM_RELEASE);
+        block = previous;
+    }
+    DeleteCriticalSection(&arena->lock);
+    free(arena);
+}
+
+// Fresh pages from VirtualAlloc are zero, and memory is never handed out twice, so nothing needs clearing.
+void* arena_alloc(struct Arena* arena, size_t size)
+{
+    size = (size + 15) & ~(size_t)15;
+
+    EnterCriticalSection(&arena->lock);
+
+    struct Arena_Block* block = arena->current;
+    if (!block || block->used + size > block->size)
+    {
+        size_t header_size = (sizeof(struct Arena_Block) + 15) & ~(size_t)15;
+        size_t new_block_size = header_size + size;
+        if (new_block_size < arena->block_size)
+            new_block_size = arena->block_size;
+
+        struct Arena_Block* new_block = VirtualAlloc(0, new_block_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (!new_block)
+        {
+            LeaveCriticalSection(&arena->lock);
+            return 0;
+        }
+        new_block->size = new_block_size;
+        new_block->used = header_size;
+        arena->committed_size += new_block_size;
+
+        // An oversized allocation gets its own block, keep filling whichever block has more room left.
+        if (block && new_block->size - new_block->used - size < block->size - block->used)
+        {
+            new_block->previous = block->previous;
+            block->previous = new_block;
+        }
+        else
+        {
+            new_block->previous = block;
+            arena->current = new_block;
+        }
+        block = new_block;
+    }
+
+    char* memory = (char*)block + block->used;
+    block->used += size;
+
+    LeaveCriticalSection(&arena->lock);
+    return memory;
+}
+
+char* arena_strdup(struct Arena* arena, const char* string)
+{
+    size_t len = strlen(string);
+    char* copy = arena_alloc(arena, len + 1);
+    memcpy(copy, string, len);
+    return copy;
+}
+
+size_t arena_get_committed_size(struct Arena* arena)
+{
+    return arena->committed_size;
+}
+
+char* arena_get_asset_path(struct Arena* arena, const char* path)
+{
+    size_t len = strlen(ASSET_PATH) + strlen(path);
+    char* string = arena_alloc(arena, len+1);
+    strcat(string, ASSET_PATH);
+    strcat(string, path);
+    return string;
+}
+struct Thread_Pool
+{
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE work_available;
+    CONDITION_VARIABLE work_done;
+    struct Thread_Pool_Job* first_job;
+    struct Thread_Pool_Job* last_job;
+    int shutdown;
+
+    HANDLE* threads;
+    unsigned int worker_count;
+};
+
+// Claims the next index of the first job that still has unclaimed work. Must be called with the lock held.
+static int thread_pool_claim(struct Thread_Pool* pool, struct Thread_Pool_Job* only_job, struct Thread_Pool_Job** out_job, size_t* out_index)
+{
+    struct Thread_Pool_Job* job = only_job ? only_job : pool->first_job;
+    if (!job || job->next >= job->count)
+        return 0;
+
+    *out_job = job;
+    *out_index = job->start + job->next++;
+    if (job->next == job->count)
+    {
+        // Fully claimed, unlink it so nobody else looks at it.
+        struct Thread_Pool_Job** link = &pool->first_job;
+        struct Thread_Pool_Job* prev = 0;
+        while (*link && *link != job)
+        {
+            prev = *link;
+            link = &(*link)->next_job;
+        }
+        if (*link)
+        {
+            *link = job->next_job;
+            if (pool->last_job == job)
+                pool->last_job = prev;
+        }
+        job->next_job = 0;
+    }
+    return 1;
+}
+
+// Runs one claimed index. Called with the lock held, returns with it held.
+static void thread_pool_execute(struct Thread_Pool* pool, struct Thread_Pool_Job* job, size_t index)
+{
+    LeaveCriticalSection(&pool->lock);
+    job->fn(job->user, index);
+    EnterCriticalSection(&pool->lock);
+
+    job->remaining--;
+    if (job->remaining == 0)
+        WakeAllConditionVariable(&pool->work_done);
+}
+
+static DWORD WINAPI thread_pool_worker(LPVOID param)
+{
+    struct Thread_Pool* pool = (struct Thread_Pool*)param;
+
+    EnterCriticalSection(&pool->lock);
+    while (!pool->shutdown)
+    {
+        struct Thread_Pool_Job* job = 0;
+        size_t index = 0;
+        if (thread_pool_claim(pool, 0, &job, &index))
+            thread_pool_execute(pool, job, index);
+        else
+            SleepConditionVariableCS(&pool->work_available, &pool->lock, INFINITE);
+    }
+    LeaveCriticalSection(&pool->lock);
+
+    return 0;
+}
+
+unsigned int get_logical_core_count()
+{
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    return system_info.dwNumberOfProcessors ? (unsigned int)system_info.dwNumberOfProcessors : 1;
+}
+
+struct Thread_Pool* thread_pool_create(unsigned int thread_count)
+{
+    if (thread_count == 0)
+        thread_count = get_logical_core_count();
+
+    struct Thread_Pool* pool = calloc(1, sizeof(struct Thread_Pool));
+    InitializeCriticalSection(&pool->lock);
+    InitializeConditionVariable(&pool->work_available);
+    InitializeConditionVariable(&pool->work_done);
+
+    // The thread calling thread_pool_wait does work too, so it counts as one of the threads.
+    pool->worker_count = thread_count - 1;
+    pool->threads = calloc(pool->worker_count + 1, sizeof(HANDLE));
+    for (unsigned int i = 0; i < pool->worker_count; i++)
+    {
+        pool->threads[i] = CreateThread(0, 0, thread_pool_worker, pool, 0, 0);
+    }
+
+    return pool;
+}
+
+void thread_pool_destroy(struct Thread_Pool* pool)
+{
+    if (!pool)
+        return;
+
+    EnterCriticalSection(&pool->lock);
+    pool->shutdown = 1;
+    WakeAllConditionVariable(&pool->work_available);
+    LeaveCriticalSection(&pool->lock);
+
+    for (unsigned int i = 0; i < pool->worker_count; i++)
+    {
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+    }
+
+    DeleteCriticalSection(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+unsigned int thread_pool_get_thread_count(struct Thread_Pool* pool)
+{
+    return pool ? pool->worker_count + 1 : 1;
+}
+
+void thread_pool_submit(struct Thread_Pool* pool, struct Thread_Pool_Job* job)
+{
+    job->next = 0;
+    job->remaining = job->count;
+    job->next_job = 0;
+    if (job->count == 0)
+        return;
+
+    EnterCriticalSection(&pool->lock);
+    if (pool->last_job)
+        pool->last_job->next_job = job;
+    else
+        pool->first_job = job;
+    pool->last_job = job;
+    WakeAllConditionVariable(&pool->work_available);
+    LeaveCriticalSection(&pool->lock);
+}
+
+void thread_pool_wait(struct Thread_Pool* pool, struct Thread_Pool_Job* job)
+{
+    EnterCriticalSection(&pool->lock);
+
+    struct Thread_Pool_Job* claimed_job = 0;
+    size_t index = 0;
+    while (thread_pool_claim(pool, job, &claimed_job, &index))
+        thread_pool_execute(pool, claimed_job, index);
+
+    while (job->remaining > 0)
+        SleepConditionVariableCS(&pool->work_done, &pool->lock, INFINITE);
+
+    LeaveCriticalSection(&pool->lock);
+}
+
+void thread_pool_for(struct Thread_Pool* pool, Thread_Pool_Fn* fn, void* user, size_t count)
+{
+    if (!pool || pool->worker_count == 0)
+    {
+        for (size_t i = 0; i < count; i++)
+            fn(user, i);
+        return;
+    }
+
+    struct Thread_Pool_Job job = {
+        .fn = fn,
+        .user = user,
+        .start = 0,
+        .count = count,
+    };
+    thread_pool_submit(pool, &job);
+    thread_pool_wait(pool, &job);
+}
+
+int map_file(const char* path, int copy_on_write, struct Mapped_File* out_file)
+{
+    *out_file = (struct Mapped_File){0};
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    LARGE_INTEGER file_size = {0};
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return 0;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, 0, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, 0);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return 0;
+    }
+
+    void* data = MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return 0;
+    }
+
+    out_file->data = data;
+    out_file->size = (size_t)file_size.QuadPart;
+    out_file->file_handle = file;
+    out_file->mapping_handle = mapping;
+    return 1;
+}
+
+void unmap_file(struct Mapped_File* file)
+{
+    if (file->data)
+        UnmapViewOfFile(file->data);
+    if (file->mapping_handle)
+        CloseHandle(file->mapping_handle);
+    if (file->file_handle)
+        CloseHandle(file->file_handle);
+    *file = (struct Mapped_File){0};
+}
+
+int write_file(const char* path, const void* data, size_t size)
+{
+    HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    const char* cursor = (const char*)data;
+    while (size > 0)
+    {
+        DWORD chunk_size = (DWORD)(size < ((size_t)1 << 30) ? size : ((size_t)1 << 30));
+        DWORD written = 0;
+        if (!WriteFile(file, cursor, chunk_size, &written, 0) || written != chunk_size)
+        {
+            CloseHandle(file);
+            DeleteFileA(path);
+            return 0;
+        }
+        cursor += written;
+        size -= written;
+    }
+
+    CloseHandle(file);
+    return 1;
+}
+
+// xxHash64, see https://github.com/Cyan4973/xxHash
+#define HASH64_PRIME1 0x9E3779B185EBCA87ull
+#define HASH64_PRIME2 0xC2B2AE3D27D4EB4Full
+#define HASH64_PRIME3 0x165667B19E3779F9ull
+#define HASH64_PRIME4 0x85EBCA77C2B2AE63ull
+#define HASH64_PRIME5 0x27D4EB2F165667C5ull
+static uint64_t hash64_round(uint64_t acc, uint64_t lane)
+{
+    acc += lane * HASH64_PRIME2;
+    acc = _rotl64(acc, 31);
+    return acc * HASH64_PRIME1;
+}
+static uint64_t hash64_merge(uint64_t acc, uint64_t value)
+{
+    acc ^= hash64_round(0, value);
+    return acc * HASH64_PRIME1 + HASH64_PRIME4;
+}
+unsigned long long hash64(const void* data, size_t size, unsigned long long seed)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + size;
+    uint64_t hash;
+
+    if (size >= 32)
+    {
+        uint64_t acc[4] = { seed + HASH64_PRIME1 + HASH64_PRIME2, seed + HASH64_PRIME2, seed, seed - HASH64_PRIME1 };
+        while (end - p >= 32)
+        {
+            uint64_t lanes[4];
+            memcpy(lanes, p, sizeof(lanes));
+            acc[0] = hash64_round(acc[0], lanes[0]);
+            acc[1] = hash64_round(acc[1], lanes[1]);
+            acc[2] = hash64_round(acc[2], lanes[2]);
+            acc[3] = hash64_round(acc[3], lanes[3]);
+            p += 32;
+        }
+        hash = _rotl64(acc[0], 1) + _rotl64(acc[1], 7) + _rotl64(acc[2], 12) + _rotl64(acc[3], 18);
+        hash = hash64_merge(hash, acc[0]);
+        hash = hash64_merge(hash, acc[1]);
+        hash = hash64_merge(hash, acc[2]);
+        hash = hash64_merge(hash, acc[3]);
+    }
+    else
+    {
+        hash = seed + HASH64_PRIME5;
+    }
+
+    hash += (uint64_t)size;
+
+    while (end - p >= 8)
+    {
+        uint64_t lane;
+        memcpy(&lane, p, sizeof(lane));
+        hash ^= hash64_round(0, lane);
+        hash = _rotl64(hash, 27) * HASH64_PRIME1 + HASH64_PRIME4;
+        p += 8;
+    }
+    if (end - p >= 4)
+    {
+        uint32_t lane;
+        memcpy(&lane, p, sizeof(lane));
+        hash ^= (uint64_t)lane * HASH64_PRIME1;
+        hash = _rotl64(hash, 23) * HASH64_PRIME2 + HASH64_PRIME3;
+        p += 4;
+    }
+    while (p < end)
+    {
+        hash ^= (*p) * HASH64_PRIME5;
+        hash = _rotl64(hash, 11) * HASH64_PRIME1;
+        p++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= HASH64_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH64_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+struct Memory_Sampler
+{
+    HANDLE thread;
+    volatile LONG running;
+    size_t base_working_set;
+    size_t base_private_bytes;
+    size_t peak_working_set;
+    size_t peak_private_bytes;
+};
+
+void get_process_memory(size_t* out_working_set, size_t* out_private_bytes)
+{
+    PROCESS_MEMORY_COUNTERS counters = { .cb = sizeof(PROCESS_MEMORY_COUNTERS) };
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    *out_working_set = counters.WorkingSetSize;
+    *out_private_bytes = counters.PagefileUsage;
+}
+
+static void memory_sampler_sample(struct Memory_Sampler* sampler)
+{
+    size_t working_set = 0;
+    size_t private_bytes = 0;
+    get_process_memory(&working_set, &private_bytes);
+    if (working_set > sampler->peak_working_set)
+        sampler->peak_working_set = working_set;
+    if (private_bytes > sampler->peak_private_bytes)
+        sampler->peak_private_bytes = private_bytes;
+}
+
+static DWORD WINAPI memory_sampler_thread(LPVOID param)
+{
+    struct Memory_Sampler* sampler = (struct Memory_Sampler*)param;
+    while (sampler->running)
+    {
+        memory_sampler_sample(sampler);
+        Sleep(1);
+    }
+    return 0;
+}
+
+struct Memory_Sampler* memory_sampler_start()
+{
+    SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+
+    struct Memory_Sampler* sampler = calloc(1, sizeof(struct Memory_Sampler));
+    memory_sampler_sample(sampler);
+    sampler->base_working_set = sampler->peak_working_set;
+    sampler->base_private_bytes = sampler->peak_private_bytes;
+
+    sampler->running = 1;
+    sampler->thread = CreateThread(0, 0, memory_sampler_thread, sampler, 0, 0);
+    return sampler;
+}
+
+// Reports the peaks relative to what the process was using when the sampler started.
+void memory_sampler_stop(struct Memory_Sampler* sampler, size_t* out_peak_working_set, size_t* out_peak_private_bytes)
+{
+    memory_sampler_sample(sampler);
+    sampler->running = 0;
+    WaitForSingleObject(sampler->thread, INFINITE);
+    CloseHandle(sampler->thread);
+
+    *out_peak_working_set = sampler->peak_working_set - sampler->base_working_set;
+    *out_peak_private_bytes = sampler->peak_private_bytes - sampler->base_private_bytes;
+    free(sampler);
+}
@@ -1,6 +1,7 @@
 #ifndef UTIL
 #define UTIL
 #include <intrin.h>
+#include <stddef.h>
 
 inline unsigned long long GetRdtsc()
 {
@@ -15,4 +16,63 @@ void SetCpuAndThreadPriority();
 void CreateConsole();
 
 char* get_asset_path(const char* path);
+
+// Bump allocator that hands out zeroed memory from a few large blocks and frees it all at once.
+// Safe to allocate from several threads.
+struct Arena;
+struct Arena* arena_create(size_t block_size);
+void arena_destroy(struct Arena* arena);
+void* arena_alloc(struct Arena* arena, size_t size);
+char* arena_strdup(struct Arena* arena, const char* string);
+size_t arena_get_committed_size(struct Arena* arena);
+char* arena_get_asset_path(struct Arena* arena, const char* path);
+
+// Whole file mapped into memory. With copy_on_write the view is writable, but writes stay private to the process.
+struct Mapped_File
+{
+    void* data;
+    size_t size;
+    void* file_handle;
+    void* mapping_handle;
+};
+int map_file(const char* path, int copy_on_write, struct Mapped_File* out_file);
+void unmap_file(struct Mapped_File* file);
+int write_file(const char* path, const void* data, size_t size);
+
+// Polls the process memory counters on a background thread until stopped, to catch the peak of one operation.
+// Starting a sampler trims the working set first so consecutive measurements start from the same place.
+void get_process_memory(size_t* out_working_set, size_t* out_private_bytes);
+struct Memory_Sampler;
+struct Memory_Sampler* memory_sampler_start();
+void memory_sampler_stop(struct Memory_Sampler* sampler, size_t* out_peak_working_set, size_t* out_peak_private_bytes);
+
+unsigned long long hash64(const void* data, size_t size, unsigned long long seed);
+
+// Work split into `count` indices, each one passed to `fn` on some pool thread.
+// The job must stay alive until thread_pool_wait has returned for it.
+typedef void Thread_Pool_Fn(void* user, size_t index);
+struct Thread_Pool_Job
+{
+    Thread_Pool_Fn* fn;
+    void* user;
+    size_t start;
+    size_t count;
+
+    size_t next;
+    size_t remaining;
+    struct Thread_Pool_Job* next_job;
+};
+struct Thread_Pool;
+
+// thread_count includes the calling thread, 0 means one per logical core.
+struct Thread_Pool* thread_pool_create(unsigned int thread_count);
+void thread_pool_destroy(struct Thread_Pool* pool);
+unsigned int thread_pool_get_thread_count(struct Thread_Pool* pool);
+unsigned int get_logical_core_count();
+
+void thread_pool_submit(struct Thread_Pool* pool, struct Thread_Pool_Job* job);
+// Helps run the job's remaining indices on the calling thread, then blocks until all of them are done.
+void thread_pool_wait(struct Thread_Pool* pool, struct Thread_Pool_Job* job);
+// Runs fn(user, i) for i in [0, count) across the pool and waits for it. A NULL pool runs it serially.
+void thread_pool_for(struct Thread_Pool* pool, Thread_Pool_Fn* fn, void* user, size_t count);
 #endif
\ No newline at end of file